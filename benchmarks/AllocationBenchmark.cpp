@@ -0,0 +1,96 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+// Counts the heap and pool allocations needed to create Variables. The heap allocations are counted by replacing the
+// global operator new, the pool allocations are taken from Pool::hits() and Pool::misses(). All created Variables are
+// kept alive until the end of each case, so freed blocks can't be handed out again by the pool. Pooling is enabled for
+// the whole run.
+
+#include "../src/JsonDecoder.h"
+#include "../src/Pool.h"
+#include "../src/Variable.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace Flows;
+
+namespace {
+
+size_t heapAllocations = 0;
+
+void measure(const std::string &name, const std::function<PVariable(size_t)> &create) {
+  constexpr size_t iterations = 100000;
+  std::vector<PVariable> variables;
+  variables.reserve(iterations);
+
+  size_t heapBefore = heapAllocations;
+  uint64_t poolBefore = Pool::hits() + Pool::misses();
+  for (size_t i = 0; i < iterations; i++) {
+    variables.push_back(create(i));
+  }
+  double heap = (double)(heapAllocations - heapBefore) / iterations;
+  double pool = (double)(Pool::hits() + Pool::misses() - poolBefore) / iterations;
+  printf("%-36s %8.2f %8.2f\n", name.c_str(), heap, pool);
+}
+
+}
+
+void *operator new(size_t size) {
+  heapAllocations++;
+  void *block = std::malloc(size == 0 ? 1 : size);
+  if (!block) throw std::bad_alloc();
+  return block;
+}
+
+void operator delete(void *block) noexcept {
+  std::free(block);
+}
+
+void operator delete(void *block, size_t) noexcept {
+  std::free(block);
+}
+
+int main() {
+  const std::string json = "[1,2,3,4,5,6,7,8,9,10]";
+  Pool::setEnabled(true);
+
+  printf("%-36s %8s %8s\n", "Allocations per call", "heap", "pool");
+  measure("std::make_shared<Variable>(bool)", [](size_t i) { return std::make_shared<Variable>(i % 2 == 0); });
+  measure("std::make_shared<Variable>(int64_t)", [](size_t i) { return std::make_shared<Variable>((int64_t)i); });
+  measure("std::make_shared<Variable>(double)", [](size_t i) { return std::make_shared<Variable>((double)i); });
+  measure("Pool::create<Variable>(int64_t)", [](size_t i) { return Pool::create<Variable>((int64_t)i); });
+  measure("JsonDecoder::decode(\"[1,...,10]\")", [&](size_t) { return JsonDecoder::decode(json); });
+  return 0;
+}
@@ -0,0 +1,123 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+// Compares Statistics::calculate() to the loop aggregation nodes would write themselves: iterating over arrayValue
+// and reading floatValue. Statistics::calculate() is measured on the same array, which it gathers into a packed buffer
+// first, and on a packed array. Pass the largest array size to test as the first argument (default 10000000).
+
+#include "../src/Statistics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace Flows;
+
+namespace {
+
+volatile double sink = 0;
+
+template<typename Function>
+double microseconds(Function function, size_t repetitions) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < repetitions; i++) {
+    function();
+  }
+  auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  return (double)duration / repetitions / 1000.0;
+}
+
+Statistics::Result naive(const PVariable &array) {
+  Statistics::Result result;
+  result.min = INFINITY;
+  result.max = -INFINITY;
+  for (auto &element : *array->arrayValue) {
+    result.min = std::min(result.min, element->floatValue);
+    result.max = std::max(result.max, element->floatValue);
+    result.sum += element->floatValue;
+  }
+  result.count = array->arrayValue->size();
+  result.mean = result.sum / result.count;
+  double squares = 0;
+  for (auto &element : *array->arrayValue) {
+    double difference = element->floatValue - result.mean;
+    squares += difference * difference;
+  }
+  result.stddev = std::sqrt(squares / result.count);
+  return result;
+}
+
+}
+
+int main(int argc, char **argv) {
+  size_t maxSize = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+
+  printf("Kernel: %s\n", Statistics::kernel().c_str());
+  printf("%10s %12s %12s %12s %8s\n", "elements", "naive (us)", "array (us)", "packed (us)", "speedup");
+  std::mt19937 generator(1);
+  std::uniform_real_distribution<double> distribution(-50, 50);
+  for (size_t size : {(size_t)1000, (size_t)100000, (size_t)10000000}) {
+    if (size > maxSize) break;
+    auto array = std::make_shared<Variable>(VariableType::tArray);
+    std::vector<double> values(size);
+    array->arrayValue->reserve(size);
+    for (auto &value : values) {
+      value = distribution(generator);
+      array->arrayValue->push_back(std::make_shared<Variable>(value));
+    }
+    auto packed = std::make_shared<Variable>(values);
+
+    //Roughly the same total number of elements for every size.
+    size_t repetitions = std::max((size_t)3, (size_t)20000000 / size);
+    double naiveTime = microseconds([&]() { sink = naive(array).stddev; }, repetitions);
+    double arrayTime = microseconds([&]() { sink = Statistics::calculate(array).stddev; }, repetitions);
+    double packedTime = microseconds([&]() { sink = Statistics::calculate(packed).stddev; }, repetitions);
+    printf("%10zu %12.1f %12.1f %12.1f %7.1fx\n", size, naiveTime, arrayTime, packedTime, naiveTime / packedTime);
+
+    auto expected = naive(array);
+    auto result = Statistics::calculate(packed);
+    if (std::abs(expected.mean - result.mean) > 1e-6 || std::abs(expected.stddev - result.stddev) > 1e-6) {
+      printf("Results differ: mean %f != %f, stddev %f != %f\n", expected.mean, result.mean, expected.stddev, result.stddev);
+      return 1;
+    }
+
+    for (auto &kernel : Statistics::kernels()) {
+      Statistics::setKernel(kernel);
+      double kernelTime = microseconds([&]() { sink = Statistics::calculate(packed).stddev; }, repetitions);
+      printf("%10s %12s %12s %12.1f %7.1fx\n", kernel.c_str(), "", "", kernelTime, naiveTime / kernelTime);
+    }
+    Statistics::setKernel(Statistics::kernels().front());
+  }
+  return 0;
+}
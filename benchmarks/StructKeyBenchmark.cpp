@@ -0,0 +1,110 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+// Measures the costs struct key interning was meant to reduce: Heap allocations for keys when decoding a typical
+// message, looking up a property in it and comparing two equal messages. The keys of a typical message fit into the
+// small string buffer of std::string, so they don't cost heap allocations to begin with.
+
+#include "../src/JsonDecoder.h"
+#include "../src/MessageProperty.h"
+#include "../src/Variable.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+using namespace Flows;
+
+namespace {
+
+size_t heapAllocations = 0;
+volatile size_t sink = 0;
+
+template<typename Function>
+double nanoseconds(Function function) {
+  constexpr size_t iterations = 1000000;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; i++) {
+    function();
+  }
+  auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  return (double)duration / iterations;
+}
+
+template<typename Function>
+double allocations(Function function) {
+  constexpr size_t iterations = 10000;
+  size_t before = heapAllocations;
+  for (size_t i = 0; i < iterations; i++) {
+    function();
+  }
+  return (double)(heapAllocations - before) / iterations;
+}
+
+}
+
+void *operator new(size_t size) {
+  heapAllocations++;
+  void *block = std::malloc(size == 0 ? 1 : size);
+  if (!block) throw std::bad_alloc();
+  return block;
+}
+
+void operator delete(void *block) noexcept {
+  std::free(block);
+}
+
+void operator delete(void *block, size_t) noexcept {
+  std::free(block);
+}
+
+int main() {
+  //7 keys, as in the messages passed between nodes.
+  const std::string json = R"({"_msgid":"4f2a","topic":"sensors/kitchen","payload":{"temperature":21,"humidity":40},"source":"node1","timestamp":1700000000,"retain":false,"qos":1})";
+  const std::string keylessJson = R"(["4f2a","sensors/kitchen",[21,40],"node1",1700000000,false,1])";
+  auto message = JsonDecoder::decode(json);
+  auto other = JsonDecoder::decode(json);
+  MessageProperty property("payload.temperature");
+
+  printf("%-40s %10.2f\n", "Heap allocations per decode", allocations([&] { sink = sink + (size_t)JsonDecoder::decode(json)->type; }));
+  printf("%-40s %10.2f\n", "Heap allocations per key copy", allocations([&] {
+    for (auto &element : message->structValue.view()) {
+      std::string key(element.first);
+      sink = sink + key.size();
+    }
+  }) / (double)message->structValue.view().size());
+  printf("%-40s %10.2f\n", "Heap allocations per decode without keys", allocations([&] { sink = sink + (size_t)JsonDecoder::decode(keylessJson)->type; }));
+  printf("%-40s %10.1f\n", "Decode (ns)", nanoseconds([&] { sink = sink + (size_t)JsonDecoder::decode(json)->type; }));
+  printf("%-40s %10.1f\n", "Match \"payload.temperature\" (ns)", nanoseconds([&] { sink = sink + (size_t)property.match(message)->integerValue; }));
+  printf("%-40s %10.1f\n", "Compare two decoded messages (ns)", nanoseconds([&] { sink = sink + (*message == *other); }));
+  return 0;
+}
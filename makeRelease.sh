@@ -10,5 +10,5 @@ rm -Rf autom4te.cache
 ./bootstrap || exit 1
 ./configure --prefix=/usr --localstatedir=/var --sysconfdir=/etc --libdir=/usr/lib || exit 1
 make -j${BUILDTHREADS} || exit 1
-strip -s src/.libs/libhomegear-node.so.1.0.0
+strip -s src/.libs/libhomegear-node.so.2.0.0
 make install
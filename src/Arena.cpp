@@ -0,0 +1,59 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "Arena.h"
+
+#include <new>
+
+namespace Flows {
+
+Arena::Arena(size_t initialBlockSize) {
+  _nextBlockSize = initialBlockSize < 256 ? 256 : initialBlockSize;
+}
+
+void *Arena::allocate(size_t size, size_t alignment) {
+  auto padding = (alignment - ((uintptr_t)_current & (alignment - 1))) & (alignment - 1);
+  if (!_current || padding + size > _remaining) {
+    size_t blockSize = size + alignment > _nextBlockSize ? size + alignment : _nextBlockSize;
+    _blocks.emplace_back(new uint8_t[blockSize]);
+    _current = _blocks.back().get();
+    _remaining = blockSize;
+    _reservedBytes += blockSize;
+    if (_nextBlockSize < _maxBlockSize) _nextBlockSize *= 2;
+    padding = (alignment - ((uintptr_t)_current & (alignment - 1))) & (alignment - 1);
+  }
+  void *result = _current + padding;
+  _current += padding + size;
+  _remaining -= padding + size;
+  _usedBytes += size;
+  return result;
+}
+
+}
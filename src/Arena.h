@@ -0,0 +1,115 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#ifndef LIBHOMEGEAR_NODE_ARENA_H
+#define LIBHOMEGEAR_NODE_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Flows {
+
+/**
+ * Monotonic memory resource. Memory is handed out from a few large blocks and only released all at once when the arena
+ * is destroyed. Use it through ArenaAllocator to place all Variables of a decoded message next to each other, which
+ * saves one malloc()/free() pair per element.
+ *
+ * Allocating is not thread safe. Objects allocated in the arena can be used and destroyed on any thread though.
+ *
+ * Every object created with std::allocate_shared() and ArenaAllocator keeps the arena alive, so elements of a decoded
+ * message can be kept after the root is gone. As the arena is only released as a whole, a single kept element pins all
+ * of it. Copy small parts that are kept for long, e.g. one element stored in node context, out of the arena with the
+ * Variable copy constructor (std::make_shared<Variable>(*element)), which allocates the copy on the heap.
+ */
+class Arena {
+ public:
+  /**
+   * @param initialBlockSize The size of the first block. Each following block is twice as large up to 64 KiB.
+   */
+  explicit Arena(size_t initialBlockSize = 4096);
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+  virtual ~Arena() = default;
+
+  void *allocate(size_t size, size_t alignment);
+
+  /**
+   * @return Returns the number of bytes reserved from the system.
+   */
+  size_t reservedBytes() const { return _reservedBytes; }
+
+  /**
+   * @return Returns the number of bytes handed out.
+   */
+  size_t usedBytes() const { return _usedBytes; }
+ private:
+  static constexpr size_t _maxBlockSize = 65536;
+
+  std::vector<std::unique_ptr<uint8_t[]>> _blocks;
+  size_t _nextBlockSize = 0;
+  uint8_t *_current = nullptr;
+  size_t _remaining = 0;
+  size_t _reservedBytes = 0;
+  size_t _usedBytes = 0;
+};
+
+typedef std::shared_ptr<Arena> PArena;
+
+/**
+ * Standard allocator allocating from an Arena. Deallocation is a no-op. The allocator holds a reference to the arena,
+ * so each control block created with std::allocate_shared() keeps the arena alive until the object is gone.
+ */
+template<typename T>
+class ArenaAllocator {
+ public:
+  typedef T value_type;
+
+  explicit ArenaAllocator(PArena arena) : _arena(std::move(arena)) {}
+  template<typename U>
+  ArenaAllocator(const ArenaAllocator<U> &rhs) : _arena(rhs.arena()) {}
+
+  T *allocate(size_t n) { return static_cast<T *>(_arena->allocate(n * sizeof(T), alignof(T))); }
+  void deallocate(T *, size_t) noexcept {}
+
+  const PArena &arena() const { return _arena; }
+
+  template<typename U>
+  bool operator==(const ArenaAllocator<U> &rhs) const { return _arena == rhs.arena(); }
+  template<typename U>
+  bool operator!=(const ArenaAllocator<U> &rhs) const { return _arena != rhs.arena(); }
+ private:
+  PArena _arena;
+};
+
+}
+
+#endif //LIBHOMEGEAR_NODE_ARENA_H
@@ -30,6 +30,8 @@
 
 #include "BinaryDecoder.h"
 
+#include <limits>
+
 namespace Flows {
 
 BinaryDecoder::BinaryDecoder() {
@@ -149,9 +151,12 @@ double BinaryDecoder::decodeFloat(std::vector<char> &encodedData, uint32_t &posi
   position += 4;
   memcpyBigEndian((char *)&exponent, &encodedData.at(position), 4);
   position += 4;
-  double floatValue = (double)mantissa / 0x40000000;
-  floatValue *= std::pow(2, exponent);
-  if (floatValue != 0) {
+  //Unlike multiplying with 2^exponent, std::ldexp() only overflows when the result does. Results out of range are
+  //clamped, so decoding never produces infinity or NaN.
+  double floatValue = std::ldexp((double)mantissa / 0x40000000, exponent);
+  if (std::isinf(floatValue)) floatValue = floatValue < 0 ? std::numeric_limits<double>::lowest() : std::numeric_limits<double>::max();
+  //The rounding factor of smaller numbers overflows.
+  if (std::abs(floatValue) > 1e-290) {
     int32_t digits = std::lround(std::floor(std::log10(floatValue) + 1));
     double factor = std::pow(10, 9 - digits);
     //Round to 9 digits
@@ -168,10 +173,12 @@ double BinaryDecoder::decodeFloat(std::vector<uint8_t> &encodedData, uint32_t &p
   position += 4;
   memcpyBigEndian((char *)&exponent, (char *)&encodedData.at(position), 4);
   position += 4;
-  double floatValue = (double)mantissa / 0x40000000;
-  if (exponent >= 0) floatValue *= (1 << exponent);
-  else floatValue /= (1 << (exponent * -1));
-  if (floatValue != 0) {
+  //Unlike multiplying with 2^exponent, std::ldexp() only overflows when the result does. Results out of range are
+  //clamped, so decoding never produces infinity or NaN.
+  double floatValue = std::ldexp((double)mantissa / 0x40000000, exponent);
+  if (std::isinf(floatValue)) floatValue = floatValue < 0 ? std::numeric_limits<double>::lowest() : std::numeric_limits<double>::max();
+  //The rounding factor of smaller numbers overflows.
+  if (std::abs(floatValue) > 1e-290) {
     int32_t digits = std::lround(std::floor(std::log10(floatValue) + 1));
     double factor = std::pow(10, 9 - digits);
     //Round to 9 digits
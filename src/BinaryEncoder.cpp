@@ -30,6 +30,8 @@
 
 #include "BinaryEncoder.h"
 
+#include <limits>
+
 namespace Flows {
 
 BinaryEncoder::BinaryEncoder() {
@@ -120,6 +122,9 @@ void BinaryEncoder::encodeBoolean(std::vector<uint8_t> &encodedData, bool boolea
 }
 
 void BinaryEncoder::encodeFloat(std::vector<char> &encodedData, double floatValue) {
+  //The format has no representation for infinity and NaN.
+  if (std::isnan(floatValue)) floatValue = 0;
+  else if (std::isinf(floatValue)) floatValue = floatValue < 0 ? std::numeric_limits<double>::lowest() : std::numeric_limits<double>::max();
   double temp = std::abs(floatValue);
   int32_t exponent = 0;
   if (temp != 0 && temp < 0.5) {
@@ -134,6 +139,8 @@ void BinaryEncoder::encodeFloat(std::vector<char> &encodedData, double floatValu
     }
   if (floatValue < 0) temp *= -1;
   int32_t mantissa = std::lround(temp * 0x40000000);
+  //Rounding the largest numbers up would overflow when decoding.
+  if (exponent >= 1024 && std::abs(mantissa) == 0x40000000) mantissa = floatValue < 0 ? -0x3FFFFFFF : 0x3FFFFFFF;
   char data[8];
   memcpyBigEndian(data, (char *)&mantissa, 4);
   memcpyBigEndian(data + 4, (char *)&exponent, 4);
@@ -141,6 +148,9 @@ void BinaryEncoder::encodeFloat(std::vector<char> &encodedData, double floatValu
 }
 
 void BinaryEncoder::encodeFloat(std::vector<uint8_t> &encodedData, double floatValue) {
+  //The format has no representation for infinity and NaN.
+  if (std::isnan(floatValue)) floatValue = 0;
+  else if (std::isinf(floatValue)) floatValue = floatValue < 0 ? std::numeric_limits<double>::lowest() : std::numeric_limits<double>::max();
   double temp = std::abs(floatValue);
   int32_t exponent = 0;
   if (temp != 0 && temp < 0.5) {
@@ -155,6 +165,8 @@ void BinaryEncoder::encodeFloat(std::vector<uint8_t> &encodedData, double floatV
     }
   if (floatValue < 0) temp *= -1;
   int32_t mantissa = std::lround(temp * 0x40000000);
+  //Rounding the largest numbers up would overflow when decoding.
+  if (exponent >= 1024 && std::abs(mantissa) == 0x40000000) mantissa = floatValue < 0 ? -0x3FFFFFFF : 0x3FFFFFFF;
   char data[8];
   memcpyBigEndian(data, (char *)&mantissa, 4);
   memcpyBigEndian(data + 4, (char *)&exponent, 4);
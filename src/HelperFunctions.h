@@ -120,6 +120,20 @@ class HelperFunctions {
     return s;
   }
 
+  /**
+   * Returns the number of bytes a string allocated on the heap. Short strings are stored in the string object itself and
+   * don't allocate anything.
+   *
+   * @param s The string to check.
+   * @return Returns the capacity including the terminating null character or 0 for strings not using the heap.
+   */
+  static size_t getHeapSize(const std::string &s) {
+    auto data = (const char *)s.data();
+    auto object = (const char *)&s;
+    if (data >= object && data < object + sizeof(std::string)) return 0;
+    return s.capacity() + 1;
+  }
+
   /**
    * Converts a byte array to a hex string.
    *
@@ -40,7 +40,10 @@ IQueue::IQueue(std::shared_ptr<Output> &output, uint32_t queueCount, uint32_t bu
   _bufferTail.resize(queueCount);
   _bufferCount.resize(queueCount);
   _waitWhenFull.resize(queueCount);
+  _maxBytes.reset(new std::atomic<size_t>[queueCount]);
+  _bufferBytes.resize(queueCount);
   _buffer.resize(queueCount);
+  _entryBytes.resize(queueCount);
   _queueMutex.reset(new std::mutex[queueCount]);
   _processingThread.resize(queueCount);
   _produceConditionVariable.reset(new std::condition_variable[queueCount]);
@@ -50,6 +53,8 @@ IQueue::IQueue(std::shared_ptr<Output> &output, uint32_t queueCount, uint32_t bu
     _bufferHead[i] = 0;
     _bufferTail[i] = 0;
     _bufferCount[i] = 0;
+    _maxBytes[i] = 0;
+    _bufferBytes[i] = 0;
     _stopProcessingThread[i] = true;
   }
 }
@@ -65,18 +70,31 @@ bool IQueue::queueEmpty(int32_t index) {
   return _bufferCount[index] > 0;
 }
 
+void IQueue::setMaxBytes(int32_t index, size_t maxBytes) {
+  if (index < 0 || index >= _queueCount) return;
+  _maxBytes[index] = maxBytes;
+}
+
+size_t IQueue::queueBytes(int32_t index) {
+  if (index < 0 || index >= _queueCount) return 0;
+  std::lock_guard<std::mutex> lock(_queueMutex[index]);
+  return _bufferBytes[index];
+}
+
 void IQueue::startQueue(int32_t index, bool waitWhenFull, uint32_t processingThreadCount) {
   if (index < 0 || index >= _queueCount) return;
   _stopProcessingThread[index] = false;
   _bufferHead[index] = 0;
   _bufferTail[index] = 0;
   _bufferCount[index] = 0;
+  _bufferBytes[index] = 0;
   _waitWhenFull[index] = waitWhenFull;
   for (uint32_t i = 0; i < processingThreadCount; i++) {
     std::shared_ptr<std::thread> thread = std::make_shared<std::thread>(&IQueue::process, this, index);
     _processingThread[index].push_back(thread);
   }
   _buffer.at(index).resize(_bufferSize);
+  _entryBytes.at(index).resize(_bufferSize);
 }
 
 void IQueue::stopQueue(int32_t index) {
@@ -92,19 +110,29 @@ void IQueue::stopQueue(int32_t index) {
   }
   _processingThread[index].clear();
   _buffer[index].clear();
-
+  _entryBytes[index].clear();
+  _bufferBytes[index] = 0;
 }
 
 bool IQueue::enqueue(int32_t index, std::shared_ptr<IQueueEntry> &entry, bool waitWhenFull) {
   if (index < 0 || index >= _queueCount || !entry || _stopProcessingThread[index]) return true;
+  //Calculated outside of the lock, as it might have to walk a large message.
+  size_t maxBytes = _maxBytes[index];
+  size_t entryBytes = maxBytes != 0 ? entry->memoryUsage() : 0;
   std::unique_lock<std::mutex> lock(_queueMutex[index]);
+  auto hasSpace = [&] {
+    if (_bufferCount[index] >= _bufferSize) return false;
+    return maxBytes == 0 || _bufferCount[index] == 0 || _bufferBytes[index] + entryBytes <= maxBytes;
+  };
   if (_waitWhenFull[index] || waitWhenFull) {
     while (!_produceConditionVariable[index].wait_for(lock, std::chrono::milliseconds(1000), [&] {
-      return _bufferCount[index] < _bufferSize || _stopProcessingThread[index];
+      return hasSpace() || _stopProcessingThread[index];
     }));
     if (_stopProcessingThread[index]) return true;
-  } else if (_bufferCount[index] >= _bufferSize) return false;
+  } else if (!hasSpace()) return false;
 
+  _entryBytes[index][_bufferTail[index]] = entryBytes;
+  _bufferBytes[index] += entryBytes;
   _buffer[index][_bufferTail[index]] = entry;
   _bufferTail[index] = (_bufferTail[index] + 1) % _bufferSize;
   ++(_bufferCount[index]);
@@ -130,6 +158,7 @@ void IQueue::process(int32_t index) {
 
         entry = _buffer[index][_bufferHead[index]];
         _buffer[index][_bufferHead[index]].reset();
+        _bufferBytes[index] -= _entryBytes[index][_bufferHead[index]];
         _bufferHead[index] = (_bufferHead[index] + 1) % _bufferSize;
         --_bufferCount[index];
 
@@ -33,6 +33,7 @@
 
 #include "IQueueBase.h"
 
+#include <atomic>
 #include <vector>
 #include <iostream>
 
@@ -41,6 +42,14 @@ class IQueueEntry {
  public:
   IQueueEntry() {};
   virtual ~IQueueEntry() {};
+
+  /**
+   * Override to bound queues by bytes with IQueue::setMaxBytes(). For entries holding messages, return
+   * Variable::estimateMemoryUsage() of the message. Called once when the entry is enqueued.
+   *
+   * @return Returns the number of bytes used by the entry.
+   */
+  virtual size_t memoryUsage() const { return 0; }
 };
 
 class IQueue : public IQueueBase {
@@ -52,6 +61,21 @@ class IQueue : public IQueueBase {
   bool enqueue(int32_t index, std::shared_ptr<IQueueEntry> &entry, bool waitWhenFull = false);
   virtual void processQueueEntry(int32_t index, std::shared_ptr<IQueueEntry> &entry) = 0;
   bool queueEmpty(int32_t index);
+
+  /**
+   * Limits the number of bytes of the entries in a queue as returned by IQueueEntry::memoryUsage() in addition to the
+   * number of entries. An entry is always accepted by an empty queue, so a single large entry can't block the queue
+   * forever.
+   *
+   * @param index The index of the queue.
+   * @param maxBytes The maximum number of bytes or 0 for no limit (the default).
+   */
+  void setMaxBytes(int32_t index, size_t maxBytes);
+
+  /**
+   * @return Returns the number of bytes of the entries currently in the queue. Always 0 when no byte limit is set.
+   */
+  size_t queueBytes(int32_t index);
  private:
   std::shared_ptr<Output> _out;
   int32_t _bufferSize = 10000;
@@ -59,7 +83,10 @@ class IQueue : public IQueueBase {
   std::vector<int32_t> _bufferTail;
   std::vector<int32_t> _bufferCount;
   std::vector<bool> _waitWhenFull;
+  std::unique_ptr<std::atomic<size_t>[]> _maxBytes;
+  std::vector<size_t> _bufferBytes;
   std::vector<std::vector<std::shared_ptr<IQueueEntry>>> _buffer;
+  std::vector<std::vector<size_t>> _entryBytes;
   std::unique_ptr<std::mutex[]> _queueMutex = nullptr;
   std::vector<std::vector<std::shared_ptr<std::thread>>> _processingThread;
   std::unique_ptr<std::condition_variable[]> _produceConditionVariable = nullptr;
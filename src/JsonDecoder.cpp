@@ -29,129 +29,226 @@
 */
 
 #include "JsonDecoder.h"
+#include "JsonStructuralIndex.h"
+
+#include <cstring>
+#include <limits>
 
 namespace Flows {
 
+namespace {
+
+//Shared by all structs decoded on a thread, so its buffer is only allocated once.
+thread_local StructBuilder structBuilder;
+
+}
+
 PVariable JsonDecoder::decode(const std::string &json) {
-  uint32_t pos = 0;
-  auto variable = std::make_shared<Variable>();
-  skipWhitespace(json, pos);
-  if (!posValid(json, pos)) return variable;
-  if (!decodeValue(json, pos, variable)) {
-    variable->type = VariableType::tString;
-    variable->stringValue = decodeString(std::string(json.begin(), json.end()));
-  }
-  return variable;
+  return decode(json.data(), json.size(), PArena());
 }
 
 PVariable JsonDecoder::decode(const std::string &json, uint32_t &bytesRead) {
-  bytesRead = 0;
-  auto variable = std::make_shared<Variable>();
-  skipWhitespace(json, bytesRead);
-  if (!posValid(json, bytesRead)) return variable;
-  if (!decodeValue(json, bytesRead, variable)) throw JsonDecoderException("Invalid JSON.");
-  return variable;
+  return decode(json.data(), json.size(), bytesRead);
 }
 
 PVariable JsonDecoder::decode(const std::vector<char> &json) {
-  uint32_t pos = 0;
-  auto variable = std::make_shared<Variable>();
-  skipWhitespace(json, pos);
-  if (!posValid(json, pos)) return variable;
-  if (!decodeValue(json, pos, variable)) {
-    variable->type = VariableType::tString;
-    variable->stringValue = decodeString(std::string(json.begin(), json.end()));
-  }
-  return variable;
+  return decode(json.data(), json.size(), PArena());
 }
 
 PVariable JsonDecoder::decode(const std::vector<char> &json, uint32_t &bytesRead) {
+  return decode(json.data(), json.size(), bytesRead);
+}
+
+PVariable JsonDecoder::decode(const char *json, size_t length) {
+  return decode(json, length, PArena());
+}
+
+PVariable JsonDecoder::decode(const char *json, size_t length, uint32_t &bytesRead) {
+  std::string_view view(json, length);
   bytesRead = 0;
-  auto variable = std::make_shared<Variable>();
-  skipWhitespace(json, bytesRead);
-  if (!posValid(json, bytesRead)) return variable;
-  if (!decodeValue(json, bytesRead, variable)) throw JsonDecoderException("Invalid JSON.");
+  auto variable = Pool::create<Variable>();
+  skipWhitespace(view, bytesRead);
+  if (!posValid(view, bytesRead)) return variable;
+  if (!decodeValue(view, bytesRead, variable, PArena())) throw JsonDecoderException("Invalid JSON.");
   return variable;
 }
 
-bool JsonDecoder::posValid(const std::string &json, uint32_t pos) {
-  return pos < json.length();
+PVariable JsonDecoder::decode(const std::string &json, const PArena &arena) {
+  return decode(json.data(), json.size(), arena);
 }
 
-bool JsonDecoder::posValid(const std::vector<char> &json, uint32_t pos) {
-  return pos < json.size();
+PVariable JsonDecoder::decode(const std::vector<char> &json, const PArena &arena) {
+  return decode(json.data(), json.size(), arena);
 }
 
-void JsonDecoder::skipWhitespace(const std::string &json, uint32_t &pos) {
-  while (pos < json.length() && (json[pos] == ' ' || json[pos] == '\n' || json[pos] == '\r' || json[pos] == '\t')) {
-    pos++;
-  }
+PVariable JsonDecoder::decode(const char *json, size_t length, const PArena &arena) {
+  return decodeDocument(std::string_view(json, length), arena);
 }
 
-void JsonDecoder::skipWhitespace(const std::vector<char> &json, uint32_t &pos) {
-  while (pos < json.size() && (json[pos] == ' ' || json[pos] == '\n' || json[pos] == '\r' || json[pos] == '\t')) {
-    pos++;
+PVariable JsonDecoder::decodeDocument(std::string_view view, const PArena &arena) {
+  auto variable = createVariable(arena);
+  if (decodeIndexed(view, variable, arena)) return variable;
+  uint32_t pos = 0;
+  variable = createVariable(arena);
+  skipWhitespace(view, pos);
+  if (!posValid(view, pos)) return variable;
+  if (!decodeValue(view, pos, variable, arena)) {
+    variable->type = VariableType::tString;
+    variable->stringValue = decodeString(std::string(view));
   }
+  return variable;
 }
 
-void JsonDecoder::decodeObject(const std::string &json, uint32_t &pos, PVariable &variable) {
-  variable->type = VariableType::tStruct;
-  if (!posValid(json, pos)) return;
-  if (json[pos] == '{') {
-    pos++;
-    if (!posValid(json, pos)) throw JsonDecoderException("No closing '}' found.");
-  }
-  skipWhitespace(json, pos);
-  if (!posValid(json, pos)) throw JsonDecoderException("No closing '}' found.");
-  if (json[pos] == '}') {
-    pos++;
-    return; //Empty object
-  }
+PVariable JsonDecoder::createVariable(const PArena &arena) {
+  if (arena) return std::allocate_shared<Variable>(ArenaAllocator<Variable>(arena));
+  return Pool::create<Variable>();
+}
 
-  while (pos < json.length()) {
-    if (json[pos] != '"') throw JsonDecoderException("Object element has no name.");
-    std::string name;
-    decodeString(json, pos, name);
-    skipWhitespace(json, pos);
-    if (!posValid(json, pos)) throw JsonDecoderException("No closing '}' found.");
-    if (json[pos] != ':') {
-      variable->structValue->insert(StructElement(name, std::make_shared<Variable>()));
-      if (json[pos] == ',') {
-        pos++;
-        skipWhitespace(json, pos);
-        if (!posValid(json, pos)) throw JsonDecoderException("No closing '}' found.");
-        continue;
+bool JsonDecoder::decodeIndexed(std::string_view json, PVariable &variable, const PArena &arena) {
+  //Reused, so the index is only allocated once per thread. Very large indexes are freed again below.
+  thread_local JsonStructuralIndex index;
+  if (!index.build(json.data(), json.size())) return false;
+  const char *data = json.data();
+  const uint32_t *positions = index.positions();
+  const size_t count = index.size();
+
+  //A value has to be followed by whitespace, a structural character or the end of the input.
+  auto valueEnds = [&](uint32_t position) {
+    if (position >= json.size()) return true;
+    char c = data[position];
+    return c == ',' || c == '}' || c == ']' || c == ':' || c == ' ' || c == '\n' || c == '\r' || c == '\t';
+  };
+
+  //Strings without escape sequences are copied directly. All others are passed to decodeString().
+  auto decodeIndexedString = [&](size_t i, std::string &s) {
+    uint32_t position = positions[i];
+    const char *start = data + position + 1;
+    const char *end = start;
+    while (*end != '"' && *end != '\\') end++; //The index guarantees a closing quote.
+    if (*end == '"') {
+      s.assign(start, end - start);
+      return true;
+    }
+    while (*end != '"') {
+      if (*end == '\\') end++;
+      end++;
+    }
+    decodeString(json, position, s);
+    //decodeString() skips four characters after "\u" without looking at them, so it might disagree with the index.
+    return position == (uint32_t)(end - data) + 1;
+  };
+
+  auto decodeKey = [&](size_t &i, std::string &key) {
+    if (i + 1 >= count || data[positions[i]] != '"' || data[positions[i + 1]] != ':') return false;
+    if (!decodeIndexedString(i, key)) return false;
+    i += 2;
+    return true;
+  };
+
+  struct Frame {
+    PVariable container;
+
+    /**
+     * The key of the container in its parent struct.
+     */
+    std::string key;
+
+    /**
+     * The StructBuilder mark of the container if it is a struct.
+     */
+    size_t mark;
+  };
+  std::vector<Frame> stack;
+  auto builderMark = structBuilder.begin();
+
+  bool result = false;
+  try {
+    size_t i = 0;
+    std::string key;
+    PVariable value = variable;
+    while (i < count) {
+      uint32_t position = positions[i++];
+      char c = data[position];
+      if (c == '{' || c == '[') {
+        if (stack.size() == maxDepth) break; //Too deep, the fallback throws.
+        bool isStruct = c == '{';
+        if (isStruct) {
+          value->type = VariableType::tStruct;
+          if (arena) value->structValue = std::allocate_shared<Struct>(ArenaAllocator<Struct>(arena));
+        } else {
+          value->type = VariableType::tArray;
+          if (arena) value->arrayValue = std::allocate_shared<Array>(ArenaAllocator<Array>(arena));
+        }
+        if (i < count && data[positions[i]] == (isStruct ? '}' : ']')) i++; //Empty
+        else {
+          stack.push_back(Frame{std::move(value), std::move(key), structBuilder.begin()});
+          if (isStruct && !decodeKey(i, key)) break;
+          value = createVariable(arena);
+          continue;
+        }
+      } else if (c == '"') {
+        value->type = VariableType::tString;
+        if (!decodeIndexedString(i - 1, value->stringValue)) break;
+      } else if (c == 't' || c == 'f' || c == 'n') {
+        const char *literal = c == 't' ? "true" : (c == 'f' ? "false" : "null");
+        uint32_t length = c == 'f' ? 5 : 4;
+        if (json.size() - position < length || std::memcmp(data + position, literal, length) != 0 || !valueEnds(position + length)) break;
+        if (c == 'n') value->type = VariableType::tVoid;
+        else {
+          value->type = VariableType::tBoolean;
+          value->booleanValue = c == 't';
+        }
+      } else if (c == '-' || (c >= '0' && c <= '9')) {
+        if (!decodeNumber(json, position, value) || !valueEnds(position)) break;
+      } else break;
+
+      //The value is complete. Add it to its container and close all containers ending here.
+      bool next = false;
+      while (!stack.empty() && i < count) {
+        auto &top = stack.back();
+        char delimiter = data[positions[i++]];
+        bool isStruct = top.container->type == VariableType::tStruct;
+        if (isStruct) structBuilder.add(*top.container->structValue, top.mark, std::move(key), std::move(value));
+        else top.container->arrayValue->push_back(std::move(value));
+        if (delimiter == ',') {
+          if (isStruct && !decodeKey(i, key)) break;
+          value = createVariable(arena);
+          next = true;
+          break;
+        } else if (delimiter != (isStruct ? '}' : ']')) break;
+        if (isStruct) structBuilder.end(*top.container->structValue, top.mark);
+        value = std::move(top.container);
+        key = std::move(top.key);
+        stack.pop_back();
       }
-      if (json[pos] == '}') {
-        pos++;
-        return;
+      if (!next) {
+        //Anything after the top level value is left to the fallback, as are unterminated containers.
+        result = stack.empty() && i == count && value;
+        break;
       }
-      throw JsonDecoderException("Invalid data after object name.");
     }
+  } catch (const JsonDecoderException &ex) {
+    result = false;
+  }
+  structBuilder.discard(builderMark);
+  if (index.size() > 1048576) index.clear();
+  return result;
+}
+
+bool JsonDecoder::posValid(std::string_view json, uint32_t pos) {
+  return pos < json.length();
+}
+
+void JsonDecoder::skipWhitespace(std::string_view json, uint32_t &pos) {
+  while (pos < json.length() && (json[pos] == ' ' || json[pos] == '\n' || json[pos] == '\r' || json[pos] == '\t')) {
     pos++;
-    skipWhitespace(json, pos);
-    if (!posValid(json, pos)) throw JsonDecoderException("No closing '}' found.");
-    auto element = std::make_shared<Variable>();
-    if (!decodeValue(json, pos, element)) throw JsonDecoderException("Invalid JSON.");
-    variable->structValue->insert(StructElement(name, element));
-    skipWhitespace(json, pos);
-    if (!posValid(json, pos)) throw JsonDecoderException("No closing '}' found.");
-    if (json[pos] == ',') {
-      pos++;
-      skipWhitespace(json, pos);
-      if (!posValid(json, pos)) throw JsonDecoderException("No closing '}' found.");
-      continue;
-    }
-    if (json[pos] == '}') {
-      pos++;
-      return;
-    }
-    throw JsonDecoderException("No closing '}' found.");
   }
 }
 
-void JsonDecoder::decodeObject(const std::vector<char> &json, uint32_t &pos, PVariable &variable) {
+void JsonDecoder::decodeObject(std::string_view json, uint32_t &pos, PVariable &variable, const PArena &arena, uint32_t depth) {
+  if (depth == maxDepth) throw JsonDecoderException("Maximum nesting depth exceeded.");
   variable->type = VariableType::tStruct;
+  if (arena) variable->structValue = std::allocate_shared<Struct>(ArenaAllocator<Struct>(arena));
   if (!posValid(json, pos)) return;
   if (json[pos] == '{') {
     pos++;
@@ -164,14 +261,37 @@ void JsonDecoder::decodeObject(const std::vector<char> &json, uint32_t &pos, PVa
     return; //Empty object
   }
 
-  while (pos < json.size()) {
-    if (json[pos] != '"') throw JsonDecoderException("Object element has no name.");
-    std::string name;
-    decodeString(json, pos, name);
-    skipWhitespace(json, pos);
-    if (!posValid(json, pos)) throw JsonDecoderException("No closing '}' found.");
-    if (json[pos] != ':') {
-      variable->structValue->insert(StructElement(name, std::make_shared<Variable>()));
+  auto mark = structBuilder.begin();
+  try {
+    while (pos < json.length()) {
+      if (json[pos] != '"') throw JsonDecoderException("Object element has no name.");
+      std::string name;
+      decodeString(json, pos, name);
+      skipWhitespace(json, pos);
+      if (!posValid(json, pos)) throw JsonDecoderException("No closing '}' found.");
+      if (json[pos] != ':') {
+        structBuilder.add(*variable->structValue, mark, std::move(name), createVariable(arena));
+        if (json[pos] == ',') {
+          pos++;
+          skipWhitespace(json, pos);
+          if (!posValid(json, pos)) throw JsonDecoderException("No closing '}' found.");
+          continue;
+        }
+        if (json[pos] == '}') {
+          pos++;
+          structBuilder.end(*variable->structValue, mark);
+          return;
+        }
+        throw JsonDecoderException("Invalid data after object name.");
+      }
+      pos++;
+      skipWhitespace(json, pos);
+      if (!posValid(json, pos)) throw JsonDecoderException("No closing '}' found.");
+      auto element = createVariable(arena);
+      if (!decodeValue(json, pos, element, arena, depth + 1)) throw JsonDecoderException("Invalid JSON.");
+      structBuilder.add(*variable->structValue, mark, std::move(name), std::move(element));
+      skipWhitespace(json, pos);
+      if (!posValid(json, pos)) throw JsonDecoderException("No closing '}' found.");
       if (json[pos] == ',') {
         pos++;
         skipWhitespace(json, pos);
@@ -180,34 +300,22 @@ void JsonDecoder::decodeObject(const std::vector<char> &json, uint32_t &pos, PVa
       }
       if (json[pos] == '}') {
         pos++;
+        structBuilder.end(*variable->structValue, mark);
         return;
       }
-      throw JsonDecoderException("Invalid data after object name.");
-    }
-    pos++;
-    skipWhitespace(json, pos);
-    if (!posValid(json, pos)) throw JsonDecoderException("No closing '}' found.");
-    auto element = std::make_shared<Variable>();
-    if (!decodeValue(json, pos, element)) throw JsonDecoderException("Invalid JSON.");
-    variable->structValue->insert(StructElement(name, element));
-    skipWhitespace(json, pos);
-    if (!posValid(json, pos)) throw JsonDecoderException("No closing '}' found.");
-    if (json[pos] == ',') {
-      pos++;
-      skipWhitespace(json, pos);
-      if (!posValid(json, pos)) throw JsonDecoderException("No closing '}' found.");
-      continue;
-    }
-    if (json[pos] == '}') {
-      pos++;
-      return;
+      throw JsonDecoderException("No closing '}' found.");
     }
-    throw JsonDecoderException("No closing '}' found.");
+    structBuilder.end(*variable->structValue, mark);
+  } catch (...) {
+    structBuilder.discard(mark);
+    throw;
   }
 }
 
-void JsonDecoder::decodeArray(const std::string &json, uint32_t &pos, PVariable &variable) {
+void JsonDecoder::decodeArray(std::string_view json, uint32_t &pos, PVariable &variable, const PArena &arena, uint32_t depth) {
+  if (depth == maxDepth) throw JsonDecoderException("Maximum nesting depth exceeded.");
   variable->type = VariableType::tArray;
+  if (arena) variable->arrayValue = std::allocate_shared<Array>(ArenaAllocator<Array>(arena));
   if (!posValid(json, pos)) return;
   if (json[pos] == '[') {
     pos++;
@@ -222,44 +330,9 @@ void JsonDecoder::decodeArray(const std::string &json, uint32_t &pos, PVariable
   }
 
   while (pos < json.length()) {
-    auto element = std::make_shared<Variable>();
-    if (!decodeValue(json, pos, element)) throw JsonDecoderException("Invalid JSON.");
-    variable->arrayValue->push_back(element);
-    skipWhitespace(json, pos);
-    if (!posValid(json, pos)) throw JsonDecoderException("No closing ']' found.");
-    if (json[pos] == ',') {
-      pos++;
-      skipWhitespace(json, pos);
-      if (!posValid(json, pos)) throw JsonDecoderException("No closing ']' found.");
-      continue;
-    }
-    if (json[pos] == ']') {
-      pos++;
-      return;
-    }
-    throw JsonDecoderException("No closing ']' found.");
-  }
-}
-
-void JsonDecoder::decodeArray(const std::vector<char> &json, uint32_t &pos, PVariable &variable) {
-  variable->type = VariableType::tArray;
-  if (!posValid(json, pos)) return;
-  if (json[pos] == '[') {
-    pos++;
-    if (!posValid(json, pos)) throw JsonDecoderException("No closing ']' found.");
-  }
-
-  skipWhitespace(json, pos);
-  if (!posValid(json, pos)) throw JsonDecoderException("No closing ']' found.");
-  if (json[pos] == ']') {
-    pos++;
-    return; //Empty array
-  }
-
-  while (pos < json.size()) {
-    auto element = std::make_shared<Variable>();
-    if (!decodeValue(json, pos, element)) throw JsonDecoderException("Invalid JSON.");
-    variable->arrayValue->push_back(element);
+    auto element = createVariable(arena);
+    if (!decodeValue(json, pos, element, arena, depth + 1)) throw JsonDecoderException("Invalid JSON.");
+    variable->arrayValue->push_back(std::move(element));
     skipWhitespace(json, pos);
     if (!posValid(json, pos)) throw JsonDecoderException("No closing ']' found.");
     if (json[pos] == ',') {
@@ -276,15 +349,8 @@ void JsonDecoder::decodeArray(const std::vector<char> &json, uint32_t &pos, PVar
   }
 }
 
-void JsonDecoder::decodeString(const std::string &json, uint32_t &pos, PVariable &value) {
+void JsonDecoder::decodeString(std::string_view json, uint32_t &pos, PVariable &value) {
   value->type = VariableType::tString;
-  std::string s;
-  decodeString(json, pos, value->stringValue);
-}
-
-void JsonDecoder::decodeString(const std::vector<char> &json, uint32_t &pos, PVariable &value) {
-  value->type = VariableType::tString;
-  std::string s;
   decodeString(json, pos, value->stringValue);
 }
 
@@ -349,7 +415,7 @@ std::string JsonDecoder::decodeString(const std::string &s) {
   return utf8;
 }
 
-void JsonDecoder::decodeString(const std::string &json, uint32_t &pos, std::string &s) {
+void JsonDecoder::decodeString(std::string_view json, uint32_t &pos, std::string &s) {
   s.clear(); //String is expected to be UTF-8, except "\uXXXX". This is how Webapps encode JSONs.
   s.reserve(1024);
   std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t> converter;
@@ -417,74 +483,6 @@ void JsonDecoder::decodeString(const std::string &json, uint32_t &pos, std::stri
   throw JsonDecoderException("No closing '\"' found.");
 }
 
-void JsonDecoder::decodeString(const std::vector<char> &json, uint32_t &pos, std::string &s) {
-  s.clear(); //String is expected to be UTF-8, except "\uXXXX". This is how Webapps encode JSONs.
-  s.reserve(1024);
-  std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t> converter;
-  if (!posValid(json, pos)) throw JsonDecoderException("No closing '\"' found.");
-  if (json[pos] == '"') {
-    pos++;
-    if (!posValid(json, pos)) throw JsonDecoderException("No closing '\"' found.");
-  }
-  while (pos < json.size()) {
-    char c = json[pos];
-    if (c == '\\') {
-      pos++;
-      if (!posValid(json, pos)) throw JsonDecoderException("No closing '\"' found.");
-      c = json[pos];
-      switch (c) {
-        case 'b':s.push_back('\b');
-          break;
-        case 'f':s.push_back('\f');
-          break;
-        case 'n':s.push_back('\n');
-          break;
-        case 'r':s.push_back('\r');
-          break;
-        case 't':s.push_back('\t');
-          break;
-        case 'u': {
-          pos += 4;
-          if (!posValid(json, pos)) throw JsonDecoderException("No closing '\"' found.");
-          std::string hex1(json.data() + (pos - 3), 2);
-          std::string hex2(json.data() + (pos - 1), 2);
-          char16_t c16 = ((char16_t)(uint16_t)(Math::getNumber(hex1, true) << 8)) | ((char16_t)(uint16_t)Math::getNumber(hex2, true));
-          if (c16 != 0 && ((uint16_t)c16 < 0xDC00 || (uint16_t)c16 > 0xDFFF)) //Ignore low surrogates as first character
-          {
-            if ((uint16_t)c16 >= 0xD800 && (uint16_t)c16 <= 0xDBFF) //High surrogate => a second character follows
-            {
-              std::u16string utf16;
-              utf16.reserve(2);
-              utf16.push_back(c16);
-              pos += 6;
-              if (!posValid(json, pos)) throw JsonDecoderException("No closing '\"' found.");
-              if (json.at(pos - 5) != '\\' || json.at(pos - 4) != 'u') throw JsonDecoderException("Invalid UTF-16 in JSON.");
-              std::string hex3(json.data() + (pos - 3), 2);
-              std::string hex4(json.data() + (pos - 1), 2);
-              c16 = ((char16_t)(uint16_t)(Math::getNumber(hex3, true) << 8)) | ((char16_t)(uint16_t)Math::getNumber(hex4, true));
-              utf16.push_back(c16);
-              auto utf8Char = converter.to_bytes(utf16);
-              if (!utf8Char.empty()) s.insert(s.end(), utf8Char.begin(), utf8Char.end());
-            } else {
-              auto utf8Char = converter.to_bytes(c16);
-              if (!utf8Char.empty()) s.insert(s.end(), utf8Char.begin(), utf8Char.end());
-            }
-          }
-        }
-          break;
-        default:s.push_back(json[pos]);
-      }
-    } else if (c == '"') {
-      pos++;
-      s.shrink_to_fit();
-      return;
-    } else s.push_back(json[pos]);
-    pos++;
-    if (s.size() + 4 > s.capacity()) s.reserve(s.capacity() + 1024);
-  }
-  throw JsonDecoderException("No closing '\"' found.");
-}
-
 #else
 
 std::string JsonDecoder::decodeString(const std::string& s)
@@ -537,7 +535,7 @@ std::string JsonDecoder::decodeString(const std::string& s)
     return result;
 }
 
-void JsonDecoder::decodeString(const std::string& json, uint32_t& pos, std::string& s)
+void JsonDecoder::decodeString(std::string_view json, uint32_t& pos, std::string& s)
 {
     s.clear();
     if(!posValid(json, pos)) throw JsonDecoderException("No closing '\"' found.");
@@ -597,92 +595,9 @@ void JsonDecoder::decodeString(const std::string& json, uint32_t& pos, std::stri
     throw JsonDecoderException("No closing '\"' found.");
 }
 
-void JsonDecoder::decodeString(const std::vector<char>& json, uint32_t& pos, std::string& s)
-{
-    s.clear();
-    if(!posValid(json, pos)) throw JsonDecoderException("No closing '\"' found.");
-    if(json[pos] == '"')
-    {
-        pos++;
-        if(!posValid(json, pos)) throw JsonDecoderException("No closing '\"' found.");
-    }
-    while(pos < json.size())
-    {
-        char c = json[pos];
-        if(c == '\\')
-        {
-            pos++;
-            if(!posValid(json, pos)) throw JsonDecoderException("No closing '\"' found.");
-            c = json[pos];
-            switch(c)
-            {
-            case 'b':
-                s.push_back('\b');
-                break;
-            case 'f':
-                s.push_back('\f');
-                break;
-            case 'n':
-                s.push_back('\n');
-                break;
-            case 'r':
-                s.push_back('\r');
-                break;
-            case 't':
-                s.push_back('\t');
-                break;
-            case 'u':
-                {
-                    pos += 4;
-                    if(!posValid(json, pos)) throw JsonDecoderException("No closing '\"' found.");
-                    std::string hex1(json.data() + (pos - 3), 2);
-                    std::string hex2(json.data() + (pos - 1), 2);
-                    s.push_back((char)(uint8_t)Math::getNumber(hex1, true));
-                    s.push_back((char)(uint8_t)Math::getNumber(hex2, true));
-                }
-                break;
-            default:
-                s.push_back(json[pos]);
-            }
-        }
-        else if(c == '"')
-        {
-            pos++;
-            return;
-        }
-        else if((unsigned)c < 0x20) throw JsonDecoderException("Invalid character in string.");
-        else s.push_back(json[pos]);
-        pos++;
-    }
-    throw JsonDecoderException("No closing '\"' found.");
-}
-
 #endif
 
-bool JsonDecoder::decodeValue(const std::string &json, uint32_t &pos, PVariable &value) {
-  if (!posValid(json, pos)) return false;
-  switch (json[pos]) {
-    case 'n':decodeNull(json, pos, value);
-      break;
-    case 't':decodeBoolean(json, pos, value);
-      break;
-    case 'f':decodeBoolean(json, pos, value);
-      break;
-    case '"':decodeString(json, pos, value);
-      break;
-    case '{':decodeObject(json, pos, value);
-      break;
-    case '[':decodeArray(json, pos, value);
-      break;
-    default: {
-      if (!decodeNumber(json, pos, value)) return false;
-      break;
-    }
-  }
-  return true;
-}
-
-bool JsonDecoder::decodeValue(const std::vector<char> &json, uint32_t &pos, PVariable &value) {
+bool JsonDecoder::decodeValue(std::string_view json, uint32_t &pos, PVariable &value, const PArena &arena, uint32_t depth) {
   if (!posValid(json, pos)) return false;
   switch (json[pos]) {
     case 'n':decodeNull(json, pos, value);
@@ -693,9 +608,9 @@ bool JsonDecoder::decodeValue(const std::vector<char> &json, uint32_t &pos, PVar
       break;
     case '"':decodeString(json, pos, value);
       break;
-    case '{':decodeObject(json, pos, value);
+    case '{':decodeObject(json, pos, value, arena, depth);
       break;
-    case '[':decodeArray(json, pos, value);
+    case '[':decodeArray(json, pos, value, arena, depth);
       break;
     default: {
       if (!decodeNumber(json, pos, value)) return false;
@@ -705,7 +620,7 @@ bool JsonDecoder::decodeValue(const std::vector<char> &json, uint32_t &pos, PVar
   return true;
 }
 
-void JsonDecoder::decodeBoolean(const std::string &json, uint32_t &pos, PVariable &value) {
+void JsonDecoder::decodeBoolean(std::string_view json, uint32_t &pos, PVariable &value) {
   value->type = VariableType::tBoolean;
   if (!posValid(json, pos)) return;
   if (json[pos] == 't') {
@@ -717,29 +632,12 @@ void JsonDecoder::decodeBoolean(const std::string &json, uint32_t &pos, PVariabl
   }
 }
 
-void JsonDecoder::decodeBoolean(const std::vector<char> &json, uint32_t &pos, PVariable &value) {
-  value->type = VariableType::tBoolean;
-  if (!posValid(json, pos)) return;
-  if (json[pos] == 't') {
-    value->booleanValue = true;
-    pos += 4;
-  } else {
-    value->booleanValue = false;
-    pos += 5;
-  }
-}
-
-void JsonDecoder::decodeNull(const std::string &json, uint32_t &pos, PVariable &value) {
-  value->type = VariableType::tVoid;
-  pos += 4;
-}
-
-void JsonDecoder::decodeNull(const std::vector<char> &json, uint32_t &pos, PVariable &value) {
+void JsonDecoder::decodeNull(std::string_view, uint32_t &pos, PVariable &value) {
   value->type = VariableType::tVoid;
   pos += 4;
 }
 
-bool JsonDecoder::decodeNumber(const std::string &json, uint32_t &pos, PVariable &value) {
+bool JsonDecoder::decodeNumber(std::string_view json, uint32_t &pos, PVariable &value) {
   value->type = VariableType::tInteger;
   if (!posValid(json, pos)) return false;
   bool minus = false;
@@ -752,192 +650,55 @@ bool JsonDecoder::decodeNumber(const std::string &json, uint32_t &pos, PVariable
     if (!posValid(json, pos)) return false;
   }
 
+  //Integers are accumulated directly. Everything else is passed to Math::parseDouble() afterwards.
+  uint32_t start = pos;
+  uint64_t number = 0;
   bool isDouble = false;
-  int64_t number = 0;
   if (json[pos] == '0') {
-    number = 0;
     pos++;
-    if (!posValid(json, pos)) return true;
   } else if (json[pos] >= '1' && json[pos] <= '9') {
     while (pos < json.length() && json[pos] >= '0' && json[pos] <= '9') {
-      if (number >= 922337203685477580ll) {
-        value->type = VariableType::tFloat;
-        isDouble = true;
-        value->floatValue = number;
-        break;
-      }
-      number = number * 10 + (json[pos] - '0');
+      uint64_t digit = (uint64_t)(json[pos] - '0');
+      if (number > (UINT64_MAX - digit) / 10) isDouble = true;
+      else number = number * 10 + digit;
       pos++;
     }
   } else return false; //Invalid number => interpret as string
+  if (number > (minus ? 9223372036854775808ull : 9223372036854775807ull)) isDouble = true;
 
-  if (isDouble) {
+  if (posValid(json, pos) && json[pos] == '.') {
+    isDouble = true;
+    pos++;
     while (pos < json.length() && json[pos] >= '0' && json[pos] <= '9') {
-      value->floatValue = value->floatValue * 10 + (json[pos] - '0');
-      pos++;
-    }
-  }
-
-  int32_t exponent = 0;
-  if (posValid(json, pos)) {
-    if (json[pos] == '.') {
-      if (!isDouble) {
-        value->type = VariableType::tFloat;
-        isDouble = true;
-        value->floatValue = number;
-      }
-      pos++;
-      while (pos < json.length() && json[pos] >= '0' && json[pos] <= '9') {
-        value->floatValue = value->floatValue * 10 + (json[pos] - '0');
-        pos++;
-        exponent--;
-      }
-    }
-  }
-
-  int32_t exponent2 = 0;
-  if (posValid(json, pos)) {
-    if (json[pos] == 'e' || json[pos] == 'E') {
       pos++;
-      if (!posValid(json, pos)) return false;
-
-      bool negative = false;
-      if (json[pos] == '-') {
-        negative = true;
-        pos++;
-        if (!posValid(json, pos)) return false;
-      } else if (json[pos] == '+') {
-        pos++;
-        if (!posValid(json, pos)) return false;
-      }
-      if (json[pos] >= '0' && json[pos] <= '9') {
-        exponent2 = json[pos] - '0';
-        pos++;
-        while (pos < json.length() && json[pos] >= '0' && json[pos] <= '9') {
-          exponent2 = exponent2 * 10 + (json[pos] - '0');
-          pos++;
-        }
-      }
-      if (negative) exponent2 *= -1;
     }
   }
 
-  if (isDouble) {
-    exponent += exponent2;
-    if (exponent < -308) exponent = -308;
-    else if (exponent > 308) exponent = 308;
-    value->floatValue = (exponent >= 0) ? value->floatValue * Math::Pow10(exponent) : value->floatValue / Math::Pow10(-exponent);
-    if (minus) value->floatValue *= -1;
-    value->integerValue64 = std::llround(value->floatValue);
-    value->integerValue = std::lround(value->floatValue);
-  } else {
-    value->integerValue64 = minus ? -((int64_t)number) : number;
-
-    if (value->integerValue64 > 2147483647ll || value->integerValue64 < -2147483648ll) {
-      value->type = VariableType::tInteger64;
-    }
-
-    value->integerValue = value->integerValue64;
-    value->floatValue = value->integerValue64;
-  }
-
-  return true;
-}
-
-bool JsonDecoder::decodeNumber(const std::vector<char> &json, uint32_t &pos, PVariable &value) {
-  value->type = VariableType::tInteger;
-  if (!posValid(json, pos)) return false;
-  bool minus = false;
-  if (json[pos] == '-') {
-    minus = true;
-    pos++;
-    if (!posValid(json, pos)) return false;
-  } else if (json[pos] == '+') {
+  if (posValid(json, pos) && (json[pos] == 'e' || json[pos] == 'E')) {
     pos++;
     if (!posValid(json, pos)) return false;
-  }
-
-  bool isDouble = false;
-  int64_t number = 0;
-  if (json[pos] == '0') {
-    number = 0;
-    pos++;
-    if (!posValid(json, pos)) return true;
-  } else if (json[pos] >= '1' && json[pos] <= '9') {
-    while (pos < json.size() && json[pos] >= '0' && json[pos] <= '9') {
-      if (number >= 922337203685477580ll) {
-        value->type = VariableType::tFloat;
-        isDouble = true;
-        value->floatValue = number;
-        break;
-      }
-      number = number * 10 + (json[pos] - '0');
-      pos++;
-    }
-  } else return false; //Invalid number => interpret as string
-
-  if (isDouble) {
-    while (pos < json.size() && json[pos] >= '0' && json[pos] <= '9') {
-      value->floatValue = value->floatValue * 10 + (json[pos] - '0');
-      pos++;
-    }
-  }
-
-  int32_t exponent = 0;
-  if (posValid(json, pos)) {
-    if (json[pos] == '.') {
-      if (!isDouble) {
-        value->type = VariableType::tFloat;
-        isDouble = true;
-        value->floatValue = number;
-      }
-      pos++;
-      while (pos < json.size() && json[pos] >= '0' && json[pos] <= '9') {
-        value->floatValue = value->floatValue * 10 + (json[pos] - '0');
-        pos++;
-        exponent--;
-      }
-    }
-  }
-
-  int32_t exponent2 = 0;
-  if (posValid(json, pos)) {
-    if (json[pos] == 'e' || json[pos] == 'E') {
+    if (json[pos] == '-' || json[pos] == '+') {
       pos++;
       if (!posValid(json, pos)) return false;
-
-      bool negative = false;
-      if (json[pos] == '-') {
-        negative = true;
-        pos++;
-        if (!posValid(json, pos)) return false;
-      } else if (json[pos] == '+') {
-        pos++;
-        if (!posValid(json, pos)) return false;
-      }
-      if (json[pos] >= '0' && json[pos] <= '9') {
-        exponent2 = json[pos] - '0';
+    }
+    if (json[pos] >= '0' && json[pos] <= '9') {
+      isDouble = true;
+      while (pos < json.length() && json[pos] >= '0' && json[pos] <= '9') {
         pos++;
-        while (pos < json.size() && json[pos] >= '0' && json[pos] <= '9') {
-          exponent2 = exponent2 * 10 + (json[pos] - '0');
-          pos++;
-        }
       }
-      if (negative) exponent2 *= -1;
     }
   }
 
   if (isDouble) {
-    exponent += exponent2;
-    if (exponent < -308) exponent = -308;
-    else if (exponent > 308) exponent = 308;
-    value->floatValue = (exponent >= 0) ? value->floatValue * Math::Pow10(exponent) : value->floatValue / Math::Pow10(-exponent);
+    value->type = VariableType::tFloat;
+    Math::parseDouble(json.data() + start, json.data() + pos, value->floatValue);
+    //Numbers beyond the range of double are clamped, so no infinity reaches the encoders.
+    if (std::isinf(value->floatValue)) value->floatValue = std::numeric_limits<double>::max();
     if (minus) value->floatValue *= -1;
     value->integerValue64 = std::llround(value->floatValue);
     value->integerValue = std::lround(value->floatValue);
   } else {
-
-    value->integerValue64 = minus ? -((int64_t)number) : number;
+    value->integerValue64 = minus ? (int64_t)(0 - number) : (int64_t)number;
 
     if (value->integerValue64 > 2147483647ll || value->integerValue64 < -2147483648ll) {
       value->type = VariableType::tInteger64;
@@ -33,8 +33,10 @@
 
 #include "FlowException.h"
 #include "Variable.h"
+#include "Arena.h"
 #include "Math.h"
 #include <cmath>
+#include <string_view>
 #if __GNUC__ > 4
 #include <codecvt>
 #endif
@@ -51,33 +53,71 @@ class JsonDecoder {
   JsonDecoder() = default;
   ~JsonDecoder() = default;
 
+  /**
+   * The maximum nesting depth of arrays and objects. Deeper documents throw JsonDecoderException, so decoding can't
+   * overflow the stack.
+   */
+  static constexpr uint32_t maxDepth = 1000;
+
   static PVariable decode(const std::string &json);
   static PVariable decode(const std::string &json, uint32_t &bytesRead);
   static PVariable decode(const std::vector<char> &json);
   static PVariable decode(const std::vector<char> &json, uint32_t &bytesRead);
 
+  /**
+   * Decodes JSON from any contiguous buffer, e.g. a socket buffer or a memory mapped file, without copying it first.
+   *
+   * @param json The JSON to decode. Doesn't need to be null terminated.
+   * @param length The length of "json" in bytes.
+   * @return Returns the decoded Variable.
+   */
+  static PVariable decode(const char *json, size_t length);
+
+  /**
+   * Decodes the first JSON value in "json". Throws JsonDecoderException when it is invalid.
+   *
+   * @param json The JSON to decode. Doesn't need to be null terminated.
+   * @param length The length of "json" in bytes.
+   * @param[out] bytesRead The number of bytes the value was long.
+   * @return Returns the decoded Variable.
+   */
+  static PVariable decode(const char *json, size_t length, uint32_t &bytesRead);
+
+  /**
+   * Decodes JSON placing all Variables of the result in "arena". The arena is released when the last of them is gone
+   * (see Arena). Don't use the same arena from multiple threads at the same time.
+   *
+   * @param json The JSON to decode.
+   * @param arena The arena to allocate the Variables from.
+   * @return Returns the decoded Variable.
+   */
+  static PVariable decode(const std::string &json, const PArena &arena);
+  static PVariable decode(const std::vector<char> &json, const PArena &arena);
+  static PVariable decode(const char *json, size_t length, const PArena &arena);
+
   static std::string decodeString(const std::string &s);
  private:
-  static inline bool posValid(const std::string &json, uint32_t pos);
-  static inline bool posValid(const std::vector<char> &json, uint32_t pos);
-  static void skipWhitespace(const std::string &json, uint32_t &pos);
-  static void skipWhitespace(const std::vector<char> &json, uint32_t &pos);
-  static void decodeObject(const std::string &json, uint32_t &pos, PVariable &variable);
-  static void decodeObject(const std::vector<char> &json, uint32_t &pos, PVariable &variable);
-  static void decodeArray(const std::string &json, uint32_t &pos, PVariable &variable);
-  static void decodeArray(const std::vector<char> &json, uint32_t &pos, PVariable &variable);
-  static void decodeString(const std::string &json, uint32_t &pos, PVariable &value);
-  static void decodeString(const std::vector<char> &json, uint32_t &pos, PVariable &value);
-  static void decodeString(const std::string &json, uint32_t &pos, std::string &s);
-  static void decodeString(const std::vector<char> &json, uint32_t &pos, std::string &s);
-  static bool decodeValue(const std::string &json, uint32_t &pos, PVariable &value);
-  static bool decodeValue(const std::vector<char> &json, uint32_t &pos, PVariable &value);
-  static void decodeBoolean(const std::string &json, uint32_t &pos, PVariable &value);
-  static void decodeBoolean(const std::vector<char> &json, uint32_t &pos, PVariable &value);
-  static void decodeNull(const std::string &json, uint32_t &pos, PVariable &value);
-  static void decodeNull(const std::vector<char> &json, uint32_t &pos, PVariable &value);
-  static bool decodeNumber(const std::string &json, uint32_t &pos, PVariable &value);
-  static bool decodeNumber(const std::vector<char> &json, uint32_t &pos, PVariable &value);
+  static inline bool posValid(std::string_view json, uint32_t pos);
+  static void skipWhitespace(std::string_view json, uint32_t &pos);
+  static PVariable createVariable(const PArena &arena);
+  static PVariable decodeDocument(std::string_view json, const PArena &arena);
+
+  /**
+   * Decodes JSON in two stages: JsonStructuralIndex finds all tokens, then the Variables are created walking the
+   * index. Only handles well-formed JSON. For everything else false is returned and the caller falls back to the
+   * character by character decoder, which also handles the tolerated deviations from the standard.
+   *
+   * @return Returns false when "json" couldn't be decoded.
+   */
+  static bool decodeIndexed(std::string_view json, PVariable &variable, const PArena &arena);
+  static void decodeObject(std::string_view json, uint32_t &pos, PVariable &variable, const PArena &arena, uint32_t depth);
+  static void decodeArray(std::string_view json, uint32_t &pos, PVariable &variable, const PArena &arena, uint32_t depth);
+  static void decodeString(std::string_view json, uint32_t &pos, PVariable &value);
+  static void decodeString(std::string_view json, uint32_t &pos, std::string &s);
+  static bool decodeValue(std::string_view json, uint32_t &pos, PVariable &value, const PArena &arena, uint32_t depth = 0);
+  static void decodeBoolean(std::string_view json, uint32_t &pos, PVariable &value);
+  static void decodeNull(std::string_view json, uint32_t &pos, PVariable &value);
+  static bool decodeNumber(std::string_view json, uint32_t &pos, PVariable &value);
 };
 
 }
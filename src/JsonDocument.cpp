@@ -0,0 +1,153 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "JsonDocument.h"
+
+namespace Flows {
+
+JsonDocument::JsonDocument(std::string json) : _json(std::move(json)) {
+  if (!_index.build(_json.data(), _json.size())) throw JsonDecoderException("No closing '\"' found.");
+  const char *data = _json.data();
+  const uint32_t *positions = _index.positions();
+  _closing.resize(_index.size());
+  std::vector<uint32_t> openingBrackets;
+  for (uint32_t i = 0; i < _index.size(); i++) {
+    char c = data[positions[i]];
+    if (c == '{' || c == '[') openingBrackets.push_back(i);
+    else if (c == '}' || c == ']') {
+      if (openingBrackets.empty() || data[positions[openingBrackets.back()]] != (c == '}' ? '{' : '[')) throw JsonDecoderException("Unexpected '" + std::string(1, c) + "' at position " + std::to_string(positions[i]) + ".");
+      _closing[openingBrackets.back()] = i;
+      openingBrackets.pop_back();
+    }
+  }
+  if (!openingBrackets.empty()) throw JsonDecoderException(data[positions[openingBrackets.back()]] == '{' ? "No closing '}' found." : "No closing ']' found.");
+}
+
+bool JsonDocument::isOpening(size_t index) const {
+  char c = _json[_index.positions()[index]];
+  return c == '{' || c == '[';
+}
+
+uint32_t JsonDocument::stringEnd(uint32_t position) const {
+  //The index guarantees a closing quote.
+  const char *data = _json.data();
+  position++;
+  while (data[position] != '"') {
+    if (data[position] == '\\') position++;
+    position++;
+  }
+  return position;
+}
+
+bool JsonDocument::keyEquals(size_t index, const std::string &key) const {
+  uint32_t start = _index.positions()[index] + 1;
+  std::string_view rawKey(_json.data() + start, stringEnd(start - 1) - start);
+  if (rawKey.find('\\') == std::string_view::npos) return rawKey == key;
+  return JsonDecoder::decodeString(std::string(rawKey)) == key;
+}
+
+size_t JsonDocument::find(const MessageProperty &property) const {
+  const size_t count = _index.size();
+  const uint32_t *positions = _index.positions();
+  const char *data = _json.data();
+  if (count == 0 || !property.valid()) return count;
+
+  size_t current = 0;
+  for (auto &segment : property.segments()) {
+    char c = data[positions[current]];
+    //The first token inside of the array or struct.
+    size_t i = current + 1;
+    if (segment.isIndex) {
+      if (c != '[' || data[positions[i]] == ']') return count;
+      for (uint64_t element = 0; element < segment.index; element++) {
+        i = skip(i);
+        if (i >= count || data[positions[i]] != ',') return count;
+        i++;
+      }
+      if (i >= count) return count;
+      current = i;
+    } else {
+      if (c != '{') return count;
+      bool found = false;
+      //Elements are a key, a colon and the value. Keys that occur more than once resolve to the first occurrence like
+      //in JsonDecoder.
+      while (i + 2 < count && data[positions[i]] == '"' && data[positions[i + 1]] == ':') {
+        if (keyEquals(i, segment.key)) {
+          current = i + 2;
+          found = true;
+          break;
+        }
+        i = skip(i + 2);
+        if (i >= count || data[positions[i]] != ',') break;
+        i++;
+      }
+      if (!found) return count;
+    }
+  }
+  return current;
+}
+
+PVariable JsonDocument::get(const MessageProperty &property) const {
+  size_t index = find(property);
+  if (index == _index.size()) return PVariable();
+  const char *data = _json.data();
+  uint32_t start = _index.positions()[index];
+  char c = data[start];
+  if (c == '{' || c == '[') return JsonDecoder::decode(data + start, _index.positions()[_closing[index]] + 1 - start);
+  if (c == '"') return JsonDecoder::decode(data + start, stringEnd(start) + 1 - start);
+
+  //Numbers, true, false and null end at the next whitespace or structural character.
+  uint32_t end = start;
+  while (end < _json.size() && data[end] != ',' && data[end] != '}' && data[end] != ']' && data[end] != ' ' && data[end] != '\n' && data[end] != '\r' && data[end] != '\t') end++;
+  //The index also holds structural characters, so the token isn't necessarily a value, e.g. the "}" of {"a":}. The
+  //decoder stops at the first invalid character and doesn't check literals beyond their first character, so the whole
+  //token is validated here.
+  std::string_view token(data + start, end - start);
+  bool valid = false;
+  if (c == 't') valid = token == "true";
+  else if (c == 'f') valid = token == "false";
+  else if (c == 'n') valid = token == "null";
+  else valid = c == '-' || (c >= '0' && c <= '9');
+  if (!valid) throw JsonDecoderException("Invalid value at position " + std::to_string(start) + ".");
+  uint32_t bytesRead = 0;
+  PVariable value = JsonDecoder::decode(token.data(), token.size(), bytesRead);
+  if (bytesRead != token.size()) throw JsonDecoderException("Invalid value at position " + std::to_string(start) + ".");
+  return value;
+}
+
+bool JsonDocument::contains(const MessageProperty &property) const {
+  return find(property) != _index.size();
+}
+
+PVariable JsonDocument::decode() const {
+  return JsonDecoder::decode(_json);
+}
+
+}
@@ -0,0 +1,121 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#ifndef LIBHOMEGEAR_NODE_JSONDOCUMENT_H
+#define LIBHOMEGEAR_NODE_JSONDOCUMENT_H
+
+#include "JsonDecoder.h"
+#include "JsonStructuralIndex.h"
+#include "MessageProperty.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Flows {
+
+class JsonDocument;
+typedef std::shared_ptr<JsonDocument> PJsonDocument;
+
+/**
+ * A JSON document which is only decoded as far as it is accessed. On construction, only the structural index (see
+ * JsonStructuralIndex) is built and each opening bracket is linked to its closing one. Lookups then skip whole
+ * subtrees without looking at them, and only the accessed value is decoded into Variables.
+ *
+ * This pays off when only a few values of a large document are needed, e.g. to route a message on
+ * "payload.state". When most of the document is used anyway, decode it with JsonDecoder::decode().
+ */
+class JsonDocument {
+ public:
+  /**
+   * Indexes "json". The brackets are checked, everything else is only validated when it is decoded.
+   *
+   * @param json The JSON document. Pass an rvalue to avoid a copy.
+   * @throws JsonDecoderException when "json" contains an unterminated string or mismatched brackets.
+   */
+  explicit JsonDocument(std::string json);
+  ~JsonDocument() = default;
+
+  /**
+   * @return Returns the JSON the document was created from.
+   */
+  const std::string &json() const { return _json; }
+
+  /**
+   * Decodes the value at "property".
+   *
+   * @param property The path to the value, e.g. "payload.sensors[2].temperature".
+   * @return Returns the decoded value or nullptr when it doesn't exist.
+   * @throws JsonDecoderException when the value is not valid JSON.
+   */
+  PVariable get(const MessageProperty &property) const;
+  PVariable get(const std::string &property) const { return get(MessageProperty(property)); }
+
+  /**
+   * @return Returns true when the value at "property" exists. Nothing is decoded.
+   */
+  bool contains(const MessageProperty &property) const;
+
+  /**
+   * Decodes the whole document, like JsonDecoder::decode().
+   */
+  PVariable decode() const;
+ private:
+  std::string _json;
+  JsonStructuralIndex _index;
+
+  /**
+   * For every opening bracket in the index, the index of the matching closing bracket.
+   */
+  std::vector<uint32_t> _closing;
+
+  /**
+   * @return Returns the index of the value at "property" or the index size when it doesn't exist.
+   */
+  size_t find(const MessageProperty &property) const;
+
+  /**
+   * @return Returns the index of the first token after the value at "index".
+   */
+  size_t skip(size_t index) const { return isOpening(index) ? _closing[index] + 1 : index + 1; }
+
+  bool isOpening(size_t index) const;
+
+  /**
+   * @return Returns the position of the closing quote of the string starting at "position".
+   */
+  uint32_t stringEnd(uint32_t position) const;
+
+  bool keyEquals(size_t index, const std::string &key) const;
+};
+
+}
+
+#endif //LIBHOMEGEAR_NODE_JSONDOCUMENT_H
@@ -30,6 +30,7 @@
 
 #include "JsonEncoder.h"
 #include "Ansi.h"
+#include "VariableIterator.h"
 
 namespace Flows {
 
@@ -40,12 +41,14 @@ std::string JsonEncoder::getString(const PVariable &variable) {
   if (!variable) return "";
   std::ostringstream s;
   switch (variable->type) {
-    case VariableType::tStruct: encodeStruct(variable, s);
+    case VariableType::tStruct:
+    case VariableType::tArray: encodeContainer(*variable, s);
       break;
-    case VariableType::tArray: encodeArray(variable, s);
+    case VariableType::tInteger64Array:
+    case VariableType::tFloatArray: encodePackedArray(*variable, s);
       break;
     default: s << '[';
-      encodeValue(variable, s);
+      encodeValue(*variable, s);
       s << ']';
       break;
   }
@@ -57,23 +60,24 @@ std::vector<char> JsonEncoder::getVector(const PVariable &variable) {
   if (!variable) return json;
   json.reserve(1024);
   switch (variable->type) {
-    case VariableType::tStruct: encodeStruct(variable, json);
+    case VariableType::tStruct:
+    case VariableType::tArray: encodeContainer(*variable, json);
       break;
-    case VariableType::tArray: encodeArray(variable, json);
+    case VariableType::tInteger64Array:
+    case VariableType::tFloatArray: encodePackedArray(*variable, json);
       break;
     default: json.push_back('[');
-      encodeValue(variable, json);
+      encodeValue(*variable, json);
       json.push_back(']');
       break;
   }
   return json;
 }
 
-void JsonEncoder::encodeValue(const PVariable &variable, std::ostringstream &s) {
-  switch (variable->type) {
-    case VariableType::tArray: encodeArray(variable, s);
-      break;
-    case VariableType::tStruct: encodeStruct(variable, s);
+void JsonEncoder::encodeValue(const Variable &variable, std::ostringstream &s) {
+  switch (variable.type) {
+    case VariableType::tArray:
+    case VariableType::tStruct: encodeContainer(variable, s);
       break;
     case VariableType::tBoolean: encodeBoolean(variable, s);
       break;
@@ -93,15 +97,17 @@ void JsonEncoder::encodeValue(const PVariable &variable, std::ostringstream &s)
       break;
     case VariableType::tBinary: encodeVoid(variable, s);
       break;
+    case VariableType::tInteger64Array:
+    case VariableType::tFloatArray: encodePackedArray(variable, s);
+      break;
   }
 }
 
-void JsonEncoder::encodeValue(const PVariable &variable, std::vector<char> &s) {
+void JsonEncoder::encodeValue(const Variable &variable, std::vector<char> &s) {
   if (s.size() + 128 > s.capacity()) s.reserve(s.capacity() + 1024);
-  switch (variable->type) {
-    case VariableType::tArray: encodeArray(variable, s);
-      break;
-    case VariableType::tStruct: encodeStruct(variable, s);
+  switch (variable.type) {
+    case VariableType::tArray:
+    case VariableType::tStruct: encodeContainer(variable, s);
       break;
     case VariableType::tBoolean: encodeBoolean(variable, s);
       break;
@@ -121,78 +127,108 @@ void JsonEncoder::encodeValue(const PVariable &variable, std::vector<char> &s) {
       break;
     case VariableType::tBinary: encodeVoid(variable, s);
       break;
+    case VariableType::tInteger64Array:
+    case VariableType::tFloatArray: encodePackedArray(variable, s);
+      break;
   }
 }
 
-void JsonEncoder::encodeArray(const PVariable &variable, std::ostringstream &s) {
-  s << '[';
-  if (!variable->arrayValue->empty()) {
-    encodeValue(variable->arrayValue->at(0), s);
-    for (std::vector<PVariable>::iterator i = ++variable->arrayValue->begin(); i != variable->arrayValue->end(); ++i) {
-      s << ',';
-      encodeValue(*i, s);
+void JsonEncoder::encodeContainer(const Variable &variable, std::ostringstream &s) {
+  VariableIterator iterator(variable, 0);
+  while (iterator.next()) {
+    auto event = iterator.event();
+    if (event == VariableIterator::Event::endArray) {
+      s << ']';
+      continue;
+    } else if (event == VariableIterator::Event::endStruct) {
+      s << '}';
+      continue;
     }
+    if (!iterator.firstElement()) s << ',';
+    if (iterator.inStruct()) s << '"' << encodeString(iterator.key()) << "\":";
+    if (event == VariableIterator::Event::beginArray) s << '[';
+    else if (event == VariableIterator::Event::beginStruct) s << '{';
+    else if (iterator.variable()) encodeValue(*iterator.variable(), s);
+    else s << "null";
   }
-  s << ']';
 }
 
-void JsonEncoder::encodeArray(const PVariable &variable, std::vector<char> &s) {
-  s.push_back('[');
-  if (!variable->arrayValue->empty()) {
-    encodeValue(variable->arrayValue->at(0), s);
-    for (std::vector<PVariable>::iterator i = ++variable->arrayValue->begin(); i != variable->arrayValue->end(); ++i) {
-      s.push_back(',');
-      encodeValue(*i, s);
+void JsonEncoder::encodeContainer(const Variable &variable, std::vector<char> &s) {
+  VariableIterator iterator(variable, 0);
+  while (iterator.next()) {
+    auto event = iterator.event();
+    if (event == VariableIterator::Event::endArray) {
+      s.push_back(']');
+      continue;
+    } else if (event == VariableIterator::Event::endStruct) {
+      s.push_back('}');
+      continue;
+    }
+    if (!iterator.firstElement()) s.push_back(',');
+    if (iterator.inStruct()) {
+      s.push_back('"');
+      std::string key = encodeString(iterator.key());
+      s.insert(s.end(), key.begin(), key.end());
+      s.push_back('"');
+      s.push_back(':');
     }
+    if (event == VariableIterator::Event::beginArray) s.push_back('[');
+    else if (event == VariableIterator::Event::beginStruct) s.push_back('{');
+    else if (iterator.variable()) encodeValue(*iterator.variable(), s);
+    else encodeVoid(Variable(), s);
   }
-  s.push_back(']');
 }
 
-void JsonEncoder::encodeStruct(const PVariable &variable, std::ostringstream &s) {
-  s << '{';
-  if (!variable->structValue->empty()) {
-    s << '"';
-    s << variable->structValue->begin()->first;
-    s << "\":";
-    encodeValue(variable->structValue->begin()->second, s);
-    for (std::map<std::string, PVariable>::iterator i = ++variable->structValue->begin(); i != variable->structValue->end(); ++i) {
-      s << ',';
-      s << '"';
-      s << encodeString(i->first);
-      s << "\":";
-      encodeValue(i->second, s);
+void JsonEncoder::encodePackedArray(const Variable &variable, std::ostringstream &s) {
+  s << '[';
+  auto size = variable.packedArraySize();
+  if (variable.type == VariableType::tInteger64Array) {
+    auto integers = variable.packedIntegers();
+    for (size_t i = 0; i < size; i++) {
+      if (i != 0) s << ',';
+      s << std::to_string(integers[i]);
+    }
+  } else {
+    auto floats = variable.packedFloats();
+    s << std::fixed << std::setprecision(15);
+    for (size_t i = 0; i < size; i++) {
+      if (i != 0) s << ',';
+      if (std::isfinite(floats[i])) s << floats[i];
+      else s << "null";
     }
+    s << std::setprecision(6);
+    s.unsetf(std::ios_base::floatfield);
   }
-  s << '}';
+  s << ']';
 }
 
-void JsonEncoder::encodeStruct(const PVariable &variable, std::vector<char> &s) {
-  s.push_back('{');
-  if (!variable->structValue->empty()) {
-    s.push_back('"');
-    s.insert(s.end(), variable->structValue->begin()->first.begin(), variable->structValue->begin()->first.end());
-    s.push_back('"');
-    s.push_back(':');
-    encodeValue(variable->structValue->begin()->second, s);
-    for (std::map<std::string, PVariable>::iterator i = ++variable->structValue->begin(); i != variable->structValue->end(); ++i) {
-      s.push_back(',');
-      s.push_back('"');
-      std::string key = encodeString(i->first);
-      s.insert(s.end(), key.begin(), key.end());
-      s.push_back('"');
-      s.push_back(':');
-      encodeValue(i->second, s);
+void JsonEncoder::encodePackedArray(const Variable &variable, std::vector<char> &s) {
+  s.push_back('[');
+  auto size = variable.packedArraySize();
+  if (variable.type == VariableType::tInteger64Array) {
+    auto integers = variable.packedIntegers();
+    for (size_t i = 0; i < size; i++) {
+      if (i != 0) s.push_back(',');
+      std::string value(std::to_string(integers[i]));
+      s.insert(s.end(), value.begin(), value.end());
+    }
+  } else {
+    auto floats = variable.packedFloats();
+    for (size_t i = 0; i < size; i++) {
+      if (i != 0) s.push_back(',');
+      std::string value(std::isfinite(floats[i]) ? toString(floats[i]) : "null");
+      s.insert(s.end(), value.begin(), value.end());
     }
   }
-  s.push_back('}');
+  s.push_back(']');
 }
 
-void JsonEncoder::encodeBoolean(const PVariable &variable, std::ostringstream &s) {
-  s << ((variable->booleanValue) ? "true" : "false");
+void JsonEncoder::encodeBoolean(const Variable &variable, std::ostringstream &s) {
+  s << ((variable.booleanValue) ? "true" : "false");
 }
 
-void JsonEncoder::encodeBoolean(const PVariable &variable, std::vector<char> &s) {
-  if (variable->booleanValue) {
+void JsonEncoder::encodeBoolean(const Variable &variable, std::vector<char> &s) {
+  if (variable.booleanValue) {
     s.push_back('t');
     s.push_back('r');
     s.push_back('u');
@@ -206,31 +242,36 @@ void JsonEncoder::encodeBoolean(const PVariable &variable, std::vector<char> &s)
   }
 }
 
-void JsonEncoder::encodeInteger(const PVariable &variable, std::ostringstream &s) {
-  s << std::to_string(variable->integerValue);
+void JsonEncoder::encodeInteger(const Variable &variable, std::ostringstream &s) {
+  s << std::to_string(variable.integerValue);
 }
 
-void JsonEncoder::encodeInteger(const PVariable &variable, std::vector<char> &s) {
-  std::string value(std::to_string(variable->integerValue));
+void JsonEncoder::encodeInteger(const Variable &variable, std::vector<char> &s) {
+  std::string value(std::to_string(variable.integerValue));
   s.insert(s.end(), value.begin(), value.end());
 }
 
-void JsonEncoder::encodeInteger64(const PVariable &variable, std::ostringstream &s) {
-  s << std::to_string(variable->integerValue64);
+void JsonEncoder::encodeInteger64(const Variable &variable, std::ostringstream &s) {
+  s << std::to_string(variable.integerValue64);
 }
 
-void JsonEncoder::encodeInteger64(const PVariable &variable, std::vector<char> &s) {
-  std::string value(std::to_string(variable->integerValue64));
+void JsonEncoder::encodeInteger64(const Variable &variable, std::vector<char> &s) {
+  std::string value(std::to_string(variable.integerValue64));
   s.insert(s.end(), value.begin(), value.end());
 }
 
-void JsonEncoder::encodeFloat(const PVariable &variable, std::ostringstream &s) {
-  s << std::fixed << std::setprecision(15) << variable->floatValue << std::setprecision(6);
+void JsonEncoder::encodeFloat(const Variable &variable, std::ostringstream &s) {
+  //JSON has no representation for infinity and NaN.
+  if (!std::isfinite(variable.floatValue)) {
+    s << "null";
+    return;
+  }
+  s << std::fixed << std::setprecision(15) << variable.floatValue << std::setprecision(6);
   s.unsetf(std::ios_base::floatfield);
 }
 
-void JsonEncoder::encodeFloat(const PVariable &variable, std::vector<char> &s) {
-  std::string value(toString(variable->floatValue));
+void JsonEncoder::encodeFloat(const Variable &variable, std::vector<char> &s) {
+  std::string value(std::isfinite(variable.floatValue) ? toString(variable.floatValue) : "null");
   s.insert(s.end(), value.begin(), value.end());
 }
 
@@ -354,15 +395,15 @@ std::string JsonEncoder::encodeString(const std::string &s) {
   return result;
 }
 
-void JsonEncoder::encodeString(const std::shared_ptr<Variable> &variable, std::ostringstream &s) {
+void JsonEncoder::encodeString(const Variable &variable, std::ostringstream &s) {
   std::u16string utf16;
   try {
-    utf16 = std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t>{}.from_bytes(variable->stringValue);
+    utf16 = std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t>{}.from_bytes(variable.stringValue);
   }
   catch (const std::exception &) {
     //Fallback: Try converting byte by byte
     utf16.clear();
-    utf16.reserve(variable->stringValue.size());
+    utf16.reserve(variable.stringValue.size());
 
     /*
      * 0000 0000 – 0000 007F => 0xxxxxxx //UTF-8 = ASCII //First bit is always 0
@@ -371,17 +412,17 @@ void JsonEncoder::encodeString(const std::shared_ptr<Variable> &variable, std::o
      * 0001 0000 – 0010 FFFF => 11110xxx 10xxxxxx 10xxxxxx 10xxxxxx //First five bits of the first byte are always 11110, the first two bits of the following bytes are always 10
      */
 
-    for (int32_t i = 0; i < (signed)variable->stringValue.size(); i++) {
-      uint8_t b1 = (uint8_t)variable->stringValue.at(i);
+    for (int32_t i = 0; i < (signed)variable.stringValue.size(); i++) {
+      uint8_t b1 = (uint8_t)variable.stringValue.at(i);
       if (b1 & 0x80) //> 1 byte or invalid
       {
         std::string utf8String;
         bool invalid = false;
         if ((b1 & 0xE0) == 0xC0) //Two bytes
         {
-          if (i + 1 >= (signed)variable->stringValue.size()) invalid = true;
+          if (i + 1 >= (signed)variable.stringValue.size()) invalid = true;
           else {
-            auto b2 = (uint8_t)variable->stringValue.at(i + 1);
+            auto b2 = (uint8_t)variable.stringValue.at(i + 1);
             if ((b2 & 0xC0) == 0x80) {
               i++;
               utf8String = std::string{(char)b1, (char)b2};
@@ -389,10 +430,10 @@ void JsonEncoder::encodeString(const std::shared_ptr<Variable> &variable, std::o
           }
         } else if ((b1 & 0xF0) == 0xE0) //Three bytes
         {
-          if (i + 2 >= (signed)variable->stringValue.size()) invalid = true;
+          if (i + 2 >= (signed)variable.stringValue.size()) invalid = true;
           else {
-            auto b2 = (uint8_t)variable->stringValue.at(i + 1);
-            auto b3 = (uint8_t)variable->stringValue.at(i + 2);
+            auto b2 = (uint8_t)variable.stringValue.at(i + 1);
+            auto b3 = (uint8_t)variable.stringValue.at(i + 2);
             if ((b2 & 0xC0) == 0x80 && (b3 & 0xC0) == 0x80) {
               i += 2;
               utf8String = std::string{(char)b1, (char)b2, (char)b3};
@@ -400,11 +441,11 @@ void JsonEncoder::encodeString(const std::shared_ptr<Variable> &variable, std::o
           }
         } else if ((b1 & 0xF8) == 0xF0) //Four bytes
         {
-          if (i + 3 >= (signed)variable->stringValue.size()) invalid = true;
+          if (i + 3 >= (signed)variable.stringValue.size()) invalid = true;
           else {
-            auto b2 = (uint8_t)variable->stringValue.at(i + 1);
-            auto b3 = (uint8_t)variable->stringValue.at(i + 2);
-            auto b4 = (uint8_t)variable->stringValue.at(i + 3);
+            auto b2 = (uint8_t)variable.stringValue.at(i + 1);
+            auto b3 = (uint8_t)variable.stringValue.at(i + 2);
+            auto b4 = (uint8_t)variable.stringValue.at(i + 3);
             if ((b2 & 0xC0) == 0x80 && (b3 & 0xC0) == 0x80 && (b4 & 0xC0) == 0x80) {
               i += 3;
               utf8String = std::string{(char)b1, (char)b2, (char)b3, (char)b4};
@@ -461,15 +502,15 @@ void JsonEncoder::encodeString(const std::shared_ptr<Variable> &variable, std::o
   s << "\"";
 }
 
-void JsonEncoder::encodeString(const std::shared_ptr<Variable> &variable, std::vector<char> &s) {
+void JsonEncoder::encodeString(const Variable &variable, std::vector<char> &s) {
   std::u16string utf16;
   try {
-    utf16 = std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t>{}.from_bytes(variable->stringValue);
+    utf16 = std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t>{}.from_bytes(variable.stringValue);
   }
   catch (const std::exception &) {
     //Fallback: Try converting byte by byte
     utf16.clear();
-    utf16.reserve(variable->stringValue.size());
+    utf16.reserve(variable.stringValue.size());
 
     /*
      * 0000 0000 – 0000 007F => 0xxxxxxx //UTF-8 = ASCII //First bit is always 0
@@ -478,17 +519,17 @@ void JsonEncoder::encodeString(const std::shared_ptr<Variable> &variable, std::v
      * 0001 0000 – 0010 FFFF => 11110xxx 10xxxxxx 10xxxxxx 10xxxxxx //First five bits of the first byte are always 11110, the first two bits of the following bytes are always 10
      */
 
-    for (int32_t i = 0; i < (signed)variable->stringValue.size(); i++) {
-      uint8_t b1 = (uint8_t)variable->stringValue.at(i);
+    for (int32_t i = 0; i < (signed)variable.stringValue.size(); i++) {
+      uint8_t b1 = (uint8_t)variable.stringValue.at(i);
       if (b1 & 0x80) //> 1 byte or invalid
       {
         std::string utf8String;
         bool invalid = false;
         if ((b1 & 0xE0) == 0xC0) //Two bytes
         {
-          if (i + 1 >= (signed)variable->stringValue.size()) invalid = true;
+          if (i + 1 >= (signed)variable.stringValue.size()) invalid = true;
           else {
-            auto b2 = (uint8_t)variable->stringValue.at(i + 1);
+            auto b2 = (uint8_t)variable.stringValue.at(i + 1);
             if ((b2 & 0xC0) == 0x80) {
               i++;
               utf8String = std::string{(char)b1, (char)b2};
@@ -496,10 +537,10 @@ void JsonEncoder::encodeString(const std::shared_ptr<Variable> &variable, std::v
           }
         } else if ((b1 & 0xF0) == 0xE0) //Three bytes
         {
-          if (i + 2 >= (signed)variable->stringValue.size()) invalid = true;
+          if (i + 2 >= (signed)variable.stringValue.size()) invalid = true;
           else {
-            auto b2 = (uint8_t)variable->stringValue.at(i + 1);
-            auto b3 = (uint8_t)variable->stringValue.at(i + 2);
+            auto b2 = (uint8_t)variable.stringValue.at(i + 1);
+            auto b3 = (uint8_t)variable.stringValue.at(i + 2);
             if ((b2 & 0xC0) == 0x80 && (b3 & 0xC0) == 0x80) {
               i += 2;
               utf8String = std::string{(char)b1, (char)b2, (char)b3};
@@ -507,11 +548,11 @@ void JsonEncoder::encodeString(const std::shared_ptr<Variable> &variable, std::v
           }
         } else if ((b1 & 0xF8) == 0xF0) //Four bytes
         {
-          if (i + 3 >= (signed)variable->stringValue.size()) invalid = true;
+          if (i + 3 >= (signed)variable.stringValue.size()) invalid = true;
           else {
-            auto b2 = (uint8_t)variable->stringValue.at(i + 1);
-            auto b3 = (uint8_t)variable->stringValue.at(i + 2);
-            auto b4 = (uint8_t)variable->stringValue.at(i + 3);
+            auto b2 = (uint8_t)variable.stringValue.at(i + 1);
+            auto b3 = (uint8_t)variable.stringValue.at(i + 2);
+            auto b4 = (uint8_t)variable.stringValue.at(i + 3);
             if ((b2 & 0xC0) == 0x80 && (b3 & 0xC0) == 0x80 && (b4 & 0xC0) == 0x80) {
               i += 3;
               utf8String = std::string{(char)b1, (char)b2, (char)b3, (char)b4};
@@ -632,7 +673,7 @@ std::string JsonEncoder::encodeString(const std::string& s)
     return result;
 }
 
-void JsonEncoder::encodeString(const PVariable& variable, std::ostringstream& s)
+void JsonEncoder::encodeString(const Variable &variable, std::ostringstream& s)
 {
     //Source: https://github.com/miloyip/rapidjson/blob/master/include/rapidjson/writer.h
     static const char hexDigits[16] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F' };
@@ -651,7 +692,7 @@ void JsonEncoder::encodeString(const PVariable& variable, std::ostringstream& s)
         0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0  // E0-FF
     };
     s << "\"";
-    for(std::string::iterator i = variable->stringValue.begin(); i != variable->stringValue.end(); ++i)
+    for(std::string::const_iterator i = variable.stringValue.begin(); i != variable.stringValue.end(); ++i)
     {
         if(escape[(uint8_t)*i])
         {
@@ -666,12 +707,12 @@ void JsonEncoder::encodeString(const PVariable& variable, std::ostringstream& s)
     s << "\"";
 }
 
-void JsonEncoder::encodeString(const PVariable& variable, std::vector<char>& s)
+void JsonEncoder::encodeString(const Variable &variable, std::vector<char>& s)
 {
-    if(s.size() + variable->stringValue.size() + 128 > s.capacity())
+    if(s.size() + variable.stringValue.size() + 128 > s.capacity())
 
     {
-        int32_t factor = variable->stringValue.size() / 1024;
+        int32_t factor = variable.stringValue.size() / 1024;
         uint32_t neededSize = s.size() + (factor * 1024) + 1024;
         if(neededSize > s.capacity()) s.reserve(neededSize);
     }
@@ -693,7 +734,7 @@ void JsonEncoder::encodeString(const PVariable& variable, std::vector<char>& s)
         0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0  // E0-FF
     };
     s.push_back('"');
-    for(const uint8_t& c : variable->stringValue)
+    for(const uint8_t& c : variable.stringValue)
     {
         if(escape[c])
         {
@@ -714,11 +755,11 @@ void JsonEncoder::encodeString(const PVariable& variable, std::vector<char>& s)
 
 #endif
 
-void JsonEncoder::encodeVoid(const PVariable &variable, std::ostringstream &s) {
+void JsonEncoder::encodeVoid(const Variable &, std::ostringstream &s) {
   s << "null";
 }
 
-void JsonEncoder::encodeVoid(const PVariable &variable, std::vector<char> &s) {
+void JsonEncoder::encodeVoid(const Variable &, std::vector<char> &s) {
   s.push_back('n');
   s.push_back('u');
   s.push_back('l');
@@ -52,24 +52,24 @@ class JsonEncoder {
   static std::string encodeString(const std::string &s);
  private:
   static std::string toString(double number);
-  static void encodeValue(const PVariable &variable, std::ostringstream &s);
-  static void encodeValue(const PVariable &variable, std::vector<char> &s);
-  static void encodeArray(const PVariable &variable, std::ostringstream &s);
-  static void encodeArray(const PVariable &variable, std::vector<char> &s);
-  static void encodeStruct(const PVariable &variable, std::ostringstream &s);
-  static void encodeStruct(const PVariable &variable, std::vector<char> &s);
-  static void encodeBoolean(const PVariable &variable, std::ostringstream &s);
-  static void encodeBoolean(const PVariable &variable, std::vector<char> &s);
-  static void encodeInteger(const PVariable &variable, std::ostringstream &s);
-  static void encodeInteger(const PVariable &variable, std::vector<char> &s);
-  static void encodeInteger64(const PVariable &variable, std::ostringstream &s);
-  static void encodeInteger64(const PVariable &variable, std::vector<char> &s);
-  static void encodeFloat(const PVariable &variable, std::ostringstream &s);
-  static void encodeFloat(const PVariable &variable, std::vector<char> &s);
-  static void encodeString(const PVariable &variable, std::ostringstream &s);
-  static void encodeString(const PVariable &variable, std::vector<char> &s);
-  static void encodeVoid(const PVariable &variable, std::ostringstream &s);
-  static void encodeVoid(const PVariable &variable, std::vector<char> &s);
+  static void encodeValue(const Variable &variable, std::ostringstream &s);
+  static void encodeValue(const Variable &variable, std::vector<char> &s);
+  static void encodeContainer(const Variable &variable, std::ostringstream &s);
+  static void encodeContainer(const Variable &variable, std::vector<char> &s);
+  static void encodePackedArray(const Variable &variable, std::ostringstream &s);
+  static void encodePackedArray(const Variable &variable, std::vector<char> &s);
+  static void encodeBoolean(const Variable &variable, std::ostringstream &s);
+  static void encodeBoolean(const Variable &variable, std::vector<char> &s);
+  static void encodeInteger(const Variable &variable, std::ostringstream &s);
+  static void encodeInteger(const Variable &variable, std::vector<char> &s);
+  static void encodeInteger64(const Variable &variable, std::ostringstream &s);
+  static void encodeInteger64(const Variable &variable, std::vector<char> &s);
+  static void encodeFloat(const Variable &variable, std::ostringstream &s);
+  static void encodeFloat(const Variable &variable, std::vector<char> &s);
+  static void encodeString(const Variable &variable, std::ostringstream &s);
+  static void encodeString(const Variable &variable, std::vector<char> &s);
+  static void encodeVoid(const Variable &variable, std::ostringstream &s);
+  static void encodeVoid(const Variable &variable, std::vector<char> &s);
 };
 
 }
@@ -0,0 +1,150 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "JsonStreamDecoder.h"
+
+namespace Flows {
+
+namespace {
+
+inline bool isWhitespace(char c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+}
+
+void JsonStreamDecoder::push(const char *data, size_t length, std::vector<PVariable> &values) {
+  //The start of the current value in this chunk. 0 when it started in a previous chunk.
+  size_t start = 0;
+  size_t i = 0;
+  while (i < length) {
+    if (_state == State::betweenValues) {
+      while (i < length && isWhitespace(data[i])) i++;
+      if (i == length) break;
+      start = i;
+      char c = data[i++];
+      if (c == '{' || c == '[') {
+        _state = State::inContainer;
+        _depth = 1;
+      } else if (c == '"') {
+        _state = State::inString;
+        _depth = 0;
+      } else if (c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n') {
+        _state = State::inScalar;
+      } else fail("Invalid character at the start of a value: " + std::to_string((int32_t)(uint8_t)c));
+    } else if (_state == State::inContainer) {
+      for (; i < length; i++) {
+        char c = data[i];
+        if (c == '"') {
+          _state = State::inString;
+          i++;
+          break;
+        } else if (c == '{' || c == '[') _depth++;
+        else if ((c == '}' || c == ']') && --_depth == 0) {
+          i++;
+          complete(data + start, i - start, values);
+          break;
+        }
+      }
+    } else if (_state == State::inString) {
+      for (; i < length; i++) {
+        char c = data[i];
+        if (_escaped) _escaped = false;
+        else if (c == '\\') _escaped = true;
+        else if (c == '"') {
+          i++;
+          if (_depth == 0) complete(data + start, i - start, values);
+          else _state = State::inContainer;
+          break;
+        }
+      }
+    } else {
+      for (; i < length; i++) {
+        char c = data[i];
+        //The character ending the value is processed again as the start of the next one.
+        if (isWhitespace(c) || c == '{' || c == '}' || c == '[' || c == ']' || c == ',' || c == ':' || c == '"') {
+          complete(data + start, i - start, values);
+          break;
+        }
+      }
+    }
+  }
+
+  if (_state != State::betweenValues) {
+    if (_maxValueSize != 0 && _buffer.size() + (length - start) > _maxValueSize) fail("Value exceeds the maximum size of " + std::to_string(_maxValueSize) + " bytes.");
+    _buffer.append(data + start, length - start);
+  }
+}
+
+void JsonStreamDecoder::finish(std::vector<PVariable> &values) {
+  if (_state == State::inScalar) complete(nullptr, 0, values);
+  else if (_state != State::betweenValues) fail("Unexpected end of stream.");
+  reset();
+}
+
+void JsonStreamDecoder::reset() {
+  _state = State::betweenValues;
+  _depth = 0;
+  _escaped = false;
+  _buffer.clear();
+  if (_buffer.capacity() > 1048576) _buffer.shrink_to_fit();
+}
+
+void JsonStreamDecoder::complete(const char *data, size_t length, std::vector<PVariable> &values) {
+  if (_maxValueSize != 0 && _buffer.size() + length > _maxValueSize) fail("Value exceeds the maximum size of " + std::to_string(_maxValueSize) + " bytes.");
+  if (!_buffer.empty()) {
+    _buffer.append(data, length);
+    data = _buffer.data();
+    length = _buffer.size();
+  }
+
+  //The decoder stops at the first character not belonging to the value and doesn't check literals beyond their first
+  //character, so both are checked here.
+  std::string_view json(data, length);
+  if ((json[0] == 't' && json != "true") || (json[0] == 'f' && json != "false") || (json[0] == 'n' && json != "null")) fail("Invalid literal.");
+  PVariable value;
+  uint32_t bytesRead = 0;
+  try {
+    value = JsonDecoder::decode(data, length, bytesRead);
+  } catch (const JsonDecoderException &ex) {
+    reset();
+    throw;
+  }
+  if (bytesRead != length) fail("Invalid value.");
+  reset();
+  values.push_back(std::move(value));
+}
+
+void JsonStreamDecoder::fail(const std::string &message) {
+  reset();
+  throw JsonDecoderException(message);
+}
+
+}
@@ -0,0 +1,115 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#ifndef LIBHOMEGEAR_NODE_JSONSTREAMDECODER_H
+#define LIBHOMEGEAR_NODE_JSONSTREAMDECODER_H
+
+#include "JsonDecoder.h"
+
+#include <string>
+#include <vector>
+
+namespace Flows {
+
+/**
+ * Decodes a stream of JSON values (e.g. from TCP or a serial port) that arrives in arbitrary chunks. Values may be
+ * separated by whitespace (as in newline delimited JSON) or directly follow each other. The state of the current value
+ * is kept between calls to push(), so every byte is only looked at once to find the end of the value and once more
+ * to decode it, no matter how fragmented the stream is. Values contained in one chunk are decoded without copying
+ * them.
+ *
+ * Numbers, true, false and null on the top level are only complete once the next character arrives. Call finish() at
+ * the end of the stream to get them.
+ */
+class JsonStreamDecoder {
+ public:
+  /**
+   * @param maxValueSize The maximum size of one value in bytes. 0 means unlimited. Limits the memory used on streams
+   * that never complete a value.
+   */
+  explicit JsonStreamDecoder(size_t maxValueSize = 0) : _maxValueSize(maxValueSize) {}
+  ~JsonStreamDecoder() = default;
+
+  /**
+   * Processes the next chunk of the stream.
+   *
+   * @param data The chunk.
+   * @param length The length of "data" in bytes.
+   * @param[out] values All values completed by this chunk are appended here.
+   * @throws JsonDecoderException when the stream contains invalid JSON or a value exceeds the maximum size. The values
+   * completed before the error have been appended to "values". The rest of the chunk is discarded and the decoder is
+   * reset, so it can be used for the next chunk.
+   */
+  void push(const char *data, size_t length, std::vector<PVariable> &values);
+  void push(const std::string &data, std::vector<PVariable> &values) { push(data.data(), data.size(), values); }
+
+  /**
+   * Completes a pending number, true, false or null at the end of the stream and resets the decoder.
+   *
+   * @param[out] values The completed value is appended here.
+   * @throws JsonDecoderException when the stream ended within a value or the pending value is invalid.
+   */
+  void finish(std::vector<PVariable> &values);
+
+  /**
+   * Discards the current value.
+   */
+  void reset();
+
+  /**
+   * @return Returns the number of bytes of the current value buffered from previous chunks.
+   */
+  size_t bufferedBytes() const { return _buffer.size(); }
+ private:
+  enum class State {
+    betweenValues,
+    inContainer,
+    inString,
+    inScalar
+  };
+
+  size_t _maxValueSize = 0;
+  std::string _buffer;
+  State _state = State::betweenValues;
+
+  /**
+   * The nesting depth of arrays and structs. For strings the state to return to after the closing quote is
+   * inContainer when this is not 0.
+   */
+  uint32_t _depth = 0;
+  bool _escaped = false;
+
+  void complete(const char *data, size_t length, std::vector<PVariable> &values);
+  [[noreturn]] void fail(const std::string &message);
+};
+
+}
+
+#endif //LIBHOMEGEAR_NODE_JSONSTREAMDECODER_H
@@ -0,0 +1,302 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "JsonStructuralIndex.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define JSONSTRUCTURALINDEX_X86
+#endif
+
+namespace Flows {
+
+namespace {
+
+/**
+ * One bit per byte of a 64 byte block.
+ */
+struct BlockMasks {
+  uint64_t quote;
+  uint64_t backslash;
+  uint64_t structural;
+  uint64_t whitespace;
+};
+
+struct Kernels {
+  const char *name;
+  void (*classify)(const char *data, size_t blocks, BlockMasks *masks);
+};
+
+constexpr uint8_t quoteClass = 1;
+constexpr uint8_t backslashClass = 2;
+constexpr uint8_t structuralClass = 4;
+constexpr uint8_t whitespaceClass = 8;
+
+const std::array<uint8_t, 256> &characterClasses() {
+  static const std::array<uint8_t, 256> classes = []() {
+    std::array<uint8_t, 256> result{};
+    result['"'] = quoteClass;
+    result['\\'] = backslashClass;
+    for (auto c : {'{', '}', '[', ']', ':', ','}) {
+      result[(uint8_t)c] = structuralClass;
+    }
+    for (auto c : {' ', '\t', '\n', '\r'}) {
+      result[(uint8_t)c] = whitespaceClass;
+    }
+    return result;
+  }();
+  return classes;
+}
+
+void classifyScalar(const char *data, size_t blocks, BlockMasks *masks) {
+  auto &classes = characterClasses();
+  for (size_t block = 0; block < blocks; block++, data += 64) {
+    BlockMasks &result = masks[block];
+    result = BlockMasks{0, 0, 0, 0};
+    for (uint32_t i = 0; i < 64; i++) {
+      uint8_t characterClass = classes[(uint8_t)data[i]];
+      result.quote |= (uint64_t)(characterClass & quoteClass) << i;
+      result.backslash |= (uint64_t)((characterClass & backslashClass) >> 1) << i;
+      result.structural |= (uint64_t)((characterClass & structuralClass) >> 2) << i;
+      result.whitespace |= (uint64_t)((characterClass & whitespaceClass) >> 3) << i;
+    }
+  }
+}
+
+#ifdef JSONSTRUCTURALINDEX_X86
+//'[' and ']' differ from '{' and '}' only in bit 5, so setting it reduces the four brackets to two comparisons.
+
+__attribute__((target("sse2")))
+void classifySse2(const char *data, size_t blocks, BlockMasks *masks) {
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i bit5 = _mm_set1_epi8(0x20);
+  const __m128i openingBrace = _mm_set1_epi8('{');
+  const __m128i closingBrace = _mm_set1_epi8('}');
+  const __m128i colon = _mm_set1_epi8(':');
+  const __m128i comma = _mm_set1_epi8(',');
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i lineFeed = _mm_set1_epi8('\n');
+  const __m128i carriageReturn = _mm_set1_epi8('\r');
+  for (size_t block = 0; block < blocks; block++, data += 64) {
+    BlockMasks &result = masks[block];
+    result = BlockMasks{0, 0, 0, 0};
+    for (uint32_t i = 0; i < 64; i += 16) {
+      __m128i chunk = _mm_loadu_si128((const __m128i *)(data + i));
+      __m128i folded = _mm_or_si128(chunk, bit5);
+      __m128i structural = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(folded, openingBrace), _mm_cmpeq_epi8(folded, closingBrace)), _mm_or_si128(_mm_cmpeq_epi8(chunk, colon), _mm_cmpeq_epi8(chunk, comma)));
+      __m128i whitespace = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab)), _mm_or_si128(_mm_cmpeq_epi8(chunk, lineFeed), _mm_cmpeq_epi8(chunk, carriageReturn)));
+      result.quote |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, quote)) << i;
+      result.backslash |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, backslash)) << i;
+      result.structural |= (uint64_t)(uint32_t)_mm_movemask_epi8(structural) << i;
+      result.whitespace |= (uint64_t)(uint32_t)_mm_movemask_epi8(whitespace) << i;
+    }
+  }
+}
+
+__attribute__((target("avx2")))
+void classifyAvx2(const char *data, size_t blocks, BlockMasks *masks) {
+  const __m256i quote = _mm256_set1_epi8('"');
+  const __m256i backslash = _mm256_set1_epi8('\\');
+  const __m256i bit5 = _mm256_set1_epi8(0x20);
+  const __m256i openingBrace = _mm256_set1_epi8('{');
+  const __m256i closingBrace = _mm256_set1_epi8('}');
+  const __m256i colon = _mm256_set1_epi8(':');
+  const __m256i comma = _mm256_set1_epi8(',');
+  const __m256i space = _mm256_set1_epi8(' ');
+  const __m256i tab = _mm256_set1_epi8('\t');
+  const __m256i lineFeed = _mm256_set1_epi8('\n');
+  const __m256i carriageReturn = _mm256_set1_epi8('\r');
+  for (size_t block = 0; block < blocks; block++, data += 64) {
+    BlockMasks &result = masks[block];
+    result = BlockMasks{0, 0, 0, 0};
+    for (uint32_t i = 0; i < 64; i += 32) {
+      __m256i chunk = _mm256_loadu_si256((const __m256i *)(data + i));
+      __m256i folded = _mm256_or_si256(chunk, bit5);
+      __m256i structural = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(folded, openingBrace), _mm256_cmpeq_epi8(folded, closingBrace)), _mm256_or_si256(_mm256_cmpeq_epi8(chunk, colon), _mm256_cmpeq_epi8(chunk, comma)));
+      __m256i whitespace = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, space), _mm256_cmpeq_epi8(chunk, tab)), _mm256_or_si256(_mm256_cmpeq_epi8(chunk, lineFeed), _mm256_cmpeq_epi8(chunk, carriageReturn)));
+      result.quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, quote)) << i;
+      result.backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, backslash)) << i;
+      result.structural |= (uint64_t)(uint32_t)_mm256_movemask_epi8(structural) << i;
+      result.whitespace |= (uint64_t)(uint32_t)_mm256_movemask_epi8(whitespace) << i;
+    }
+  }
+}
+#endif
+
+/**
+ * @return Returns the kernels supported by the CPU, the fastest first.
+ */
+const std::vector<Kernels> &availableKernels() {
+  static const std::vector<Kernels> supportedKernels = []() {
+    std::vector<Kernels> result;
+#ifdef JSONSTRUCTURALINDEX_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) result.push_back(Kernels{"avx2", &classifyAvx2});
+    if (__builtin_cpu_supports("sse2")) result.push_back(Kernels{"sse2", &classifySse2});
+#endif
+    result.push_back(Kernels{"scalar", &classifyScalar});
+    return result;
+  }();
+  return supportedKernels;
+}
+
+/**
+ * Sets every bit from each set bit up to (excluding) the next set bit. Applied to the quotes, this marks the inside of
+ * strings including the opening quote.
+ */
+inline uint64_t prefixXor(uint64_t bits) {
+  bits ^= bits << 1;
+  bits ^= bits << 2;
+  bits ^= bits << 4;
+  bits ^= bits << 8;
+  bits ^= bits << 16;
+  bits ^= bits << 32;
+  return bits;
+}
+
+/**
+ * State carried from one block to the next.
+ */
+struct BlockState {
+  /**
+   * 1 when the first character of the next block is escaped.
+   */
+  uint64_t escaped = 0;
+
+  /**
+   * All bits set when the next block starts inside of a string.
+   */
+  uint64_t inString = 0;
+
+  /**
+   * 1 when the last character of the block was part of a value other than a string.
+   */
+  uint64_t scalar = 0;
+};
+
+/**
+ * @return Returns the bits of the characters to add to the index.
+ */
+inline uint64_t processBlock(const BlockMasks &masks, BlockState &state) {
+  //Find the characters preceded by an odd number of backslashes. Runs of backslashes starting on an odd bit are
+  //moved to start on an even bit by the carry of the addition, so one mask of even bits can be used for all runs.
+  const uint64_t evenBits = 0x5555555555555555ull;
+  uint64_t backslash = masks.backslash & ~state.escaped;
+  uint64_t followsEscape = (backslash << 1) | state.escaped;
+  uint64_t oddSequenceStarts = backslash & ~evenBits & ~followsEscape;
+  uint64_t sequencesStartingOnEvenBits;
+  state.escaped = __builtin_add_overflow(oddSequenceStarts, backslash, &sequencesStartingOnEvenBits) ? 1 : 0;
+  uint64_t escaped = (evenBits ^ (sequencesStartingOnEvenBits << 1)) & followsEscape;
+
+  uint64_t quote = masks.quote & ~escaped;
+  uint64_t inString = prefixXor(quote) ^ state.inString;
+  state.inString = (uint64_t)((int64_t)inString >> 63);
+
+  //Values other than strings start at the first character which is neither whitespace, structural nor a quote.
+  uint64_t scalar = ~(masks.structural | masks.whitespace | quote);
+  uint64_t scalarStart = scalar & ~((scalar << 1) | state.scalar);
+  state.scalar = scalar >> 63;
+
+  return ((masks.structural | scalarStart) & ~inString) | (quote & inString);
+}
+
+}
+
+bool JsonStructuralIndex::build(const char *json, size_t size) {
+  _size = 0;
+  if (size > UINT32_MAX) return false;
+  auto classify = availableKernels()[_kernel].classify;
+  BlockState state;
+  constexpr size_t chunkBlocks = 64;
+  BlockMasks masks[chunkBlocks];
+  size_t fullBlocks = size / 64;
+  size_t blocks = (size + 63) / 64;
+  for (size_t chunkStart = 0; chunkStart < blocks; chunkStart += chunkBlocks) {
+    size_t chunkSize = std::min(chunkBlocks, blocks - chunkStart);
+    if (chunkStart + chunkSize > fullBlocks) {
+      //The last, incomplete block is padded with spaces, which never end up in the index.
+      if (chunkSize > 1) classify(json + chunkStart * 64, chunkSize - 1, masks);
+      char lastBlock[64];
+      std::memset(lastBlock, ' ', sizeof(lastBlock));
+      std::memcpy(lastBlock, json + fullBlocks * 64, size - fullBlocks * 64);
+      classify(lastBlock, 1, masks + chunkSize - 1);
+    } else classify(json + chunkStart * 64, chunkSize, masks);
+
+    //Every block adds at most 64 positions.
+    if (_positions.size() < _size + chunkSize * 64) _positions.resize(std::max(_size + chunkSize * 64, _positions.size() * 2));
+    uint32_t *positions = _positions.data();
+    for (size_t i = 0; i < chunkSize; i++) {
+      uint64_t bits = processBlock(masks[i], state);
+      uint32_t offset = (uint32_t)((chunkStart + i) * 64);
+      while (bits) {
+        positions[_size++] = offset + (uint32_t)__builtin_ctzll(bits);
+        bits &= bits - 1;
+      }
+    }
+  }
+  return state.inString == 0;
+}
+
+void JsonStructuralIndex::clear() {
+  _positions.clear();
+  _positions.shrink_to_fit();
+  _size = 0;
+}
+
+std::string JsonStructuralIndex::kernel() {
+  return availableKernels().front().name;
+}
+
+std::vector<std::string> JsonStructuralIndex::kernels() {
+  std::vector<std::string> names;
+  for (auto &kernel : availableKernels()) {
+    names.emplace_back(kernel.name);
+  }
+  return names;
+}
+
+bool JsonStructuralIndex::setKernel(const std::string &kernel) {
+  auto &kernels = availableKernels();
+  for (size_t i = 0; i < kernels.size(); i++) {
+    if (kernel == kernels[i].name) {
+      _kernel = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+}
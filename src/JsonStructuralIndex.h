@@ -0,0 +1,108 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#ifndef LIBHOMEGEAR_NODE_JSONSTRUCTURALINDEX_H
+#define LIBHOMEGEAR_NODE_JSONSTRUCTURALINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Flows {
+
+/**
+ * First stage of JsonDecoder: Finds the positions of all structural characters ({, }, [, ], : and ,), of all opening
+ * quotes and of the first character of all other values (numbers, true, false and null) outside of strings. Input is
+ * classified in blocks of 64 bytes with SIMD kernels, which are chosen at runtime like the ones of Statistics: AVX2 if
+ * the CPU supports it, SSE2 on all other x86 CPUs and a scalar implementation everywhere else. Escaped quotes and the
+ * inside of strings are then masked out with bit operations, so no character is looked at twice.
+ *
+ * The index doesn't validate the JSON beyond checking for unterminated strings. That is left to the second stage.
+ */
+class JsonStructuralIndex {
+ public:
+  JsonStructuralIndex() = default;
+  ~JsonStructuralIndex() = default;
+
+  /**
+   * Builds the index of "json" replacing the previous one. The memory of previous calls is reused.
+   *
+   * @param json The JSON to index.
+   * @param size The size of "json" in bytes.
+   * @return Returns false when the last string is not terminated or when "json" is larger than 4 GiB.
+   */
+  bool build(const char *json, size_t size);
+
+  /**
+   * @return Returns the positions in ascending order.
+   */
+  const uint32_t *positions() const { return _positions.data(); }
+
+  /**
+   * @return Returns the number of positions.
+   */
+  size_t size() const { return _size; }
+
+  /**
+   * Frees the memory of the index.
+   */
+  void clear();
+
+  /**
+   * @return Returns the name of the kernel in use by default ("avx2", "sse2" or "scalar").
+   */
+  static std::string kernel();
+
+  /**
+   * @return Returns the names of all kernels supported by the CPU, the default one first.
+   */
+  static std::vector<std::string> kernels();
+
+  /**
+   * Selects the kernel used by this index instead of the default one, e.g. to compare the kernels with each other.
+   *
+   * @param kernel One of the names returned by kernels().
+   * @return Returns false when the kernel is not supported by the CPU.
+   */
+  bool setKernel(const std::string &kernel);
+ private:
+  std::vector<uint32_t> _positions;
+  size_t _size = 0;
+
+  /**
+   * The index of the kernel in kernels().
+   */
+  size_t _kernel = 0;
+};
+
+}
+
+#endif //LIBHOMEGEAR_NODE_JSONSTRUCTURALINDEX_H
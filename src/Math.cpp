@@ -30,6 +30,12 @@
 
 #include "Math.h"
 
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
 namespace Flows {
 
 Math::Math() {
@@ -60,27 +66,79 @@ Math::Math() {
 Math::~Math() {
 }
 
-bool Math::isNumber(const std::string &s, bool hex) {
-  if (!hex) hex = ((signed)s.find('x') > -1);
-  if (!hex) try { std::stoll(s, 0, 10); } catch (...) { return false; }
-  else try { std::stoll(s, 0, 16); } catch (...) { return false; }
+namespace {
+
+/**
+ * Parses an integer like std::strtoull() does, but without allocating or throwing: Leading whitespace, an optional
+ * sign and, for hexadecimal numbers, an optional "0x" are skipped. Parsing stops at the first invalid character.
+ *
+ * @return Returns false when there are no digits or the magnitude doesn't fit into 64 bits.
+ */
+bool parseInteger(const std::string &s, int base, bool &negative, uint64_t &magnitude) {
+  const char *begin = s.data();
+  const char *end = s.data() + s.size();
+  while (begin != end && std::isspace((unsigned char)*begin)) begin++;
+  negative = false;
+  if (begin != end && (*begin == '-' || *begin == '+')) {
+    negative = *begin == '-';
+    begin++;
+  }
+  if (base == 16 && end - begin >= 2 && begin[0] == '0' && (begin[1] == 'x' || begin[1] == 'X')) {
+    //Without digits after it, "0x" is parsed as "0".
+    if (end - begin == 2 || !std::isxdigit((unsigned char)begin[2])) {
+      magnitude = 0;
+      return true;
+    }
+    begin += 2;
+  }
+  magnitude = 0;
+  auto result = std::from_chars(begin, end, magnitude, base);
+  return result.ec == std::errc();
+}
+
+/**
+ * Parses a signed 64-bit integer with the range checks of std::stoll().
+ */
+bool parseInteger64(const std::string &s, int base, int64_t &number) {
+  bool negative = false;
+  uint64_t magnitude = 0;
+  if (!parseInteger(s, base, negative, magnitude)) return false;
+  if (negative) {
+    if (magnitude > (uint64_t)std::numeric_limits<int64_t>::max() + 1) return false;
+    number = (int64_t)(0 - magnitude);
+  } else {
+    if (magnitude > (uint64_t)std::numeric_limits<int64_t>::max()) return false;
+    number = (int64_t)magnitude;
+  }
   return true;
 }
 
+/**
+ * Parses an unsigned 64-bit integer like std::stoull(). Like there, negative numbers wrap around.
+ */
+uint64_t parseUnsignedInteger64(const std::string &s, bool isHex) {
+  bool negative = false;
+  uint64_t magnitude = 0;
+  if (!parseInteger(s, isHex ? 16 : 10, negative, magnitude)) return 0;
+  return negative ? 0 - magnitude : magnitude;
+}
+
+}
+
+bool Math::isNumber(const std::string &s, bool hex) {
+  if (!hex) hex = s.find('x') != std::string::npos;
+  int64_t number = 0;
+  return parseInteger64(s, hex ? 16 : 10, number);
+}
+
 int32_t Math::getNumber(const std::string &s, bool isHex) {
-  int32_t xpos = s.find('x');
-  int32_t number = 0;
-  //Don't change to std::stol, because otherwise numbers larger than 0x7FFFFFFF can't be parsed.
-  if (xpos == -1 && !isHex) try { number = std::stoll(s, 0, 10); } catch (...) {}
-  else try { number = std::stoll(s, 0, 16); } catch (...) {}
-  return number;
+  //Parsed as 64-bit integer, because otherwise numbers larger than 0x7FFFFFFF can't be parsed.
+  return (int32_t)getNumber64(s, isHex);
 }
 
 int64_t Math::getNumber64(const std::string &s, bool isHex) {
-  int32_t xpos = s.find('x');
   int64_t number = 0;
-  if (xpos == -1 && !isHex) try { number = std::stoll(s, 0, 10); } catch (...) {}
-  else try { number = std::stoll(s, 0, 16); } catch (...) {}
+  if (!parseInteger64(s, isHex || s.find('x') != std::string::npos ? 16 : 10, number)) return 0;
   return number;
 }
 
@@ -90,34 +148,55 @@ int32_t Math::getNumber(char hexChar) {
 }
 
 uint32_t Math::getUnsignedNumber(const std::string &s, bool isHex) {
-  int32_t xpos = s.find('x');
-  uint32_t number = 0;
-  if (xpos == -1 && !isHex) try { number = std::stoul(s, 0, 10); } catch (...) {}
-  else try { number = std::stoul(s, 0, 16); } catch (...) {}
-  return number;
+  return (uint32_t)parseUnsignedInteger64(s, isHex || s.find('x') != std::string::npos);
 }
 
 uint64_t Math::getUnsignedNumber64(const std::string &s, bool isHex) {
-  int32_t xpos = s.find('x');
-  uint32_t number = 0;
-  if (xpos == -1 && !isHex) try { number = std::stoull(s, 0, 10); } catch (...) {}
-  else try { number = std::stoull(s, 0, 16); } catch (...) {}
-  return number;
+  return parseUnsignedInteger64(s, isHex || s.find('x') != std::string::npos);
 }
 
 int32_t Math::getOctalNumber(std::string &s) {
-  int32_t number = 0;
-  try { number = std::stoll(s, 0, 8); } catch (...) {}
-  return number;
+  int64_t number = 0;
+  if (!parseInteger64(s, 8, number)) return 0;
+  return (int32_t)number;
+}
+
+const char *Math::parseDouble(const char *begin, const char *end, double &value) {
+  auto result = std::from_chars(begin, end, value);
+  if (result.ec == std::errc::result_out_of_range) {
+    //Rare, so the copy doesn't matter. std::strtod() returns the correctly signed infinity or 0.
+    std::string number(begin, result.ptr);
+    value = std::strtod(number.c_str(), nullptr);
+  } else if (result.ec != std::errc()) return begin;
+  return result.ptr;
 }
 
 double Math::getDouble(const std::string &s) {
-  double number = 0;
-  try { number = std::stod(s); } catch (...) {}
-  return number;
+  const char *begin = s.data();
+  const char *end = s.data() + s.size();
+  while (begin != end && std::isspace((unsigned char)*begin)) begin++;
+  if (begin != end && *begin == '+') {
+    begin++;
+    if (begin != end && *begin == '-') return 0;
+  }
+  const char *number = begin;
+  if (begin != end && *number == '-') number++;
+  if (end - number >= 2 && number[0] == '0' && (number[1] == 'x' || number[1] == 'X')) {
+    //Hexadecimal floating point numbers are not supported by std::from_chars() without a format.
+    std::string hex(begin, end);
+    return std::strtod(hex.c_str(), nullptr);
+  }
+  double value = 0;
+  if (parseDouble(begin, end, value) == begin) return 0;
+  //std::stod() threw on overflow, so this keeps returning 0 for it.
+  if (std::isinf(value) && (end - number < 3 || (std::tolower((unsigned char)number[0]) != 'i'))) return 0;
+  return value;
 }
 
 uint32_t Math::getIeee754Binary32(float value) {
+  if (std::isnan(value)) return 0x7FC00000;
+  if (std::isinf(value)) return value < 0 ? 0xFF800000 : 0x7F800000;
+
   int32_t sign = 0;
   int32_t integer;
   int32_t exponent = 127;
@@ -156,6 +235,9 @@ uint32_t Math::getIeee754Binary32(float value) {
 }
 
 uint64_t Math::getIeee754Binary64(double value) {
+  if (std::isnan(value)) return 0x7FF8000000000000ull;
+  if (std::isinf(value)) return value < 0 ? 0xFFF0000000000000ull : 0x7FF0000000000000ull;
+
   int64_t sign = 0;
   int64_t integer;
   int64_t exponent = 1023;
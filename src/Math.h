@@ -187,6 +187,17 @@ class Math {
    */
   static double getDouble(const std::string &s);
 
+  /**
+   * Parses a decimal floating point number like std::from_chars(), so without allocating, throwing or depending on the
+   * locale. The result is correctly rounded. Unlike std::from_chars(), numbers out of range result in infinity or 0.
+   *
+   * @param begin The start of the number. A leading "-" is allowed, leading whitespace and "+" are not.
+   * @param end The end of the input.
+   * @param[out] value The parsed number.
+   * @return Returns a pointer to the first character after the number or "begin" when there is no number.
+   */
+  static const char *parseDouble(const char *begin, const char *end, double &value);
+
   /**
    * Converts a double to string removing any trailing zeros.
    *
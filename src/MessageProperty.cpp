@@ -29,7 +29,8 @@
 */
 
 #include "MessageProperty.h"
-#include "Math.h"
+
+#include <charconv>
 
 namespace Flows {
 
@@ -37,106 +38,290 @@ MessageProperty::MessageProperty(const std::string &property) {
   std::string currentString;
   currentString.reserve(property.size());
   bool inBrackets = false;
+  auto addSegment = [&](bool isIndex) {
+    Segment segment;
+    segment.isIndex = isIndex;
+    if (isIndex) {
+      //Only plain decimal numbers are valid indexes. Anything else, e.g. "-1", must not wrap around to a huge index.
+      auto end = currentString.data() + currentString.size();
+      auto result = std::from_chars(currentString.data(), end, segment.index);
+      if (currentString.empty() || result.ec != std::errc() || result.ptr != end) _valid = false;
+    } else {
+      segment.key = currentString;
+      segment.keyHash = Struct::hashKey(segment.key);
+    }
+    _segments.emplace_back(std::move(segment));
+    currentString.clear();
+  };
   for (auto c : property) {
     if (c == '[') {
-      if (!currentString.empty()) {
-        _property.emplace_back(std::make_pair(currentString, false));
-        currentString.clear();
-      }
+      if (!currentString.empty()) addSegment(false);
       inBrackets = true;
     } else if (c == ']') {
       inBrackets = false;
-      _property.emplace_back(std::make_pair(currentString, true));
-      currentString.clear();
+      addSegment(true);
     } else if (inBrackets) {
       currentString.push_back(c);
     } else if (c == '.') {
-      if (!currentString.empty()) _property.emplace_back(std::make_pair(currentString, false));
+      if (!currentString.empty()) addSegment(false);
       currentString.clear();
     } else currentString.push_back(c);
   }
-  if (!currentString.empty()) _property.emplace_back(std::make_pair(currentString, false));
+  if (!currentString.empty()) addSegment(false);
 }
 
 bool MessageProperty::empty() {
-  return _property.empty();
+  return _segments.empty();
 }
 
 Flows::PVariable MessageProperty::match(Flows::PVariable &message) {
-  Flows::PVariable currentMessage = message;
-  for (auto &element : _property) {
-    if (element.second) {
-      auto arrayIndex = (uint64_t)Math::getNumber64(element.first);
-      if (arrayIndex >= currentMessage->arrayValue->size()) return Flows::PVariable();
-      currentMessage = currentMessage->arrayValue->at(arrayIndex);
+  if (!_valid) return Flows::PVariable();
+  const Flows::Variable *currentMessage = message.get();
+  for (auto &segment : _segments) {
+    //Read through a const reference, so no containers are allocated for elements of the wrong type.
+    const Flows::Variable &current = *currentMessage;
+    const Flows::PVariable *element;
+    if (segment.isIndex) {
+      if (segment.index >= current.arrayValue->size()) return Flows::PVariable();
+      element = &(*current.arrayValue)[segment.index];
     } else {
-      auto messageIterator = currentMessage->structValue->find(element.first);
-      if (messageIterator == currentMessage->structValue->end()) return Flows::PVariable();
-      currentMessage = messageIterator->second;
+      const Struct &structValue = *current.structValue;
+      auto messageIterator = structValue.find(segment.key, segment.keyHash);
+      if (messageIterator == structValue.end()) return Flows::PVariable();
+      element = &messageIterator->second;
     }
+    if (&segment == &_segments.back()) return *element;
+    if (!*element) return Flows::PVariable();
+    currentMessage = element->get();
   }
 
-  return currentMessage;
+  return message;
 }
 
 bool MessageProperty::erase(Flows::PVariable &message) {
+  if (!_valid) return false;
+  //Frozen Variables and elements of containers shared copy-on-write can be shared with other trees, so detach every
+  //level of the path before modifying it.
+  Flows::Variable::detach(message);
   Flows::PVariable currentMessage = message;
-  for (int32_t i = 0; (unsigned)i < _property.size(); i++) {
-    if (_property.at(i).second) {
-      auto arrayIndex = Math::getUnsignedNumber64(_property.at(i).first);
-      if (arrayIndex >= currentMessage->arrayValue->size()) return false;
-      if ((unsigned)i < _property.size() - 1) currentMessage = currentMessage->arrayValue->at(arrayIndex);
-      else currentMessage->arrayValue->erase(currentMessage->arrayValue->begin() + arrayIndex);
+  for (size_t i = 0; i < _segments.size(); i++) {
+    auto &segment = _segments[i];
+    bool last = i == _segments.size() - 1;
+    //Non-const access on every level, so containers shared copy-on-write are copied along the path.
+    if (segment.isIndex) {
+      if (segment.index >= currentMessage->arrayValue->size()) return false;
+      if (!last) {
+        auto &element = currentMessage->arrayValue->at(segment.index);
+        Flows::Variable::detach(element, currentMessage->arrayValue.sharesElements());
+        currentMessage = element;
+      } else currentMessage->arrayValue->erase(currentMessage->arrayValue->begin() + segment.index);
     } else {
-      auto messageIterator = currentMessage->structValue->find(_property.at(i).first);
+      auto messageIterator = currentMessage->structValue->find(segment.key, segment.keyHash);
       if (messageIterator == currentMessage->structValue->end()) return false;
-      if ((unsigned)i < _property.size() - 1) currentMessage = messageIterator->second;
-      else currentMessage->structValue->erase(messageIterator);
+      if (!last) {
+        Flows::Variable::detach(messageIterator->second, currentMessage->structValue.sharesElements());
+        currentMessage = messageIterator->second;
+      } else currentMessage->structValue->erase(messageIterator);
     }
   }
   return true;
 }
 
 bool MessageProperty::set(Flows::PVariable &message, Flows::PVariable &value) {
+  if (!_valid) return false;
+  //Frozen Variables and elements of containers shared copy-on-write can be shared with other trees, so detach every
+  //level of the path before modifying it.
+  Flows::Variable::detach(message);
   Flows::PVariable currentMessage = message;
-  for (int32_t i = 0; (unsigned)i < _property.size(); i++) {
-    if (_property.at(i).second) {
-      auto arrayIndex = Math::getUnsignedNumber64(_property.at(i).first);
+  for (size_t i = 0; i < _segments.size(); i++) {
+    auto &segment = _segments[i];
+    bool last = i == _segments.size() - 1;
+    if (segment.isIndex) {
+      auto arrayIndex = segment.index;
       if (arrayIndex >= currentMessage->arrayValue->size()) {
-        if ((unsigned)i < _property.size() - 1) {
+        if (!last) {
           Flows::PVariable subElement;
           currentMessage->arrayValue->reserve(arrayIndex + 1);
           while (arrayIndex >= currentMessage->arrayValue->size()) {
-            subElement = std::make_shared<Flows::Variable>(_property.at(i + 1).second ? Flows::VariableType::tArray : Flows::VariableType::tStruct);
+            subElement = Pool::create<Flows::Variable>(_segments[i + 1].isIndex ? Flows::VariableType::tArray : Flows::VariableType::tStruct);
             currentMessage->arrayValue->emplace_back(subElement);
           }
           currentMessage = subElement;
         } else {
           currentMessage->arrayValue->reserve(arrayIndex + 1);
-          while (arrayIndex >= currentMessage->arrayValue->size()) {
-            currentMessage->arrayValue->emplace_back(std::make_shared<Flows::Variable>());
+          while (arrayIndex > currentMessage->arrayValue->size()) {
+            currentMessage->arrayValue->emplace_back(Pool::create<Flows::Variable>());
           }
           currentMessage->arrayValue->emplace_back(value);
         }
       } else {
-        if ((unsigned)i < _property.size() - 1) currentMessage = currentMessage->arrayValue->at(arrayIndex);
-        else currentMessage->arrayValue->at(arrayIndex) = value;
+        if (!last) {
+          auto &element = currentMessage->arrayValue->at(arrayIndex);
+          Flows::Variable::detach(element, currentMessage->arrayValue.sharesElements());
+          currentMessage = element;
+        } else currentMessage->arrayValue->at(arrayIndex) = value;
       }
     } else {
-      auto messageIterator = currentMessage->structValue->find(_property.at(i).first);
+      auto messageIterator = currentMessage->structValue->find(segment.key, segment.keyHash);
       if (messageIterator == currentMessage->structValue->end()) {
-        if ((unsigned)i < _property.size() - 1) {
-          auto subElement = std::make_shared<Flows::Variable>(_property.at(i + 1).second ? Flows::VariableType::tArray : Flows::VariableType::tStruct);
-          currentMessage->structValue->emplace(_property.at(i).first, subElement);
+        if (!last) {
+          auto subElement = Pool::create<Flows::Variable>(_segments[i + 1].isIndex ? Flows::VariableType::tArray : Flows::VariableType::tStruct);
+          currentMessage->structValue->emplace(segment.key, subElement);
           currentMessage = subElement;
-        } else currentMessage->structValue->emplace(_property.at(i).first, value);
+        } else currentMessage->structValue->emplace(segment.key, value);
       } else {
-        if ((unsigned)i < _property.size() - 1) currentMessage = messageIterator->second;
-        else messageIterator->second = value;
+        if (!last) {
+          Flows::Variable::detach(messageIterator->second, currentMessage->structValue.sharesElements());
+          currentMessage = messageIterator->second;
+        } else messageIterator->second = value;
+      }
+    }
+  }
+  return true;
+}
+
+Flows::PVariable MessageProperty::copyPathElement(const Flows::Variable &source, const Segment &nextSegment) {
+  auto copy = Flows::Variable::createCopyOnWrite(source);
+  //Non-const access copies the element pointers of the shared container and marks its elements as shared.
+  if (nextSegment.isIndex) copy->arrayValue.get();
+  else copy->structValue.get();
+  return copy;
+}
+
+Flows::PVariable MessageProperty::setCow(const Flows::PVariable &message, const Flows::PVariable &value) const {
+  if (_segments.empty() || !_valid || !message) return message;
+  auto root = copyPathElement(*message, _segments.front());
+  Flows::Variable *currentMessage = root.get();
+  for (size_t i = 0; i < _segments.size(); i++) {
+    auto &segment = _segments[i];
+    bool last = i == _segments.size() - 1;
+    //The containers along the path were copied by copyPathElement(), so non-const access doesn't copy them again.
+    Flows::PVariable *element;
+    if (segment.isIndex) {
+      auto &array = *currentMessage->arrayValue;
+      if (segment.index >= array.size()) {
+        auto elementType = last ? Flows::VariableType::tVoid : (_segments[i + 1].isIndex ? Flows::VariableType::tArray : Flows::VariableType::tStruct);
+        array.reserve(segment.index + 1);
+        while (segment.index >= array.size()) {
+          array.emplace_back(Pool::create<Flows::Variable>(elementType));
+        }
+      }
+      element = &array[segment.index];
+    } else {
+      auto &structValue = *currentMessage->structValue;
+      auto messageIterator = structValue.find(segment.key, segment.keyHash);
+      if (messageIterator == structValue.end()) messageIterator = structValue.emplace(segment.key, Flows::PVariable()).first;
+      element = &messageIterator->second;
+    }
+    if (last) {
+      *element = value;
+      break;
+    }
+    auto &nextSegment = _segments[i + 1];
+    if (*element) *element = copyPathElement(**element, nextSegment);
+    else *element = Pool::create<Flows::Variable>(nextSegment.isIndex ? Flows::VariableType::tArray : Flows::VariableType::tStruct);
+    currentMessage = element->get();
+  }
+  return root;
+}
+
+size_t MessagePropertySet::add(const std::string &property) {
+  MessageProperty messageProperty(property);
+  if (!messageProperty.valid()) return _propertyCount++;
+  size_t nodeIndex = 0;
+  for (auto &segment : messageProperty.segments()) {
+    size_t childIndex = 0;
+    for (auto index : _nodes[nodeIndex].children) {
+      auto &child = _nodes[index].segment;
+      if (child.isIndex == segment.isIndex && (segment.isIndex ? child.index == segment.index : child.key == segment.key)) {
+        childIndex = index;
+        break;
       }
     }
+    if (childIndex == 0) {
+      childIndex = _nodes.size();
+      _nodes.emplace_back();
+      _nodes.back().segment = segment;
+      _nodes[nodeIndex].children.push_back(childIndex);
+    }
+    nodeIndex = childIndex;
+  }
+  _nodes[nodeIndex].properties.push_back(_propertyCount);
+  return _propertyCount++;
+}
+
+void MessagePropertySet::match(const Flows::PVariable &message, std::vector<Flows::PVariable> &results) const {
+  results.clear();
+  results.resize(_propertyCount);
+  if (!message) return;
+  for (auto property : _nodes.front().properties) {
+    results[property] = message;
+  }
+  match(*message, _nodes.front(), results);
+}
+
+void MessagePropertySet::match(const Flows::Variable &variable, const Node &node, std::vector<Flows::PVariable> &results) const {
+  for (auto childIndex : node.children) {
+    auto &child = _nodes[childIndex];
+    auto &segment = child.segment;
+    const Flows::PVariable *element;
+    //Read through const references, so no containers are allocated for elements of the wrong type.
+    if (segment.isIndex) {
+      const Array &array = *variable.arrayValue;
+      if (segment.index >= array.size()) continue;
+      element = &array[segment.index];
+    } else {
+      const Struct &structValue = *variable.structValue;
+      auto messageIterator = structValue.find(segment.key, segment.keyHash);
+      if (messageIterator == structValue.end()) continue;
+      element = &messageIterator->second;
+    }
+    for (auto property : child.properties) {
+      results[property] = *element;
+    }
+    if (*element && !child.children.empty()) match(**element, child, results);
   }
+}
+
+bool MessagePropertySet::set(Flows::PVariable &message, const std::vector<Flows::PVariable> &values) {
+  if (values.size() != _propertyCount) return false;
+  //Frozen Variables and elements of containers shared copy-on-write can be shared with other trees, so detach every
+  //level of the paths before modifying them.
+  Flows::Variable::detach(message);
+  set(*message, _nodes.front(), values);
   return true;
 }
 
-}
\ No newline at end of file
+void MessagePropertySet::set(Flows::Variable &variable, const Node &node, const std::vector<Flows::PVariable> &values) {
+  for (auto childIndex : node.children) {
+    auto &child = _nodes[childIndex];
+    auto &segment = child.segment;
+    //Missing elements on the way to nested properties are created as arrays or structs depending on the next segment.
+    auto elementType = child.children.empty() ? Flows::VariableType::tVoid : (_nodes[child.children.front()].segment.isIndex ? Flows::VariableType::tArray : Flows::VariableType::tStruct);
+    Flows::PVariable *element;
+    if (segment.isIndex) {
+      auto &array = *variable.arrayValue;
+      if (segment.index >= array.size()) {
+        array.reserve(segment.index + 1);
+        while (segment.index >= array.size()) {
+          array.emplace_back(Pool::create<Flows::Variable>(elementType));
+        }
+      }
+      element = &array[segment.index];
+    } else {
+      auto &structValue = *variable.structValue;
+      auto messageIterator = structValue.find(segment.key, segment.keyHash);
+      if (messageIterator == structValue.end()) messageIterator = structValue.emplace(segment.key, Pool::create<Flows::Variable>(elementType)).first;
+      element = &messageIterator->second;
+    }
+    for (auto property : child.properties) {
+      *element = values[property];
+    }
+    if (child.children.empty()) continue;
+    if (!*element) *element = Pool::create<Flows::Variable>(elementType);
+    Flows::Variable::detach(*element, segment.isIndex ? variable.arrayValue.sharesElements() : variable.structValue.sharesElements());
+    set(**element, child, values);
+  }
+}
+
+}
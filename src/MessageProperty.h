@@ -39,16 +39,121 @@ namespace Flows {
  * Class to parse and work with Strings from frontend message property inputs.
  */
 class MessageProperty {
- private:
-  std::vector<std::pair<std::string, bool>> _property;
  public:
+  /**
+   * One element of the property path, parsed once on construction.
+   */
+  struct Segment {
+    /**
+     * The struct key. Empty for array indexes.
+     */
+    std::string key;
+
+    /**
+     * Struct::hashKey() of the key, so lookups in large structs don't hash the key again.
+     */
+    uint32_t keyHash = 0;
+
+    /**
+     * The parsed array index.
+     */
+    uint64_t index = 0;
+    bool isIndex = false;
+  };
+
   MessageProperty() = default;
   explicit MessageProperty(const std::string &property);
 
   bool empty();
+
+  /**
+   * @return Returns false when an array index of the property is negative, not a decimal number or out of range (e.g.
+   * "payload[-1]" or "payload[a]"). Invalid properties match nothing, set() and erase() return false and setCow() returns
+   * the message unchanged.
+   */
+  bool valid() const { return _valid; }
+  const std::vector<Segment> &segments() const { return _segments; }
   Flows::PVariable match(Flows::PVariable &message);
   bool erase(Flows::PVariable &message);
   bool set(Flows::PVariable &message, Flows::PVariable &value);
+
+  /**
+   * Like set(), but leaves "message" unchanged and returns a new root instead. Only the Variables and containers along
+   * the path are copied, all other elements are shared with "message" like with Variable::createCopyOnWrite(). This
+   * makes it cheap to add a field to a large message. set() and erase() detach shared elements before modifying them,
+   * elements modified in place in any other way must be detached first (see Variable::detach()).
+   *
+   * @param message The message to copy. Not modified.
+   * @param value The value to set.
+   * @return Returns the new root or "message" itself when the property is empty or invalid.
+   */
+  Flows::PVariable setCow(const Flows::PVariable &message, const Flows::PVariable &value) const;
+ private:
+  std::vector<Segment> _segments;
+  bool _valid = true;
+
+  /**
+   * Copies "source" for setCow(). The array or struct the next segment is looked up in is copied, but its elements are
+   * shared with "source".
+   */
+  static Flows::PVariable copyPathElement(const Flows::Variable &source, const Segment &nextSegment);
+};
+
+/**
+ * A set of message properties stored as a trie, so properties with a common prefix (e.g. "payload.a" and "payload.b")
+ * share the lookups of the prefix. match() and set() handle all properties in one traversal of the message.
+ */
+class MessagePropertySet {
+ public:
+  MessagePropertySet() = default;
+
+  /**
+   * Adds a property. Invalid properties (see MessageProperty::valid()) get an index, but are never matched or set.
+   *
+   * @param property The property as entered in the frontend, e.g. "payload.values[2]".
+   * @return Returns the index of the property in the vectors passed to match() and set().
+   */
+  size_t add(const std::string &property);
+
+  size_t size() const { return _propertyCount; }
+
+  /**
+   * Looks up all properties.
+   *
+   * @param message The message to search.
+   * @param[out] results Resized to size(). Element i is set to the value of property i or to nullptr when the
+   * property doesn't exist. Reuse the vector between calls to avoid allocations.
+   */
+  void match(const Flows::PVariable &message, std::vector<Flows::PVariable> &results) const;
+
+  /**
+   * Sets all properties like MessageProperty::set() does. Properties ending at the same element are set in the order
+   * they were added, properties are set before properties nested in them.
+   *
+   * @param message The message to modify.
+   * @param values The values to set. Must have size() elements.
+   * @return Returns false when the number of values doesn't match.
+   */
+  bool set(Flows::PVariable &message, const std::vector<Flows::PVariable> &values);
+ private:
+  struct Node {
+    MessageProperty::Segment segment;
+    std::vector<size_t> children;
+
+    /**
+     * The indexes of the properties ending at this node.
+     */
+    std::vector<size_t> properties;
+  };
+
+  /**
+   * The nodes of the trie. The first node is the root and has no segment.
+   */
+  std::vector<Node> _nodes = std::vector<Node>(1);
+  size_t _propertyCount = 0;
+
+  void match(const Flows::Variable &variable, const Node &node, std::vector<Flows::PVariable> &results) const;
+  void set(Flows::Variable &variable, const Node &node, const std::vector<Flows::PVariable> &values);
 };
 
 }
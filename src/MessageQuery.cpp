@@ -0,0 +1,324 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "MessageQuery.h"
+#include "Math.h"
+
+#include <algorithm>
+#include <charconv>
+
+namespace Flows {
+
+MessageQuery::MessageQuery(const std::string &query) {
+  size_t position = 0;
+  if (!query.empty() && query.front() == '$') position++;
+  while (position < query.size()) {
+    bool recursive = false;
+    if (query[position] == '.') {
+      position++;
+      if (position < query.size() && query[position] == '.') {
+        recursive = true;
+        position++;
+      }
+      if (position >= query.size()) throw MessageQueryException("Unexpected end of query after \".\".");
+    } else if (query[position] != '[' && !_steps.empty()) {
+      throw MessageQueryException("Unexpected character \"" + std::string(1, query[position]) + "\" at position " + std::to_string(position) + ".");
+    }
+    Step step = query[position] == '[' ? parseBracket(query, position) : parseKey(query, position);
+    step.recursive = recursive;
+    _steps.emplace_back(std::move(step));
+  }
+}
+
+MessageQuery::Step MessageQuery::parseKey(const std::string &query, size_t &position) {
+  auto end = query.find_first_of(".[]", position);
+  if (end == std::string::npos) end = query.size();
+  if (end == position) throw MessageQueryException("Empty key at position " + std::to_string(position) + ".");
+  Step step;
+  std::string key = query.substr(position, end - position);
+  position = end;
+  if (key == "*") step.type = StepType::wildcard;
+  else step.key = std::move(key);
+  return step;
+}
+
+MessageQuery::Step MessageQuery::parseBracket(const std::string &query, size_t &position) {
+  Step step;
+  position++;
+  skipWhitespace(query, position);
+  if (position >= query.size()) throw MessageQueryException("Unexpected end of query after \"[\".");
+  auto c = query[position];
+  if (c == '*') {
+    step.type = StepType::wildcard;
+    position++;
+  } else if (c == '\'' || c == '"') {
+    step.key = parseQuotedString(query, position);
+  } else if (c == '?') {
+    step.type = StepType::filter;
+    parseFilter(query, position, step);
+  } else if (c >= '0' && c <= '9') {
+    step.type = StepType::index;
+    auto parseResult = std::from_chars(query.data() + position, query.data() + query.size(), step.index);
+    if (parseResult.ec != std::errc()) throw MessageQueryException("Index out of range at position " + std::to_string(position) + ".");
+    position = (size_t)(parseResult.ptr - query.data());
+  } else throw MessageQueryException("Unexpected character \"" + std::string(1, c) + "\" at position " + std::to_string(position) + ".");
+  skipWhitespace(query, position);
+  if (position >= query.size() || query[position] != ']') throw MessageQueryException("Expected \"]\" at position " + std::to_string(position) + ".");
+  position++;
+  return step;
+}
+
+void MessageQuery::parseFilter(const std::string &query, size_t &position, Step &step) {
+  if (query.compare(position, 2, "?(") != 0) throw MessageQueryException("Expected \"?(\" at position " + std::to_string(position) + ".");
+  position += 2;
+  skipWhitespace(query, position);
+  if (position >= query.size() || query[position] != '@') throw MessageQueryException("Expected \"@\" at position " + std::to_string(position) + ".");
+  position++;
+
+  //The path relative to the element. Only keys and indexes are allowed here.
+  while (position < query.size() && (query[position] == '.' || query[position] == '[')) {
+    if (query[position] == '[') {
+      auto pathStep = parseBracket(query, position);
+      if (pathStep.type != StepType::key && pathStep.type != StepType::index) throw MessageQueryException("Only keys and indexes are allowed in filter paths.");
+      step.filterPath.emplace_back(std::move(pathStep));
+      continue;
+    }
+    position++;
+    auto end = query.find_first_of(".[ \t)=!<>", position);
+    if (end == std::string::npos || end == position) throw MessageQueryException("Invalid filter path at position " + std::to_string(position) + ".");
+    Step pathStep;
+    pathStep.key = query.substr(position, end - position);
+    step.filterPath.emplace_back(std::move(pathStep));
+    position = end;
+  }
+
+  skipWhitespace(query, position);
+  if (position >= query.size()) throw MessageQueryException("Unexpected end of filter.");
+  if (query[position] != ')') {
+    if (query.compare(position, 2, "==") == 0) step.filterOperator = Operator::equal;
+    else if (query.compare(position, 2, "!=") == 0) step.filterOperator = Operator::notEqual;
+    else if (query.compare(position, 2, "<=") == 0) step.filterOperator = Operator::lessOrEqual;
+    else if (query.compare(position, 2, ">=") == 0) step.filterOperator = Operator::greaterOrEqual;
+    else if (query[position] == '<') step.filterOperator = Operator::less;
+    else if (query[position] == '>') step.filterOperator = Operator::greater;
+    else throw MessageQueryException("Unknown operator at position " + std::to_string(position) + ".");
+    position += (step.filterOperator == Operator::less || step.filterOperator == Operator::greater) ? 1 : 2;
+    skipWhitespace(query, position);
+    step.filterValue = parseLiteral(query, position);
+    skipWhitespace(query, position);
+  }
+  if (position >= query.size() || query[position] != ')') throw MessageQueryException("Expected \")\" at position " + std::to_string(position) + ".");
+  position++;
+}
+
+std::string MessageQuery::parseQuotedString(const std::string &query, size_t &position) {
+  auto quote = query[position];
+  position++;
+  std::string result;
+  while (position < query.size() && query[position] != quote) {
+    if (query[position] == '\\' && position + 1 < query.size()) position++;
+    result.push_back(query[position]);
+    position++;
+  }
+  if (position >= query.size()) throw MessageQueryException("Unterminated string.");
+  position++;
+  return result;
+}
+
+PVariable MessageQuery::parseLiteral(const std::string &query, size_t &position) {
+  if (position >= query.size()) throw MessageQueryException("Expected a value after the operator.");
+  auto c = query[position];
+  if (c == '\'' || c == '"') {
+    auto value = Pool::create<Variable>(VariableType::tString);
+    value->stringValue = parseQuotedString(query, position);
+    return value;
+  }
+  if (query.compare(position, 4, "true") == 0) {
+    position += 4;
+    return Pool::create<Variable>(true);
+  } else if (query.compare(position, 5, "false") == 0) {
+    position += 5;
+    return Pool::create<Variable>(false);
+  } else if (query.compare(position, 4, "null") == 0) {
+    position += 4;
+    return Pool::create<Variable>();
+  }
+  auto end = query.find_first_not_of("+-0123456789.eE", position);
+  if (end == std::string::npos) end = query.size();
+  if (end == position) throw MessageQueryException("Invalid value at position " + std::to_string(position) + ".");
+  auto begin = query.data() + position;
+  if (*begin == '+') begin++;
+  auto numberEnd = query.data() + end;
+  if (std::find_if(begin, numberEnd, [](char c) { return c == '.' || c == 'e' || c == 'E'; }) != numberEnd) {
+    double value = 0;
+    if (Math::parseDouble(begin, numberEnd, value) != numberEnd) throw MessageQueryException("Invalid number at position " + std::to_string(position) + ".");
+    position = end;
+    return Pool::create<Variable>(value);
+  }
+  int64_t value = 0;
+  auto parseResult = std::from_chars(begin, numberEnd, value);
+  if (parseResult.ec == std::errc::result_out_of_range) throw MessageQueryException("Number out of range at position " + std::to_string(position) + ".");
+  if (parseResult.ec != std::errc() || parseResult.ptr != numberEnd) throw MessageQueryException("Invalid number at position " + std::to_string(position) + ".");
+  position = end;
+  return Pool::create<Variable>(value);
+}
+
+void MessageQuery::skipWhitespace(const std::string &query, size_t &position) {
+  while (position < query.size() && (query[position] == ' ' || query[position] == '\t')) position++;
+}
+
+void MessageQuery::match(const PVariable &message, std::vector<PVariable> &results) const {
+  results.clear();
+  if (!message) return;
+  results.push_back(message);
+  std::vector<PVariable> next;
+  for (auto &step : _steps) {
+    next.clear();
+    for (auto &variable : results) {
+      apply(step, variable, next);
+    }
+    results.swap(next);
+    if (results.empty()) return;
+  }
+}
+
+PVariable MessageQuery::matchFirst(const PVariable &message) const {
+  std::vector<PVariable> results;
+  match(message, results);
+  return results.empty() ? PVariable() : results.front();
+}
+
+void MessageQuery::apply(const Step &step, const PVariable &variable, std::vector<PVariable> &results) const {
+  if (!step.recursive) {
+    applyToChildren(step, variable, results);
+    return;
+  }
+
+  //Recursive descent: Apply the step to the Variable and all its descendants in document order. Uses an explicit
+  //stack, so deeply nested messages can't overflow the call stack.
+  std::vector<const PVariable *> stack{&variable};
+  while (!stack.empty()) {
+    const PVariable &current = *stack.back();
+    stack.pop_back();
+    applyToChildren(step, current, results);
+    if (current->type == VariableType::tArray) {
+      const Array &array = current->arrayValue.view();
+      for (auto i = array.rbegin(); i != array.rend(); ++i) {
+        if (*i) stack.push_back(&*i);
+      }
+    } else if (current->type == VariableType::tStruct) {
+      const Struct &structValue = current->structValue.view();
+      for (auto i = structValue.rbegin(); i != structValue.rend(); ++i) {
+        if (i->second) stack.push_back(&i->second);
+      }
+    }
+  }
+}
+
+void MessageQuery::applyToChildren(const Step &step, const PVariable &variable, std::vector<PVariable> &results) const {
+  //Read through const references, so no containers are allocated for elements of the wrong type.
+  const Variable &current = *variable;
+  if (step.type == StepType::key) {
+    if (current.type != VariableType::tStruct) return;
+    const Struct &structValue = *current.structValue;
+    auto iterator = structValue.find(step.key);
+    if (iterator != structValue.end() && iterator->second) results.push_back(iterator->second);
+  } else if (step.type == StepType::index) {
+    if (current.type != VariableType::tArray) return;
+    const Array &array = *current.arrayValue;
+    if (step.index < array.size() && array[step.index]) results.push_back(array[step.index]);
+  } else if (current.type == VariableType::tArray) {
+    for (auto &element : *current.arrayValue) {
+      if (element && (step.type == StepType::wildcard || filterMatches(step, element))) results.push_back(element);
+    }
+  } else if (current.type == VariableType::tStruct) {
+    for (auto &element : *current.structValue) {
+      if (element.second && (step.type == StepType::wildcard || filterMatches(step, element.second))) results.push_back(element.second);
+    }
+  }
+}
+
+bool MessageQuery::filterMatches(const Step &step, const PVariable &element) {
+  const Variable *current = element.get();
+  for (auto &pathStep : step.filterPath) {
+    const PVariable *next = nullptr;
+    if (pathStep.type == StepType::key) {
+      if (current->type != VariableType::tStruct) return false;
+      const Struct &structValue = *current->structValue;
+      auto iterator = structValue.find(pathStep.key);
+      if (iterator != structValue.end()) next = &iterator->second;
+    } else {
+      if (current->type != VariableType::tArray) return false;
+      const Array &array = *current->arrayValue;
+      if (pathStep.index < array.size()) next = &array[pathStep.index];
+    }
+    if (!next || !*next) return false;
+    current = next->get();
+  }
+  if (step.filterOperator == Operator::exists) return true;
+
+  bool comparable = false;
+  auto result = compare(*current, *step.filterValue, comparable);
+  switch (step.filterOperator) {
+    case Operator::equal: return comparable && result == 0;
+    case Operator::notEqual: return !comparable || result != 0;
+    case Operator::less: return comparable && result < 0;
+    case Operator::lessOrEqual: return comparable && result <= 0;
+    case Operator::greater: return comparable && result > 0;
+    case Operator::greaterOrEqual: return comparable && result >= 0;
+    default: return false;
+  }
+}
+
+int32_t MessageQuery::compare(const Variable &value, const Variable &filterValue, bool &comparable) {
+  auto isNumber = [](const Variable &variable) {
+    return variable.type == VariableType::tInteger || variable.type == VariableType::tInteger64 || variable.type == VariableType::tFloat;
+  };
+  comparable = true;
+  if (isNumber(value) && isNumber(filterValue)) {
+    if (value.type != VariableType::tFloat && filterValue.type != VariableType::tFloat) {
+      int64_t left = value.type == VariableType::tInteger ? value.integerValue : value.integerValue64;
+      int64_t right = filterValue.type == VariableType::tInteger ? filterValue.integerValue : filterValue.integerValue64;
+      return left < right ? -1 : (left > right ? 1 : 0);
+    }
+    double left = value.type == VariableType::tFloat ? value.floatValue : (value.type == VariableType::tInteger ? value.integerValue : value.integerValue64);
+    double right = filterValue.type == VariableType::tFloat ? filterValue.floatValue : (filterValue.type == VariableType::tInteger ? filterValue.integerValue : filterValue.integerValue64);
+    return left < right ? -1 : (left > right ? 1 : 0);
+  } else if (value.type == VariableType::tString && filterValue.type == VariableType::tString) {
+    auto result = value.stringValue.compare(filterValue.stringValue);
+    return result < 0 ? -1 : (result > 0 ? 1 : 0);
+  } else if (value.type == VariableType::tBoolean && filterValue.type == VariableType::tBoolean) {
+    return (int32_t)value.booleanValue - (int32_t)filterValue.booleanValue;
+  } else if (value.type == VariableType::tVoid && filterValue.type == VariableType::tVoid) return 0;
+  comparable = false;
+  return 0;
+}
+
+}
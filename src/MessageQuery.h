@@ -0,0 +1,132 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#ifndef LIBHOMEGEAR_NODE_MESSAGEQUERY_H
+#define LIBHOMEGEAR_NODE_MESSAGEQUERY_H
+
+#include "FlowException.h"
+#include "Variable.h"
+
+namespace Flows {
+
+class MessageQueryException : public FlowException {
+ public:
+  explicit MessageQueryException(const std::string &message) : FlowException(message) {}
+};
+
+/**
+ * Query over a message supporting a subset of JSONPath. The query is compiled once on construction, match() only
+ * walks the message. Supported are:
+ *
+ * - Keys and indexes like in MessageProperty: "payload.sensors[2].temp", also quoted: "payload['a key']".
+ * - Wildcards for all elements of an array or struct: "payload.sensors[*].temp" or "payload.*".
+ * - Recursive descent, matching at any depth: "payload..temp" or "..[*]".
+ * - Filters on the elements of an array or struct: "payload.sensors[?(@.temp > 20)].name". Supported operators are
+ *   ==, !=, <, <=, > and >= comparing with a number, a string in single or double quotes, true, false or null. Without
+ *   an operator, the filter checks that the element exists: "[?(@.temp)]".
+ *
+ * A leading "$" or "$." is optional.
+ */
+class MessageQuery {
+ public:
+  /**
+   * @param query The query to compile.
+   * @throws MessageQueryException when the query is invalid.
+   */
+  explicit MessageQuery(const std::string &query);
+
+  /**
+   * Finds all elements matching the query.
+   *
+   * @param message The message to search.
+   * @param[out] results The matching elements in document order. They are the elements of the message itself, not
+   * copies, so don't modify them unless you own the message. Reuse the vector between calls to avoid allocations.
+   */
+  void match(const PVariable &message, std::vector<PVariable> &results) const;
+
+  /**
+   * @return Returns the first element matching the query or nullptr.
+   */
+  PVariable matchFirst(const PVariable &message) const;
+ private:
+  enum class StepType {
+    key,
+    index,
+    wildcard,
+    filter
+  };
+
+  enum class Operator {
+    exists,
+    equal,
+    notEqual,
+    less,
+    lessOrEqual,
+    greater,
+    greaterOrEqual
+  };
+
+  struct Step {
+    StepType type = StepType::key;
+
+    /**
+     * Matches the step against the element itself and all its descendants.
+     */
+    bool recursive = false;
+    std::string key;
+    uint64_t index = 0;
+
+    /**
+     * For filters: The path relative to the element (only keys and indexes), the operator and the value to compare
+     * with.
+     */
+    std::vector<Step> filterPath;
+    Operator filterOperator = Operator::exists;
+    PVariable filterValue;
+  };
+
+  std::vector<Step> _steps;
+
+  static Step parseKey(const std::string &query, size_t &position);
+  static Step parseBracket(const std::string &query, size_t &position);
+  static void parseFilter(const std::string &query, size_t &position, Step &step);
+  static std::string parseQuotedString(const std::string &query, size_t &position);
+  static PVariable parseLiteral(const std::string &query, size_t &position);
+  static void skipWhitespace(const std::string &query, size_t &position);
+
+  void apply(const Step &step, const PVariable &variable, std::vector<PVariable> &results) const;
+  void applyToChildren(const Step &step, const PVariable &variable, std::vector<PVariable> &results) const;
+  static bool filterMatches(const Step &step, const PVariable &element);
+  static int32_t compare(const Variable &value, const Variable &filterValue, bool &comparable);
+};
+
+}
+
+#endif //LIBHOMEGEAR_NODE_MESSAGEQUERY_H
@@ -33,31 +33,31 @@
 namespace Flows {
 
 PVariable NodeInfo::serialize() {
-  PVariable info = std::make_shared<Variable>(VariableType::tStruct);
-  info->structValue->emplace("id", std::make_shared<Variable>(id));
-  info->structValue->emplace("flowId", std::make_shared<Variable>(flowId));
-  info->structValue->emplace("type", std::make_shared<Variable>(type));
+  PVariable info = Pool::create<Variable>(VariableType::tStruct);
+  info->structValue->emplace("id", Pool::create<Variable>(id));
+  info->structValue->emplace("flowId", Pool::create<Variable>(flowId));
+  info->structValue->emplace("type", Pool::create<Variable>(type));
   info->structValue->emplace("info", this->info);
 
-  PVariable array = std::make_shared<Variable>(VariableType::tArray);
+  PVariable array = Pool::create<Variable>(VariableType::tArray);
   array->arrayValue->reserve(wiresIn.size());
   for (auto &input : wiresIn) {
-    PVariable innerArray = std::make_shared<Variable>(VariableType::tStruct);
+    PVariable innerArray = Pool::create<Variable>(VariableType::tStruct);
     for (auto &wire : input) {
-      innerArray->structValue->emplace("id", std::make_shared<Variable>(wire.id));
-      innerArray->structValue->emplace("port", std::make_shared<Variable>(wire.port));
+      innerArray->structValue->emplace("id", Pool::create<Variable>(wire.id));
+      innerArray->structValue->emplace("port", Pool::create<Variable>(wire.port));
     }
     array->arrayValue->push_back(innerArray);
   }
   info->structValue->emplace("wiresIn", array);
 
-  array = std::make_shared<Variable>(VariableType::tArray);
+  array = Pool::create<Variable>(VariableType::tArray);
   array->arrayValue->reserve(wiresOut.size());
   for (auto &output : wiresOut) {
-    PVariable innerArray = std::make_shared<Variable>(VariableType::tStruct);
+    PVariable innerArray = Pool::create<Variable>(VariableType::tStruct);
     for (auto &wire : output) {
-      innerArray->structValue->emplace("id", std::make_shared<Variable>(wire.id));
-      innerArray->structValue->emplace("port", std::make_shared<Variable>(wire.port));
+      innerArray->structValue->emplace("id", Pool::create<Variable>(wire.id));
+      innerArray->structValue->emplace("port", Pool::create<Variable>(wire.port));
     }
     array->arrayValue->push_back(innerArray);
   }
@@ -0,0 +1,208 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "Pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace Flows {
+
+namespace {
+
+constexpr size_t granularity = 16;
+constexpr size_t sizeClasses = Pool::maxBlockSize / granularity;
+
+struct FreeBlock {
+  FreeBlock *next;
+};
+
+std::atomic<uint32_t> maxCachedBlocksPerClass{1024};
+
+struct ThreadCache;
+
+/**
+ * The hit and miss counters are kept per thread, so allocations don't contend on a shared cache line. Reading them
+ * adds up the counters of all threads.
+ */
+struct Statistics {
+  std::mutex mutex;
+  std::vector<ThreadCache *> threadCaches;
+
+  /**
+   * The counts of threads that have exited already.
+   */
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+};
+
+//Never freed, so it is still valid when threads exit during or after the destruction of static objects.
+Statistics &statistics() {
+  static auto instance = new Statistics();
+  return *instance;
+}
+
+struct ThreadCache {
+  FreeBlock *freeLists[sizeClasses] = {};
+  uint32_t sizes[sizeClasses] = {};
+
+  //Only written by the owning thread, so increments don't need atomic read-modify-write operations. Atomic, so other
+  //threads can read them while adding up the statistics.
+  std::atomic<uint64_t> hits{0};
+  std::atomic<uint64_t> misses{0};
+
+  ThreadCache() {
+    auto &instance = statistics();
+    std::lock_guard<std::mutex> statisticsGuard(instance.mutex);
+    instance.threadCaches.push_back(this);
+  }
+
+  void trim() {
+    for (size_t i = 0; i < sizeClasses; i++) {
+      while (freeLists[i]) {
+        FreeBlock *block = freeLists[i];
+        freeLists[i] = block->next;
+        ::operator delete(block);
+      }
+      sizes[i] = 0;
+    }
+  }
+
+  ~ThreadCache();
+};
+
+//Trivially destructible, so it stays valid after threadCache is destroyed. Objects freed by destructors of other
+//thread-local or static objects running after that go to the heap directly.
+thread_local bool threadCacheDestroyed = false;
+thread_local ThreadCache threadCache;
+
+ThreadCache::~ThreadCache() {
+  trim();
+  threadCacheDestroyed = true;
+  auto &instance = statistics();
+  std::lock_guard<std::mutex> statisticsGuard(instance.mutex);
+  instance.hits += hits.load(std::memory_order_relaxed);
+  instance.misses += misses.load(std::memory_order_relaxed);
+  instance.threadCaches.erase(std::find(instance.threadCaches.begin(), instance.threadCaches.end(), this));
+}
+
+inline void increment(std::atomic<uint64_t> &counter) {
+  counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+inline size_t sizeClass(size_t size) {
+  return (size - 1) / granularity;
+}
+
+}
+
+void *Pool::allocate(size_t size) {
+  if (size == 0 || size > maxBlockSize) return ::operator new(size);
+  auto index = sizeClass(size);
+  if (enabled() && !threadCacheDestroyed) {
+    auto &cache = threadCache;
+    FreeBlock *block = cache.freeLists[index];
+    if (block) {
+      cache.freeLists[index] = block->next;
+      cache.sizes[index]--;
+      increment(cache.hits);
+      return block;
+    }
+    increment(cache.misses);
+  }
+  //Always allocate the full size class, so the block can be reused for any size of the class. This includes blocks
+  //allocated while pooling is disabled or on threads that have exited, as they might be freed into a cache later.
+  return ::operator new((index + 1) * granularity);
+}
+
+void Pool::deallocate(void *block, size_t size) noexcept {
+  if (!block) return;
+  if (size == 0 || size > maxBlockSize || threadCacheDestroyed || !enabled()) {
+    ::operator delete(block);
+    return;
+  }
+  auto index = sizeClass(size);
+  auto &cache = threadCache;
+  if (cache.sizes[index] >= maxCachedBlocksPerClass.load(std::memory_order_relaxed)) {
+    ::operator delete(block);
+    return;
+  }
+  auto freeBlock = static_cast<FreeBlock *>(block);
+  freeBlock->next = cache.freeLists[index];
+  cache.freeLists[index] = freeBlock;
+  cache.sizes[index]++;
+}
+
+uint64_t Pool::hits() {
+  auto &instance = statistics();
+  std::lock_guard<std::mutex> statisticsGuard(instance.mutex);
+  uint64_t result = instance.hits;
+  for (auto cache : instance.threadCaches) {
+    result += cache->hits.load(std::memory_order_relaxed);
+  }
+  return result;
+}
+
+uint64_t Pool::misses() {
+  auto &instance = statistics();
+  std::lock_guard<std::mutex> statisticsGuard(instance.mutex);
+  uint64_t result = instance.misses;
+  for (auto cache : instance.threadCaches) {
+    result += cache->misses.load(std::memory_order_relaxed);
+  }
+  return result;
+}
+
+uint32_t Pool::maxCachedBlocks() {
+  return maxCachedBlocksPerClass.load(std::memory_order_relaxed);
+}
+
+void Pool::setMaxCachedBlocks(uint32_t value) {
+  maxCachedBlocksPerClass.store(value, std::memory_order_relaxed);
+}
+
+size_t Pool::cachedBlocks() {
+  if (threadCacheDestroyed) return 0;
+  size_t count = 0;
+  for (auto size : threadCache.sizes) {
+    count += size;
+  }
+  return count;
+}
+
+void Pool::trim() {
+  if (threadCacheDestroyed) return;
+  threadCache.trim();
+}
+
+}
@@ -0,0 +1,164 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#ifndef LIBHOMEGEAR_NODE_POOL_H
+#define LIBHOMEGEAR_NODE_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace Flows {
+
+/**
+ * Thread-caching free-list pool for small fixed-size objects like Variables and the control blocks of PVariable, PArray
+ * and PStruct. Freed blocks are kept in a free list of the freeing thread per size class (16 byte steps up to 256 bytes)
+ * and handed out again on the next allocation of the same size on that thread without taking a lock. Each list holds at
+ * most maxCachedBlocks() blocks, everything above that is returned to the heap. Blocks can be freed on any thread.
+ *
+ * Blocks are allocated one at a time instead of carving them from larger slabs, so a block migrating to another thread
+ * through a shared pointer can still be released on its own when that thread's cache is full or the thread exits.
+ *
+ * Pooling is opt-in: Until setEnabled(true) is called, create() is std::make_shared() and allocate() and deallocate()
+ * go to the heap directly, so nothing is cached.
+ */
+class Pool {
+ public:
+  Pool() = delete;
+
+  static constexpr size_t maxBlockSize = 256;
+
+  static void *allocate(size_t size);
+  static void deallocate(void *block, size_t size) noexcept;
+
+  /**
+   * @return Returns true when pooling is enabled. Disabled by default.
+   */
+  static bool enabled() { return _enabled.load(std::memory_order_relaxed); }
+
+  /**
+   * Enables or disables pooling for all threads. Enable it at startup when profiling shows that allocations of
+   * Variables matter. Disabling it doesn't release blocks cached already, each thread releases its blocks on exit or
+   * when it calls trim().
+   */
+  static void setEnabled(bool value) { _enabled.store(value, std::memory_order_relaxed); }
+
+  /**
+   * Every thread counts its own allocations. This adds up the counters of all threads under a lock, so don't call it on
+   * hot paths.
+   *
+   * @return Returns the number of allocations served from a free list since program start.
+   */
+  static uint64_t hits();
+
+  /**
+   * @return Returns the number of allocations that had to go to the heap since program start.
+   */
+  static uint64_t misses();
+
+  /**
+   * @return Returns the maximum number of blocks cached per thread and size class. The default is 1024.
+   */
+  static uint32_t maxCachedBlocks();
+
+  /**
+   * Sets the maximum number of blocks cached per thread and size class. Use hits() and misses() to find a good value.
+   * Caches already holding more blocks shrink as blocks are allocated again.
+   */
+  static void setMaxCachedBlocks(uint32_t value);
+
+  /**
+   * @return Returns the number of blocks currently cached by the calling thread.
+   */
+  static size_t cachedBlocks();
+
+  /**
+   * Returns all blocks cached by the calling thread to the heap.
+   */
+  static void trim();
+
+  /**
+   * @return Returns the number of bytes create<T>() allocates for the object and its control block. The control block
+   * is estimated as a vtable pointer and two reference counters.
+   */
+  template<typename T>
+  static constexpr size_t sharedSize() {
+    constexpr size_t size = sizeof(T) + sizeof(void *) + 2 * sizeof(int32_t);
+    return size <= maxBlockSize ? (size + 15) & ~(size_t)15 : size;
+  }
+
+  /**
+   * Like std::make_shared(), but object and control block are allocated from the pool when pooling is enabled.
+   */
+  template<typename T, typename... Args>
+  static std::shared_ptr<T> create(Args &&... args);
+ private:
+  static inline std::atomic_bool _enabled{false};
+};
+
+/**
+ * Stateless standard allocator allocating single objects from Pool. Arrays and objects larger than
+ * Pool::maxBlockSize are allocated from the heap.
+ */
+template<typename T>
+class PoolAllocator {
+ public:
+  typedef T value_type;
+
+  PoolAllocator() = default;
+  template<typename U>
+  PoolAllocator(const PoolAllocator<U> &) noexcept {}
+
+  T *allocate(size_t n) {
+    if (n == 1 && sizeof(T) <= Pool::maxBlockSize && alignof(T) <= alignof(std::max_align_t)) return static_cast<T *>(Pool::allocate(sizeof(T)));
+    return static_cast<T *>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T *p, size_t n) noexcept {
+    if (n == 1 && sizeof(T) <= Pool::maxBlockSize && alignof(T) <= alignof(std::max_align_t)) Pool::deallocate(p, sizeof(T));
+    else ::operator delete(p);
+  }
+
+  template<typename U>
+  bool operator==(const PoolAllocator<U> &) const { return true; }
+  template<typename U>
+  bool operator!=(const PoolAllocator<U> &) const { return false; }
+};
+
+template<typename T, typename... Args>
+std::shared_ptr<T> Pool::create(Args &&... args) {
+  if (!enabled()) return std::make_shared<T>(std::forward<Args>(args)...);
+  return std::allocate_shared<T>(PoolAllocator<T>(), std::forward<Args>(args)...);
+}
+
+}
+
+#endif //LIBHOMEGEAR_NODE_POOL_H
@@ -33,6 +33,13 @@
 
 namespace Flows {
 
+namespace {
+
+//Shared by all structs decoded on a thread, so its buffer is only allocated once.
+thread_local StructBuilder structBuilder;
+
+}
+
 RpcDecoder::RpcDecoder() {
   _decoder = std::unique_ptr<BinaryDecoder>(new BinaryDecoder());
 }
@@ -72,6 +79,10 @@ std::shared_ptr<RpcHeader> RpcDecoder::decodeHeader(std::vector<uint8_t> &packet
 }
 
 std::shared_ptr<std::vector<std::shared_ptr<Variable>>> RpcDecoder::decodeRequest(std::vector<char> &packet, std::string &methodName) {
+  return decodeRequest(packet, methodName, PArena());
+}
+
+std::shared_ptr<std::vector<std::shared_ptr<Variable>>> RpcDecoder::decodeRequest(std::vector<char> &packet, std::string &methodName, const PArena &arena) {
   uint32_t position = 4;
   uint32_t headerSize = 0;
   if (packet.at(3) == 0x40 || packet.at(3) == 0x41) headerSize = _decoder->decodeInteger(packet, position) + 4;
@@ -81,12 +92,16 @@ std::shared_ptr<std::vector<std::shared_ptr<Variable>>> RpcDecoder::decodeReques
   std::shared_ptr<std::vector<std::shared_ptr<Variable>>> parameters = std::make_shared<std::vector<std::shared_ptr<Variable>>>();
   if (parameterCount > 100) return parameters;
   for (uint32_t i = 0; i < parameterCount; i++) {
-    parameters->push_back(decodeParameter(packet, position));
+    parameters->push_back(decodeParameter(packet, position, arena));
   }
   return parameters;
 }
 
 std::shared_ptr<std::vector<std::shared_ptr<Variable>>> RpcDecoder::decodeRequest(std::vector<uint8_t> &packet, std::string &methodName) {
+  return decodeRequest(packet, methodName, PArena());
+}
+
+std::shared_ptr<std::vector<std::shared_ptr<Variable>>> RpcDecoder::decodeRequest(std::vector<uint8_t> &packet, std::string &methodName, const PArena &arena) {
   uint32_t position = 4;
   uint32_t headerSize = 0;
   if (packet.at(3) == 0x40 || packet.at(3) == 0x41) headerSize = _decoder->decodeInteger(packet, position) + 4;
@@ -96,31 +111,39 @@ std::shared_ptr<std::vector<std::shared_ptr<Variable>>> RpcDecoder::decodeReques
   std::shared_ptr<std::vector<std::shared_ptr<Variable>>> parameters = std::make_shared<std::vector<std::shared_ptr<Variable>>>();
   if (parameterCount > 100) return parameters;
   for (uint32_t i = 0; i < parameterCount; i++) {
-    parameters->push_back(decodeParameter(packet, position));
+    parameters->push_back(decodeParameter(packet, position, arena));
   }
   return parameters;
 }
 
 std::shared_ptr<Variable> RpcDecoder::decodeResponse(std::vector<char> &packet, uint32_t offset) {
+  return decodeResponse(packet, PArena(), offset);
+}
+
+std::shared_ptr<Variable> RpcDecoder::decodeResponse(std::vector<char> &packet, const PArena &arena, uint32_t offset) {
   uint32_t position = offset + 8;
-  std::shared_ptr<Variable> response = decodeParameter(packet, position);
+  std::shared_ptr<Variable> response = decodeParameter(packet, position, arena);
   if (packet.size() < 4) return response; //response is Void when packet is empty.
   if (packet.at(3) == 0xFF) {
     response->errorStruct = true;
-    if (response->structValue->find("faultCode") == response->structValue->end()) response->structValue->insert(StructElement("faultCode", std::make_shared<Variable>(-1)));
-    if (response->structValue->find("faultString") == response->structValue->end()) response->structValue->insert(StructElement("faultString", std::make_shared<Variable>(std::string("undefined"))));
+    if (response->structValue->find("faultCode") == response->structValue->end()) response->structValue->insert(StructElement("faultCode", Pool::create<Variable>(-1)));
+    if (response->structValue->find("faultString") == response->structValue->end()) response->structValue->insert(StructElement("faultString", Pool::create<Variable>(std::string("undefined"))));
   }
   return response;
 }
 
 std::shared_ptr<Variable> RpcDecoder::decodeResponse(std::vector<uint8_t> &packet, uint32_t offset) {
+  return decodeResponse(packet, PArena(), offset);
+}
+
+std::shared_ptr<Variable> RpcDecoder::decodeResponse(std::vector<uint8_t> &packet, const PArena &arena, uint32_t offset) {
   uint32_t position = offset + 8;
-  std::shared_ptr<Variable> response = decodeParameter(packet, position);
+  std::shared_ptr<Variable> response = decodeParameter(packet, position, arena);
   if (packet.size() < 4) return response; //response is Void when packet is empty.
   if (packet.at(3) == 0xFF) {
     response->errorStruct = true;
-    if (response->structValue->find("faultCode") == response->structValue->end()) response->structValue->insert(StructElement("faultCode", std::make_shared<Variable>(-1)));
-    if (response->structValue->find("faultString") == response->structValue->end()) response->structValue->insert(StructElement("faultString", std::make_shared<Variable>(std::string("undefined"))));
+    if (response->structValue->find("faultCode") == response->structValue->end()) response->structValue->insert(StructElement("faultCode", Pool::create<Variable>(-1)));
+    if (response->structValue->find("faultString") == response->structValue->end()) response->structValue->insert(StructElement("faultString", Pool::create<Variable>(std::string("undefined"))));
   }
   return response;
 }
@@ -131,11 +154,16 @@ void RpcDecoder::decodeResponse(PVariable &variable, uint32_t offset) {
   if (variable->binaryValue.size() < 4) return; //response is Void when packet is empty.
   if (variable->binaryValue.at(3) == 0xFF) {
     variable->errorStruct = true;
-    if (variable->structValue->find("faultCode") == variable->structValue->end()) variable->structValue->insert(StructElement("faultCode", std::make_shared<Variable>(-1)));
-    if (variable->structValue->find("faultString") == variable->structValue->end()) variable->structValue->insert(StructElement("faultString", std::make_shared<Variable>(std::string("undefined"))));
+    if (variable->structValue->find("faultCode") == variable->structValue->end()) variable->structValue->insert(StructElement("faultCode", Pool::create<Variable>(-1)));
+    if (variable->structValue->find("faultString") == variable->structValue->end()) variable->structValue->insert(StructElement("faultString", Pool::create<Variable>(std::string("undefined"))));
   }
 }
 
+PVariable RpcDecoder::createVariable(VariableType type, const PArena &arena) {
+  if (arena) return std::allocate_shared<Variable>(ArenaAllocator<Variable>(arena), type);
+  return Pool::create<Variable>(type);
+}
+
 VariableType RpcDecoder::decodeType(std::vector<char> &packet, uint32_t &position) {
   return (VariableType)_decoder->decodeInteger(packet, position);
 }
@@ -144,16 +172,14 @@ VariableType RpcDecoder::decodeType(std::vector<uint8_t> &packet, uint32_t &posi
   return (VariableType)_decoder->decodeInteger(packet, position);
 }
 
-std::shared_ptr<Variable> RpcDecoder::decodeParameter(std::vector<char> &packet, uint32_t &position) {
+std::shared_ptr<Variable> RpcDecoder::decodeParameter(std::vector<char> &packet, uint32_t &position, const PArena &arena, uint32_t depth) {
   VariableType type = decodeType(packet, position);
-  std::shared_ptr<Variable> variable = std::make_shared<Variable>(type);
+  std::shared_ptr<Variable> variable = createVariable(type, arena);
   if (type == VariableType::tVoid) {
     //Nothing
   } else if (type == VariableType::tString || type == VariableType::tBase64) {
     variable->stringValue = _decoder->decodeString(packet, position);
-    variable->integerValue64 = Math::getNumber64(variable->stringValue);
-    variable->integerValue = (int32_t)variable->integerValue64;
-    variable->booleanValue = !variable->stringValue.empty() && variable->stringValue != "0" && variable->stringValue != "false" && variable->stringValue != "f";
+    variable->setValuesFromString();
 
   } else if (type == VariableType::tInteger) {
     variable->integerValue = _decoder->decodeInteger(packet, position);
@@ -177,9 +203,9 @@ std::shared_ptr<Variable> RpcDecoder::decodeParameter(std::vector<char> &packet,
   } else if (type == VariableType::tBinary) {
     variable->binaryValue = _decoder->decodeBinary(packet, position);
   } else if (type == VariableType::tArray) {
-    variable->arrayValue = decodeArray(packet, position);
+    variable->arrayValue = decodeArray(packet, position, arena, depth);
   } else if (type == VariableType::tStruct) {
-    variable->structValue = decodeStruct(packet, position);
+    variable->structValue = decodeStruct(packet, position, arena, depth);
     if (variable->structValue->size() == 2 && variable->structValue->find("faultCode") != variable->structValue->end() && variable->structValue->find("faultString") != variable->structValue->end()) {
       variable->errorStruct = true;
     }
@@ -187,16 +213,14 @@ std::shared_ptr<Variable> RpcDecoder::decodeParameter(std::vector<char> &packet,
   return variable;
 }
 
-std::shared_ptr<Variable> RpcDecoder::decodeParameter(std::vector<uint8_t> &packet, uint32_t &position) {
+std::shared_ptr<Variable> RpcDecoder::decodeParameter(std::vector<uint8_t> &packet, uint32_t &position, const PArena &arena, uint32_t depth) {
   VariableType type = decodeType(packet, position);
-  std::shared_ptr<Variable> variable = std::make_shared<Variable>(type);
+  std::shared_ptr<Variable> variable = createVariable(type, arena);
   if (type == VariableType::tVoid) {
     //Nothing
   } else if (type == VariableType::tString || type == VariableType::tBase64) {
     variable->stringValue = _decoder->decodeString(packet, position);
-    variable->integerValue64 = Math::getNumber64(variable->stringValue);
-    variable->integerValue = (int32_t)variable->integerValue64;
-    variable->booleanValue = !variable->stringValue.empty() && variable->stringValue != "0" && variable->stringValue != "false" && variable->stringValue != "f";
+    variable->setValuesFromString();
 
   } else if (type == VariableType::tInteger) {
     variable->integerValue = _decoder->decodeInteger(packet, position);
@@ -220,9 +244,9 @@ std::shared_ptr<Variable> RpcDecoder::decodeParameter(std::vector<uint8_t> &pack
   } else if (type == VariableType::tBinary) {
     variable->binaryValue = _decoder->decodeBinary(packet, position);
   } else if (type == VariableType::tArray) {
-    variable->arrayValue = decodeArray(packet, position);
+    variable->arrayValue = decodeArray(packet, position, arena, depth);
   } else if (type == VariableType::tStruct) {
-    variable->structValue = decodeStruct(packet, position);
+    variable->structValue = decodeStruct(packet, position, arena, depth);
     if (variable->structValue->size() == 2 && variable->structValue->find("faultCode") != variable->structValue->end() && variable->structValue->find("faultString") != variable->structValue->end()) {
       variable->errorStruct = true;
     }
@@ -236,9 +260,7 @@ void RpcDecoder::decodeParameter(PVariable &variable, uint32_t &position) {
     //Nothing
   } else if (variable->type == VariableType::tString || variable->type == VariableType::tBase64) {
     variable->stringValue = _decoder->decodeString(variable->binaryValue, position);
-    variable->integerValue64 = Math::getNumber64(variable->stringValue);
-    variable->integerValue = (int32_t)variable->integerValue64;
-    variable->booleanValue = !variable->stringValue.empty() && variable->stringValue != "0" && variable->stringValue != "false" && variable->stringValue != "f";
+    variable->setValuesFromString();
 
   } else if (variable->type == VariableType::tInteger) {
     variable->integerValue = _decoder->decodeInteger(variable->binaryValue, position);
@@ -262,49 +284,67 @@ void RpcDecoder::decodeParameter(PVariable &variable, uint32_t &position) {
   } else if (variable->type == VariableType::tBinary) {
     variable->binaryValue = _decoder->decodeBinary(variable->binaryValue, position);
   } else if (variable->type == VariableType::tArray) {
-    variable->arrayValue = decodeArray(variable->binaryValue, position);
+    variable->arrayValue = decodeArray(variable->binaryValue, position, PArena(), 0);
   } else if (variable->type == VariableType::tStruct) {
-    variable->structValue = decodeStruct(variable->binaryValue, position);
+    variable->structValue = decodeStruct(variable->binaryValue, position, PArena(), 0);
     if (variable->structValue->size() == 2 && variable->structValue->find("faultCode") != variable->structValue->end() && variable->structValue->find("faultString") != variable->structValue->end()) {
       variable->errorStruct = true;
     }
   }
 }
 
-PArray RpcDecoder::decodeArray(std::vector<char> &packet, uint32_t &position) {
+PArray RpcDecoder::decodeArray(std::vector<char> &packet, uint32_t &position, const PArena &arena, uint32_t depth) {
+  if (depth == maxDepth) throw RpcDecoderException("Maximum nesting depth exceeded.");
   uint32_t arrayLength = _decoder->decodeInteger(packet, position);
-  PArray array = std::make_shared<Array>();
+  PArray array = arena ? std::allocate_shared<Array>(ArenaAllocator<Array>(arena)) : Pool::create<Array>();
   for (uint32_t i = 0; i < arrayLength; i++) {
-    array->push_back(decodeParameter(packet, position));
+    array->push_back(decodeParameter(packet, position, arena, depth + 1));
   }
   return array;
 }
 
-PArray RpcDecoder::decodeArray(std::vector<uint8_t> &packet, uint32_t &position) {
+PArray RpcDecoder::decodeArray(std::vector<uint8_t> &packet, uint32_t &position, const PArena &arena, uint32_t depth) {
+  if (depth == maxDepth) throw RpcDecoderException("Maximum nesting depth exceeded.");
   uint32_t arrayLength = _decoder->decodeInteger(packet, position);
-  PArray array = std::make_shared<Array>();
+  PArray array = arena ? std::allocate_shared<Array>(ArenaAllocator<Array>(arena)) : Pool::create<Array>();
   for (uint32_t i = 0; i < arrayLength; i++) {
-    array->push_back(decodeParameter(packet, position));
+    array->push_back(decodeParameter(packet, position, arena, depth + 1));
   }
   return array;
 }
 
-PStruct RpcDecoder::decodeStruct(std::vector<char> &packet, uint32_t &position) {
+PStruct RpcDecoder::decodeStruct(std::vector<char> &packet, uint32_t &position, const PArena &arena, uint32_t depth) {
+  if (depth == maxDepth) throw RpcDecoderException("Maximum nesting depth exceeded.");
   uint32_t structLength = _decoder->decodeInteger(packet, position);
-  PStruct rpcStruct = std::make_shared<Struct>();
-  for (uint32_t i = 0; i < structLength; i++) {
-    std::string name = _decoder->decodeString(packet, position);
-    rpcStruct->insert(StructElement(name, decodeParameter(packet, position)));
+  PStruct rpcStruct = arena ? std::allocate_shared<Struct>(ArenaAllocator<Struct>(arena)) : Pool::create<Struct>();
+  auto mark = structBuilder.begin();
+  try {
+    for (uint32_t i = 0; i < structLength; i++) {
+      std::string name = _decoder->decodeString(packet, position);
+      structBuilder.add(*rpcStruct, mark, std::move(name), decodeParameter(packet, position, arena, depth + 1));
+    }
+    structBuilder.end(*rpcStruct, mark);
+  } catch (...) {
+    structBuilder.discard(mark);
+    throw;
   }
   return rpcStruct;
 }
 
-PStruct RpcDecoder::decodeStruct(std::vector<uint8_t> &packet, uint32_t &position) {
+PStruct RpcDecoder::decodeStruct(std::vector<uint8_t> &packet, uint32_t &position, const PArena &arena, uint32_t depth) {
+  if (depth == maxDepth) throw RpcDecoderException("Maximum nesting depth exceeded.");
   uint32_t structLength = _decoder->decodeInteger(packet, position);
-  PStruct rpcStruct = std::make_shared<Struct>();
-  for (uint32_t i = 0; i < structLength; i++) {
-    std::string name = _decoder->decodeString(packet, position);
-    rpcStruct->insert(StructElement(name, decodeParameter(packet, position)));
+  PStruct rpcStruct = arena ? std::allocate_shared<Struct>(ArenaAllocator<Struct>(arena)) : Pool::create<Struct>();
+  auto mark = structBuilder.begin();
+  try {
+    for (uint32_t i = 0; i < structLength; i++) {
+      std::string name = _decoder->decodeString(packet, position);
+      structBuilder.add(*rpcStruct, mark, std::move(name), decodeParameter(packet, position, arena, depth + 1));
+    }
+    structBuilder.end(*rpcStruct, mark);
+  } catch (...) {
+    structBuilder.discard(mark);
+    throw;
   }
   return rpcStruct;
 }
@@ -32,6 +32,7 @@
 #define FLOWSRPCDECODER_H_
 
 #include "Variable.h"
+#include "Arena.h"
 #include "BinaryDecoder.h"
 #include "RpcHeader.h"
 #include "HelperFunctions.h"
@@ -41,8 +42,20 @@
 #include <cmath>
 
 namespace Flows {
+
+class RpcDecoderException : public FlowException {
+ public:
+  explicit RpcDecoderException(const std::string &message) : FlowException(message) {}
+};
+
 class RpcDecoder {
  public:
+  /**
+   * The maximum nesting depth of arrays and structs. Deeper packets throw RpcDecoderException, so decoding can't
+   * overflow the stack.
+   */
+  static constexpr uint32_t maxDepth = 1000;
+
   RpcDecoder();
   virtual ~RpcDecoder() {}
 
@@ -53,18 +66,33 @@ class RpcDecoder {
   virtual std::shared_ptr<Variable> decodeResponse(std::vector<char> &packet, uint32_t offset = 0);
   virtual std::shared_ptr<Variable> decodeResponse(std::vector<uint8_t> &packet, uint32_t offset = 0);
   virtual void decodeResponse(PVariable &variable, uint32_t offset = 0);
+
+  /**
+   * Decodes a request placing all Variables of the parameters in "arena". The arena is released when the last of them
+   * is gone (see Arena). Don't use the same arena from multiple threads at the same time.
+   */
+  virtual std::shared_ptr<std::vector<std::shared_ptr<Variable>>> decodeRequest(std::vector<char> &packet, std::string &methodName, const PArena &arena);
+  virtual std::shared_ptr<std::vector<std::shared_ptr<Variable>>> decodeRequest(std::vector<uint8_t> &packet, std::string &methodName, const PArena &arena);
+
+  /**
+   * Decodes a response placing all Variables of the result in "arena". The arena is released when the last of them is
+   * gone (see Arena). Don't use the same arena from multiple threads at the same time.
+   */
+  virtual std::shared_ptr<Variable> decodeResponse(std::vector<char> &packet, const PArena &arena, uint32_t offset = 0);
+  virtual std::shared_ptr<Variable> decodeResponse(std::vector<uint8_t> &packet, const PArena &arena, uint32_t offset = 0);
  private:
   std::unique_ptr<Flows::BinaryDecoder> _decoder;
 
-  std::shared_ptr<Variable> decodeParameter(std::vector<char> &packet, uint32_t &position);
-  std::shared_ptr<Variable> decodeParameter(std::vector<uint8_t> &packet, uint32_t &position);
+  static PVariable createVariable(VariableType type, const PArena &arena);
+  std::shared_ptr<Variable> decodeParameter(std::vector<char> &packet, uint32_t &position, const PArena &arena, uint32_t depth = 0);
+  std::shared_ptr<Variable> decodeParameter(std::vector<uint8_t> &packet, uint32_t &position, const PArena &arena, uint32_t depth = 0);
   void decodeParameter(PVariable &variable, uint32_t &position);
   VariableType decodeType(std::vector<char> &packet, uint32_t &position);
   VariableType decodeType(std::vector<uint8_t> &packet, uint32_t &position);
-  std::shared_ptr<Array> decodeArray(std::vector<char> &packet, uint32_t &position);
-  std::shared_ptr<Array> decodeArray(std::vector<uint8_t> &packet, uint32_t &position);
-  std::shared_ptr<Struct> decodeStruct(std::vector<char> &packet, uint32_t &position);
-  std::shared_ptr<Struct> decodeStruct(std::vector<uint8_t> &packet, uint32_t &position);
+  std::shared_ptr<Array> decodeArray(std::vector<char> &packet, uint32_t &position, const PArena &arena, uint32_t depth);
+  std::shared_ptr<Array> decodeArray(std::vector<uint8_t> &packet, uint32_t &position, const PArena &arena, uint32_t depth);
+  std::shared_ptr<Struct> decodeStruct(std::vector<char> &packet, uint32_t &position, const PArena &arena, uint32_t depth);
+  std::shared_ptr<Struct> decodeStruct(std::vector<uint8_t> &packet, uint32_t &position, const PArena &arena, uint32_t depth);
 };
 }
 #endif
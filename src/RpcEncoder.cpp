@@ -29,6 +29,7 @@
 */
 
 #include "RpcEncoder.h"
+#include "VariableIterator.h"
 
 namespace Flows {
 
@@ -255,95 +256,147 @@ uint32_t RpcEncoder::encodeHeader(std::vector<uint8_t> &packet, const RpcHeader
 
 void RpcEncoder::encodeVariable(std::vector<char> &packet, std::shared_ptr<Variable> &variable) {
   if (!variable) variable.reset(new Variable(VariableType::tVoid));
-  if (variable->type == VariableType::tVoid) {
+  if (variable->type != VariableType::tStruct && variable->type != VariableType::tArray) {
+    encodeValue(packet, *variable);
+    return;
+  }
+
+  VariableIterator iterator(*variable, 0);
+  while (iterator.next()) {
+    auto event = iterator.event();
+    if (event == VariableIterator::Event::endArray || event == VariableIterator::Event::endStruct) continue;
+    if (iterator.inStruct()) {
+      std::string name = iterator.key().empty() ? "UNDEFINED" : iterator.key();
+      _encoder->encodeString(packet, name);
+    }
+    if (event == VariableIterator::Event::beginArray || event == VariableIterator::Event::beginStruct) {
+      encodeType(packet, iterator.variable()->type);
+      _encoder->encodeInteger(packet, event == VariableIterator::Event::beginArray ? iterator.variable()->arrayValue->size() : iterator.variable()->structValue->size());
+    } else if (iterator.variable()) encodeValue(packet, *iterator.variable());
+    else encodeVoid(packet);
+  }
+}
+
+void RpcEncoder::encodeValue(std::vector<char> &packet, const Variable &variable) {
+  if (variable.type == VariableType::tVoid) {
     encodeVoid(packet);
-  } else if (variable->type == VariableType::tInteger) {
+  } else if (variable.type == VariableType::tInteger) {
     if (_forceInteger64) {
-      if (variable->integerValue64 == 0) variable->integerValue64 = variable->integerValue;
-      encodeInteger64(packet, variable);
+      encodeType(packet, VariableType::tInteger64);
+      _encoder->encodeInteger64(packet, variable.integerValue64 == 0 ? variable.integerValue : variable.integerValue64);
     } else encodeInteger(packet, variable);
-  } else if (variable->type == VariableType::tInteger64) {
+  } else if (variable.type == VariableType::tInteger64) {
     encodeInteger64(packet, variable);
-  } else if (variable->type == VariableType::tFloat) {
+  } else if (variable.type == VariableType::tFloat) {
     encodeFloat(packet, variable);
-  } else if (variable->type == VariableType::tBoolean) {
+  } else if (variable.type == VariableType::tBoolean) {
     encodeBoolean(packet, variable);
-  } else if (variable->type == VariableType::tString) {
+  } else if (variable.type == VariableType::tString) {
     encodeString(packet, variable);
-  } else if (variable->type == VariableType::tBase64) {
+  } else if (variable.type == VariableType::tBase64) {
     encodeBase64(packet, variable);
-  } else if (variable->type == VariableType::tBinary) {
+  } else if (variable.type == VariableType::tBinary) {
     encodeBinary(packet, variable);
-  } else if (variable->type == VariableType::tStruct) {
-    encodeStruct(packet, variable);
-  } else if (variable->type == VariableType::tArray) {
-    encodeArray(packet, variable);
+  } else if (variable.isPackedArray()) {
+    encodePackedArray(packet, variable);
   }
 }
 
 void RpcEncoder::encodeVariable(std::vector<uint8_t> &packet, std::shared_ptr<Variable> &variable) {
   if (!variable) variable.reset(new Variable(VariableType::tVoid));
-  if (variable->type == VariableType::tVoid) {
+  if (variable->type != VariableType::tStruct && variable->type != VariableType::tArray) {
+    encodeValue(packet, *variable);
+    return;
+  }
+
+  VariableIterator iterator(*variable, 0);
+  while (iterator.next()) {
+    auto event = iterator.event();
+    if (event == VariableIterator::Event::endArray || event == VariableIterator::Event::endStruct) continue;
+    if (iterator.inStruct()) {
+      std::string name = iterator.key().empty() ? "UNDEFINED" : iterator.key();
+      _encoder->encodeString(packet, name);
+    }
+    if (event == VariableIterator::Event::beginArray || event == VariableIterator::Event::beginStruct) {
+      encodeType(packet, iterator.variable()->type);
+      _encoder->encodeInteger(packet, event == VariableIterator::Event::beginArray ? iterator.variable()->arrayValue->size() : iterator.variable()->structValue->size());
+    } else if (iterator.variable()) encodeValue(packet, *iterator.variable());
+    else encodeVoid(packet);
+  }
+}
+
+void RpcEncoder::encodeValue(std::vector<uint8_t> &packet, const Variable &variable) {
+  if (variable.type == VariableType::tVoid) {
     encodeVoid(packet);
-  } else if (variable->type == VariableType::tInteger) {
+  } else if (variable.type == VariableType::tInteger) {
     if (_forceInteger64) {
-      if (variable->integerValue64 == 0) variable->integerValue64 = variable->integerValue;
-      encodeInteger64(packet, variable);
+      encodeType(packet, VariableType::tInteger64);
+      _encoder->encodeInteger64(packet, variable.integerValue64 == 0 ? variable.integerValue : variable.integerValue64);
     } else encodeInteger(packet, variable);
-  } else if (variable->type == VariableType::tInteger64) {
+  } else if (variable.type == VariableType::tInteger64) {
     encodeInteger64(packet, variable);
-  } else if (variable->type == VariableType::tFloat) {
+  } else if (variable.type == VariableType::tFloat) {
     encodeFloat(packet, variable);
-  } else if (variable->type == VariableType::tBoolean) {
+  } else if (variable.type == VariableType::tBoolean) {
     encodeBoolean(packet, variable);
-  } else if (variable->type == VariableType::tString) {
+  } else if (variable.type == VariableType::tString) {
     encodeString(packet, variable);
-  } else if (variable->type == VariableType::tBase64) {
+  } else if (variable.type == VariableType::tBase64) {
     encodeBase64(packet, variable);
-  } else if (variable->type == VariableType::tBinary) {
+  } else if (variable.type == VariableType::tBinary) {
     encodeBinary(packet, variable);
-  } else if (variable->type == VariableType::tStruct) {
-    encodeStruct(packet, variable);
-  } else if (variable->type == VariableType::tArray) {
-    encodeArray(packet, variable);
-  }
-}
-
-void RpcEncoder::encodeStruct(std::vector<char> &packet, std::shared_ptr<Variable> &variable) {
-  encodeType(packet, VariableType::tStruct);
-  _encoder->encodeInteger(packet, variable->structValue->size());
-  for (Struct::iterator i = variable->structValue->begin(); i != variable->structValue->end(); ++i) {
-    std::string name = i->first.empty() ? "UNDEFINED" : i->first;
-    _encoder->encodeString(packet, name);
-    if (!i->second) i->second.reset(new Variable(VariableType::tVoid));
-    encodeVariable(packet, i->second);
+  } else if (variable.isPackedArray()) {
+    encodePackedArray(packet, variable);
   }
 }
 
-void RpcEncoder::encodeStruct(std::vector<uint8_t> &packet, std::shared_ptr<Variable> &variable) {
-  encodeType(packet, VariableType::tStruct);
-  _encoder->encodeInteger(packet, variable->structValue->size());
-  for (Struct::iterator i = variable->structValue->begin(); i != variable->structValue->end(); ++i) {
-    std::string name = i->first.empty() ? "UNDEFINED" : i->first;
-    _encoder->encodeString(packet, name);
-    if (!i->second) i->second.reset(new Variable(VariableType::tVoid));
-    encodeVariable(packet, i->second);
-  }
-}
-
-void RpcEncoder::encodeArray(std::vector<char> &packet, std::shared_ptr<Variable> &variable) {
+void RpcEncoder::encodePackedArray(std::vector<char> &packet, const Variable &variable) {
   encodeType(packet, VariableType::tArray);
-  _encoder->encodeInteger(packet, variable->arrayValue->size());
-  for (std::vector<std::shared_ptr<Variable>>::iterator i = variable->arrayValue->begin(); i != variable->arrayValue->end(); ++i) {
-    encodeVariable(packet, *i);
+  auto size = variable.packedArraySize();
+  _encoder->encodeInteger(packet, size);
+  if (variable.type == VariableType::tInteger64Array) {
+    auto integers = variable.packedIntegers();
+    //Encoded like the elements unpack() creates, so decoding restores the same element types.
+    for (size_t i = 0; i < size; i++) {
+      if (integers[i] >= INT32_MIN && integers[i] <= INT32_MAX) {
+        encodeType(packet, VariableType::tInteger);
+        _encoder->encodeInteger(packet, (int32_t)integers[i]);
+      } else {
+        encodeType(packet, VariableType::tInteger64);
+        _encoder->encodeInteger64(packet, integers[i]);
+      }
+    }
+  } else {
+    auto floats = variable.packedFloats();
+    for (size_t i = 0; i < size; i++) {
+      encodeType(packet, VariableType::tFloat);
+      _encoder->encodeFloat(packet, floats[i]);
+    }
   }
 }
 
-void RpcEncoder::encodeArray(std::vector<uint8_t> &packet, std::shared_ptr<Variable> &variable) {
+void RpcEncoder::encodePackedArray(std::vector<uint8_t> &packet, const Variable &variable) {
   encodeType(packet, VariableType::tArray);
-  _encoder->encodeInteger(packet, variable->arrayValue->size());
-  for (std::vector<std::shared_ptr<Variable>>::iterator i = variable->arrayValue->begin(); i != variable->arrayValue->end(); ++i) {
-    encodeVariable(packet, *i);
+  auto size = variable.packedArraySize();
+  _encoder->encodeInteger(packet, size);
+  if (variable.type == VariableType::tInteger64Array) {
+    auto integers = variable.packedIntegers();
+    //Encoded like the elements unpack() creates, so decoding restores the same element types.
+    for (size_t i = 0; i < size; i++) {
+      if (integers[i] >= INT32_MIN && integers[i] <= INT32_MAX) {
+        encodeType(packet, VariableType::tInteger);
+        _encoder->encodeInteger(packet, (int32_t)integers[i]);
+      } else {
+        encodeType(packet, VariableType::tInteger64);
+        _encoder->encodeInteger64(packet, integers[i]);
+      }
+    }
+  } else {
+    auto floats = variable.packedFloats();
+    for (size_t i = 0; i < size; i++) {
+      encodeType(packet, VariableType::tFloat);
+      _encoder->encodeFloat(packet, floats[i]);
+    }
   }
 }
 
@@ -355,95 +408,95 @@ void RpcEncoder::encodeType(std::vector<uint8_t> &packet, VariableType type) {
   _encoder->encodeInteger(packet, (int32_t)type);
 }
 
-void RpcEncoder::encodeInteger(std::vector<char> &packet, std::shared_ptr<Variable> &variable) {
+void RpcEncoder::encodeInteger(std::vector<char> &packet, const Variable &variable) {
   encodeType(packet, VariableType::tInteger);
-  _encoder->encodeInteger(packet, variable->integerValue);
+  _encoder->encodeInteger(packet, variable.integerValue);
 }
 
-void RpcEncoder::encodeInteger(std::vector<uint8_t> &packet, std::shared_ptr<Variable> &variable) {
+void RpcEncoder::encodeInteger(std::vector<uint8_t> &packet, const Variable &variable) {
   encodeType(packet, VariableType::tInteger);
-  _encoder->encodeInteger(packet, variable->integerValue);
+  _encoder->encodeInteger(packet, variable.integerValue);
 }
 
-void RpcEncoder::encodeInteger64(std::vector<char> &packet, std::shared_ptr<Variable> &variable) {
+void RpcEncoder::encodeInteger64(std::vector<char> &packet, const Variable &variable) {
   encodeType(packet, VariableType::tInteger64);
-  _encoder->encodeInteger64(packet, variable->integerValue64);
+  _encoder->encodeInteger64(packet, variable.integerValue64);
 }
 
-void RpcEncoder::encodeInteger64(std::vector<uint8_t> &packet, std::shared_ptr<Variable> &variable) {
+void RpcEncoder::encodeInteger64(std::vector<uint8_t> &packet, const Variable &variable) {
   encodeType(packet, VariableType::tInteger64);
-  _encoder->encodeInteger64(packet, variable->integerValue64);
+  _encoder->encodeInteger64(packet, variable.integerValue64);
 }
 
-void RpcEncoder::encodeFloat(std::vector<char> &packet, std::shared_ptr<Variable> &variable) {
+void RpcEncoder::encodeFloat(std::vector<char> &packet, const Variable &variable) {
   encodeType(packet, VariableType::tFloat);
-  _encoder->encodeFloat(packet, variable->floatValue);
+  _encoder->encodeFloat(packet, variable.floatValue);
 }
 
-void RpcEncoder::encodeFloat(std::vector<uint8_t> &packet, std::shared_ptr<Variable> &variable) {
+void RpcEncoder::encodeFloat(std::vector<uint8_t> &packet, const Variable &variable) {
   encodeType(packet, VariableType::tFloat);
-  _encoder->encodeFloat(packet, variable->floatValue);
+  _encoder->encodeFloat(packet, variable.floatValue);
 }
 
-void RpcEncoder::encodeBoolean(std::vector<char> &packet, std::shared_ptr<Variable> &variable) {
+void RpcEncoder::encodeBoolean(std::vector<char> &packet, const Variable &variable) {
   encodeType(packet, VariableType::tBoolean);
-  _encoder->encodeBoolean(packet, variable->booleanValue);
+  _encoder->encodeBoolean(packet, variable.booleanValue);
 }
 
-void RpcEncoder::encodeBoolean(std::vector<uint8_t> &packet, std::shared_ptr<Variable> &variable) {
+void RpcEncoder::encodeBoolean(std::vector<uint8_t> &packet, const Variable &variable) {
   encodeType(packet, VariableType::tBoolean);
-  _encoder->encodeBoolean(packet, variable->booleanValue);
+  _encoder->encodeBoolean(packet, variable.booleanValue);
 }
 
-void RpcEncoder::encodeString(std::vector<char> &packet, std::shared_ptr<Variable> &variable) {
+void RpcEncoder::encodeString(std::vector<char> &packet, const Variable &variable) {
   encodeType(packet, VariableType::tString);
   //We could call encodeRawString here, but then the string would have to be copied and that would cost time.
-  _encoder->encodeInteger(packet, variable->stringValue.size());
-  if (variable->stringValue.size() > 0) {
-    packet.insert(packet.end(), variable->stringValue.begin(), variable->stringValue.end());
+  _encoder->encodeInteger(packet, variable.stringValue.size());
+  if (variable.stringValue.size() > 0) {
+    packet.insert(packet.end(), variable.stringValue.begin(), variable.stringValue.end());
   }
 }
 
-void RpcEncoder::encodeString(std::vector<uint8_t> &packet, std::shared_ptr<Variable> &variable) {
+void RpcEncoder::encodeString(std::vector<uint8_t> &packet, const Variable &variable) {
   encodeType(packet, VariableType::tString);
   //We could call encodeRawString here, but then the string would have to be copied and that would cost time.
-  _encoder->encodeInteger(packet, variable->stringValue.size());
-  if (variable->stringValue.size() > 0) {
-    packet.insert(packet.end(), variable->stringValue.begin(), variable->stringValue.end());
+  _encoder->encodeInteger(packet, variable.stringValue.size());
+  if (variable.stringValue.size() > 0) {
+    packet.insert(packet.end(), variable.stringValue.begin(), variable.stringValue.end());
   }
 }
 
-void RpcEncoder::encodeBase64(std::vector<char> &packet, std::shared_ptr<Variable> &variable) {
+void RpcEncoder::encodeBase64(std::vector<char> &packet, const Variable &variable) {
   encodeType(packet, VariableType::tBase64);
   //We could call encodeRawString here, but then the string would have to be copied and that would cost time.
-  _encoder->encodeInteger(packet, variable->stringValue.size());
-  if (variable->stringValue.size() > 0) {
-    packet.insert(packet.end(), variable->stringValue.begin(), variable->stringValue.end());
+  _encoder->encodeInteger(packet, variable.stringValue.size());
+  if (variable.stringValue.size() > 0) {
+    packet.insert(packet.end(), variable.stringValue.begin(), variable.stringValue.end());
   }
 }
 
-void RpcEncoder::encodeBase64(std::vector<uint8_t> &packet, std::shared_ptr<Variable> &variable) {
+void RpcEncoder::encodeBase64(std::vector<uint8_t> &packet, const Variable &variable) {
   encodeType(packet, VariableType::tBase64);
   //We could call encodeRawString here, but then the string would have to be copied and that would cost time.
-  _encoder->encodeInteger(packet, variable->stringValue.size());
-  if (variable->stringValue.size() > 0) {
-    packet.insert(packet.end(), variable->stringValue.begin(), variable->stringValue.end());
+  _encoder->encodeInteger(packet, variable.stringValue.size());
+  if (variable.stringValue.size() > 0) {
+    packet.insert(packet.end(), variable.stringValue.begin(), variable.stringValue.end());
   }
 }
 
-void RpcEncoder::encodeBinary(std::vector<char> &packet, std::shared_ptr<Variable> &variable) {
+void RpcEncoder::encodeBinary(std::vector<char> &packet, const Variable &variable) {
   encodeType(packet, VariableType::tBinary);
-  _encoder->encodeInteger(packet, variable->binaryValue.size());
-  if (variable->binaryValue.size() > 0) {
-    packet.insert(packet.end(), variable->binaryValue.begin(), variable->binaryValue.end());
+  _encoder->encodeInteger(packet, variable.binaryValue.size());
+  if (variable.binaryValue.size() > 0) {
+    packet.insert(packet.end(), variable.binaryValue.begin(), variable.binaryValue.end());
   }
 }
 
-void RpcEncoder::encodeBinary(std::vector<uint8_t> &packet, std::shared_ptr<Variable> &variable) {
+void RpcEncoder::encodeBinary(std::vector<uint8_t> &packet, const Variable &variable) {
   encodeType(packet, VariableType::tBinary);
-  _encoder->encodeInteger(packet, variable->binaryValue.size());
-  if (variable->binaryValue.size() > 0) {
-    packet.insert(packet.end(), variable->binaryValue.begin(), variable->binaryValue.end());
+  _encoder->encodeInteger(packet, variable.binaryValue.size());
+  if (variable.binaryValue.size() > 0) {
+    packet.insert(packet.end(), variable.binaryValue.begin(), variable.binaryValue.end());
   }
 }
 
@@ -85,28 +85,28 @@ class RpcEncoder {
   uint32_t encodeHeader(std::vector<uint8_t> &packet, const RpcHeader &header);
   void encodeVariable(std::vector<char> &packet, std::shared_ptr<Variable> &variable);
   void encodeVariable(std::vector<uint8_t> &packet, std::shared_ptr<Variable> &variable);
-  void encodeInteger(std::vector<char> &packet, std::shared_ptr<Variable> &variable);
-  void encodeInteger(std::vector<uint8_t> &packet, std::shared_ptr<Variable> &variable);
-  void encodeInteger64(std::vector<char> &packet, std::shared_ptr<Variable> &variable);
-  void encodeInteger64(std::vector<uint8_t> &packet, std::shared_ptr<Variable> &variable);
-  void encodeFloat(std::vector<char> &packet, std::shared_ptr<Variable> &variable);
-  void encodeFloat(std::vector<uint8_t> &packet, std::shared_ptr<Variable> &variable);
-  void encodeBoolean(std::vector<char> &packet, std::shared_ptr<Variable> &variable);
-  void encodeBoolean(std::vector<uint8_t> &packet, std::shared_ptr<Variable> &variable);
+  void encodeValue(std::vector<char> &packet, const Variable &variable);
+  void encodeValue(std::vector<uint8_t> &packet, const Variable &variable);
+  void encodeInteger(std::vector<char> &packet, const Variable &variable);
+  void encodeInteger(std::vector<uint8_t> &packet, const Variable &variable);
+  void encodeInteger64(std::vector<char> &packet, const Variable &variable);
+  void encodeInteger64(std::vector<uint8_t> &packet, const Variable &variable);
+  void encodeFloat(std::vector<char> &packet, const Variable &variable);
+  void encodeFloat(std::vector<uint8_t> &packet, const Variable &variable);
+  void encodeBoolean(std::vector<char> &packet, const Variable &variable);
+  void encodeBoolean(std::vector<uint8_t> &packet, const Variable &variable);
   void encodeType(std::vector<char> &packet, VariableType type);
   void encodeType(std::vector<uint8_t> &packet, VariableType type);
-  void encodeString(std::vector<char> &packet, std::shared_ptr<Variable> &variable);
-  void encodeString(std::vector<uint8_t> &packet, std::shared_ptr<Variable> &variable);
-  void encodeBase64(std::vector<char> &packet, std::shared_ptr<Variable> &variable);
-  void encodeBase64(std::vector<uint8_t> &packet, std::shared_ptr<Variable> &variable);
-  void encodeBinary(std::vector<char> &packet, std::shared_ptr<Variable> &variable);
-  void encodeBinary(std::vector<uint8_t> &packet, std::shared_ptr<Variable> &variable);
+  void encodeString(std::vector<char> &packet, const Variable &variable);
+  void encodeString(std::vector<uint8_t> &packet, const Variable &variable);
+  void encodeBase64(std::vector<char> &packet, const Variable &variable);
+  void encodeBase64(std::vector<uint8_t> &packet, const Variable &variable);
+  void encodeBinary(std::vector<char> &packet, const Variable &variable);
+  void encodeBinary(std::vector<uint8_t> &packet, const Variable &variable);
   void encodeVoid(std::vector<char> &packet);
   void encodeVoid(std::vector<uint8_t> &packet);
-  void encodeStruct(std::vector<char> &packet, std::shared_ptr<Variable> &variable);
-  void encodeStruct(std::vector<uint8_t> &packet, std::shared_ptr<Variable> &variable);
-  void encodeArray(std::vector<char> &packet, std::shared_ptr<Variable> &variable);
-  void encodeArray(std::vector<uint8_t> &packet, std::shared_ptr<Variable> &variable);
+  void encodePackedArray(std::vector<char> &packet, const Variable &variable);
+  void encodePackedArray(std::vector<uint8_t> &packet, const Variable &variable);
 };
 
 }
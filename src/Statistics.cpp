@@ -0,0 +1,277 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "Statistics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define STATISTICS_X86
+#endif
+
+namespace Flows {
+
+namespace {
+
+struct Kernels {
+  const char *name;
+  void (*minMaxSum)(const double *values, size_t count, double &min, double &max, double &sum);
+  double (*squaredDeviation)(const double *values, size_t count, double mean);
+};
+
+void minMaxSumScalar(const double *values, size_t count, double &min, double &max, double &sum) {
+  min = values[0];
+  max = values[0];
+  sum = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (values[i] < min) min = values[i];
+    if (values[i] > max) max = values[i];
+    sum += values[i];
+  }
+}
+
+double squaredDeviationScalar(const double *values, size_t count, double mean) {
+  double result = 0;
+  for (size_t i = 0; i < count; i++) {
+    double deviation = values[i] - mean;
+    result += deviation * deviation;
+  }
+  return result;
+}
+
+#ifdef STATISTICS_X86
+__attribute__((target("sse2")))
+void minMaxSumSse2(const double *values, size_t count, double &min, double &max, double &sum) {
+  __m128d minVector = _mm_set1_pd(values[0]);
+  __m128d maxVector = minVector;
+  __m128d sumVector0 = _mm_setzero_pd();
+  __m128d sumVector1 = _mm_setzero_pd();
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128d a = _mm_loadu_pd(values + i);
+    __m128d b = _mm_loadu_pd(values + i + 2);
+    minVector = _mm_min_pd(minVector, _mm_min_pd(a, b));
+    maxVector = _mm_max_pd(maxVector, _mm_max_pd(a, b));
+    sumVector0 = _mm_add_pd(sumVector0, a);
+    sumVector1 = _mm_add_pd(sumVector1, b);
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, minVector);
+  min = std::min(lanes[0], lanes[1]);
+  _mm_storeu_pd(lanes, maxVector);
+  max = std::max(lanes[0], lanes[1]);
+  _mm_storeu_pd(lanes, _mm_add_pd(sumVector0, sumVector1));
+  sum = lanes[0] + lanes[1];
+  for (; i < count; i++) {
+    if (values[i] < min) min = values[i];
+    if (values[i] > max) max = values[i];
+    sum += values[i];
+  }
+}
+
+__attribute__((target("sse2")))
+double squaredDeviationSse2(const double *values, size_t count, double mean) {
+  __m128d meanVector = _mm_set1_pd(mean);
+  __m128d resultVector0 = _mm_setzero_pd();
+  __m128d resultVector1 = _mm_setzero_pd();
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128d a = _mm_sub_pd(_mm_loadu_pd(values + i), meanVector);
+    __m128d b = _mm_sub_pd(_mm_loadu_pd(values + i + 2), meanVector);
+    resultVector0 = _mm_add_pd(resultVector0, _mm_mul_pd(a, a));
+    resultVector1 = _mm_add_pd(resultVector1, _mm_mul_pd(b, b));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, _mm_add_pd(resultVector0, resultVector1));
+  double result = lanes[0] + lanes[1];
+  for (; i < count; i++) {
+    double deviation = values[i] - mean;
+    result += deviation * deviation;
+  }
+  return result;
+}
+
+__attribute__((target("avx2")))
+void minMaxSumAvx2(const double *values, size_t count, double &min, double &max, double &sum) {
+  __m256d minVector = _mm256_set1_pd(values[0]);
+  __m256d maxVector = minVector;
+  __m256d sumVector0 = _mm256_setzero_pd();
+  __m256d sumVector1 = _mm256_setzero_pd();
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256d a = _mm256_loadu_pd(values + i);
+    __m256d b = _mm256_loadu_pd(values + i + 4);
+    minVector = _mm256_min_pd(minVector, _mm256_min_pd(a, b));
+    maxVector = _mm256_max_pd(maxVector, _mm256_max_pd(a, b));
+    sumVector0 = _mm256_add_pd(sumVector0, a);
+    sumVector1 = _mm256_add_pd(sumVector1, b);
+  }
+  double lanes[4];
+  _mm256_storeu_pd(lanes, minVector);
+  min = std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+  _mm256_storeu_pd(lanes, maxVector);
+  max = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+  _mm256_storeu_pd(lanes, _mm256_add_pd(sumVector0, sumVector1));
+  sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+  for (; i < count; i++) {
+    if (values[i] < min) min = values[i];
+    if (values[i] > max) max = values[i];
+    sum += values[i];
+  }
+}
+
+__attribute__((target("avx2")))
+double squaredDeviationAvx2(const double *values, size_t count, double mean) {
+  __m256d meanVector = _mm256_set1_pd(mean);
+  __m256d resultVector0 = _mm256_setzero_pd();
+  __m256d resultVector1 = _mm256_setzero_pd();
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256d a = _mm256_sub_pd(_mm256_loadu_pd(values + i), meanVector);
+    __m256d b = _mm256_sub_pd(_mm256_loadu_pd(values + i + 4), meanVector);
+    resultVector0 = _mm256_add_pd(resultVector0, _mm256_mul_pd(a, a));
+    resultVector1 = _mm256_add_pd(resultVector1, _mm256_mul_pd(b, b));
+  }
+  double lanes[4];
+  _mm256_storeu_pd(lanes, _mm256_add_pd(resultVector0, resultVector1));
+  double result = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+  for (; i < count; i++) {
+    double deviation = values[i] - mean;
+    result += deviation * deviation;
+  }
+  return result;
+}
+#endif
+
+/**
+ * @return Returns the kernels supported by the CPU, the fastest first.
+ */
+const std::vector<Kernels> &availableKernels() {
+  static const std::vector<Kernels> supportedKernels = []() {
+    std::vector<Kernels> result;
+#ifdef STATISTICS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) result.push_back(Kernels{"avx2", &minMaxSumAvx2, &squaredDeviationAvx2});
+    if (__builtin_cpu_supports("sse2")) result.push_back(Kernels{"sse2", &minMaxSumSse2, &squaredDeviationSse2});
+#endif
+    result.push_back(Kernels{"scalar", &minMaxSumScalar, &squaredDeviationScalar});
+    return result;
+  }();
+  return supportedKernels;
+}
+
+/**
+ * The index of the selected kernel in availableKernels().
+ */
+std::atomic<size_t> selectedKernel{0};
+
+}
+
+Statistics::Result Statistics::calculate(const double *values, size_t count) {
+  Result result;
+  if (count == 0) return result;
+  auto &selectedKernels = availableKernels()[selectedKernel.load(std::memory_order_relaxed)];
+  result.count = count;
+  selectedKernels.minMaxSum(values, count, result.min, result.max, result.sum);
+  result.mean = result.sum / (double)count;
+  //Two passes, as summing up squares in the first pass loses precision for values far away from 0.
+  result.stddev = std::sqrt(selectedKernels.squaredDeviation(values, count, result.mean) / (double)count);
+  return result;
+}
+
+Statistics::Result Statistics::calculate(const int64_t *values, size_t count) {
+  Result result;
+  if (count == 0) return result;
+  result.count = count;
+  int64_t min = values[0];
+  int64_t max = values[0];
+  for (size_t i = 0; i < count; i++) {
+    if (values[i] < min) min = values[i];
+    if (values[i] > max) max = values[i];
+    result.sum += (double)values[i];
+  }
+  result.min = (double)min;
+  result.max = (double)max;
+  result.mean = result.sum / (double)count;
+  double squaredDeviation = 0;
+  for (size_t i = 0; i < count; i++) {
+    double deviation = (double)values[i] - result.mean;
+    squaredDeviation += deviation * deviation;
+  }
+  result.stddev = std::sqrt(squaredDeviation / (double)count);
+  return result;
+}
+
+Statistics::Result Statistics::calculate(const PVariable &variable) {
+  if (!variable) return Result();
+  if (variable->type == VariableType::tFloatArray) return calculate(variable->packedFloats(), variable->packedArraySize());
+  if (variable->type == VariableType::tInteger64Array) return calculate(variable->packedIntegers(), variable->packedArraySize());
+  if (variable->type != VariableType::tArray) return Result();
+
+  const Variable &array = *variable;
+  std::vector<double> values;
+  values.reserve(array.arrayValue->size());
+  for (auto &element : *array.arrayValue) {
+    if (!element) continue;
+    if (element->type == VariableType::tFloat) values.push_back(element->floatValue);
+    else if (element->type == VariableType::tInteger) values.push_back(element->integerValue);
+    else if (element->type == VariableType::tInteger64) values.push_back((double)element->integerValue64);
+  }
+  return calculate(values.data(), values.size());
+}
+
+std::string Statistics::kernel() {
+  return availableKernels()[selectedKernel.load(std::memory_order_relaxed)].name;
+}
+
+std::vector<std::string> Statistics::kernels() {
+  std::vector<std::string> names;
+  for (auto &kernel : availableKernels()) {
+    names.emplace_back(kernel.name);
+  }
+  return names;
+}
+
+bool Statistics::setKernel(const std::string &kernel) {
+  auto &kernels = availableKernels();
+  for (size_t i = 0; i < kernels.size(); i++) {
+    if (kernel == kernels[i].name) {
+      selectedKernel.store(i, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+}
@@ -0,0 +1,113 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#ifndef LIBHOMEGEAR_NODE_STATISTICS_H
+#define LIBHOMEGEAR_NODE_STATISTICS_H
+
+#include "Variable.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Flows {
+
+/**
+ * Aggregation functions over numeric arrays. Packed float arrays (see Variable::pack()) are processed with SIMD
+ * kernels. The kernel is chosen at runtime: AVX2 if the CPU supports it, SSE2 on all other x86 CPUs and a scalar
+ * implementation everywhere else. setKernel() overrides the choice. Ordinary arrays are gathered into a packed buffer
+ * first.
+ */
+class Statistics {
+ public:
+  Statistics() = delete;
+
+  struct Result {
+    size_t count = 0;
+    double min = 0;
+    double max = 0;
+    double sum = 0;
+    double mean = 0;
+
+    /**
+     * The population standard deviation.
+     */
+    double stddev = 0;
+  };
+
+  /**
+   * Calculates count, min, max, sum, mean and standard deviation. The result is undefined when the values contain
+   * NaN. Sums are calculated in a different order than a simple loop would, so the last digits can differ.
+   *
+   * @param values The values. Must not be nullptr when count is not 0.
+   * @param count The number of values.
+   * @return Returns the statistics. All fields are 0 when count is 0.
+   */
+  static Result calculate(const double *values, size_t count);
+
+  /**
+   * Like calculate(const double*, size_t). Min and max are exact, sum, mean and standard deviation are calculated
+   * as doubles.
+   */
+  static Result calculate(const int64_t *values, size_t count);
+
+  /**
+   * Calculates the statistics of a packed array or of the numbers (tInteger, tInteger64 and tFloat) in an array.
+   * Other elements are ignored.
+   *
+   * @param variable A packed array or an array.
+   * @return Returns the statistics. All fields are 0 for other types or when there are no numbers.
+   */
+  static Result calculate(const PVariable &variable);
+
+  /**
+   * @return Returns the name of the kernel in use ("avx2", "sse2" or "scalar").
+   */
+  static std::string kernel();
+
+  /**
+   * @return Returns the names of all kernels supported by the CPU, the default one first.
+   */
+  static std::vector<std::string> kernels();
+
+  /**
+   * Selects the kernel used by all following calculations instead of the default one, e.g. to compare the kernels
+   * with each other. Calculations already running keep the kernel they started with.
+   *
+   * @param kernel One of the names returned by kernels().
+   * @return Returns false when the kernel is not supported by the CPU.
+   */
+  static bool setKernel(const std::string &kernel);
+};
+
+}
+
+#endif //LIBHOMEGEAR_NODE_STATISTICS_H
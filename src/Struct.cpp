@@ -0,0 +1,319 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "Struct.h"
+#include "HelperFunctions.h"
+#include "Variable.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+namespace Flows {
+
+uint32_t Struct::hashKey(std::string_view key) {
+  auto hash = std::hash<std::string_view>()(key);
+  return (uint32_t)(hash ^ (hash >> 32));
+}
+
+Struct::Struct(std::initializer_list<value_type> elements) {
+  insert(elements.begin(), elements.end());
+}
+
+Struct::Struct(Struct &&rhs) {
+  if (rhs._frozen) *this = rhs;
+  else *this = std::move(rhs);
+}
+
+Struct &Struct::operator=(const Struct &rhs) {
+  checkWritable();
+  _elements = rhs._elements;
+  _slots = rhs._slots;
+  _indexDisabled = rhs._indexDisabled;
+  return *this;
+}
+
+Struct &Struct::operator=(Struct &&rhs) {
+  if (&rhs == this) return *this;
+  checkWritable();
+  if (rhs._frozen) return *this = rhs;
+  _elements = std::move(rhs._elements);
+  _slots = std::move(rhs._slots);
+  _indexDisabled = rhs._indexDisabled;
+  rhs.clear();
+  return *this;
+}
+
+void Struct::throwFrozen() {
+  throw FrozenVariableException("Modification of a frozen struct. Use Variable::detach() to get a writable copy.");
+}
+
+void Struct::clear() {
+  checkWritable();
+  _elements.clear();
+  _slots.clear();
+  _indexDisabled = false;
+}
+
+Struct::size_type Struct::lowerBoundIndex(std::string_view key) const {
+  auto iterator = std::lower_bound(_elements.begin(), _elements.end(), key, [](const value_type &element, std::string_view key) { return std::string_view(element.first) < key; });
+  return (size_type)(iterator - _elements.begin());
+}
+
+Struct::size_type Struct::scanIndex(std::string_view key) const {
+  if (_elements.size() < _hashThreshold) {
+    //For the few keys of a typical message a linear scan comparing the lengths first beats a binary search.
+    for (size_type i = 0; i < _elements.size(); i++) {
+      auto &elementKey = _elements[i].first;
+      if (elementKey.size() == key.size() && elementKey.compare(0, elementKey.size(), key.data(), key.size()) == 0) return i;
+    }
+    return _elements.size();
+  }
+  //Large structs without hash index, see disableIndex().
+  auto index = lowerBoundIndex(key);
+  return index < _elements.size() && _elements[index].first == key ? index : _elements.size();
+}
+
+Struct::size_type Struct::findIndex(std::string_view key, uint32_t hash) const {
+  if (_slots.empty()) return scanIndex(key);
+  auto mask = _slots.size() - 1;
+  //insertSlot() never places a key further than _maxProbeLength slots from its home slot.
+  auto i = hash & mask;
+  for (uint32_t probe = 0; probe < _maxProbeLength; probe++, i = (i + 1) & mask) {
+    auto &slot = _slots[i];
+    if (slot.index == _emptySlot) return _elements.size();
+    if (slot.hash == hash && _elements[slot.index].first == key) return slot.index;
+  }
+  return _elements.size();
+}
+
+Struct::iterator Struct::upper_bound(std::string_view key) {
+  auto index = lowerBoundIndex(key);
+  if (index < _elements.size() && _elements[index].first == key) index++;
+  return _elements.begin() + index;
+}
+
+Struct::const_iterator Struct::upper_bound(std::string_view key) const {
+  auto index = lowerBoundIndex(key);
+  if (index < _elements.size() && _elements[index].first == key) index++;
+  return _elements.begin() + index;
+}
+
+PVariable &Struct::at(std::string_view key) {
+  auto index = findIndex(key);
+  if (index == _elements.size()) throw std::out_of_range("Struct::at: Key not found.");
+  return _elements[index].second;
+}
+
+const PVariable &Struct::at(std::string_view key) const {
+  auto index = findIndex(key);
+  if (index == _elements.size()) throw std::out_of_range("Struct::at: Key not found.");
+  return _elements[index].second;
+}
+
+PVariable &Struct::operator[](const std::string &key) {
+  //Might insert, so operator[] counts as modification even when the key exists.
+  checkWritable();
+  return try_emplace(key).first->second;
+}
+
+PVariable &Struct::operator[](std::string &&key) {
+  checkWritable();
+  return try_emplace(std::move(key)).first->second;
+}
+
+std::pair<Struct::iterator, bool> Struct::insert(value_type &&value) {
+  checkWritable();
+  //Elements often arrive sorted already (e.g. from RpcDecoder or when copying), so check for appending first.
+  if (_elements.empty() || _elements.back().first < value.first) return std::make_pair(insertAt(_elements.size(), std::move(value)), true);
+  auto index = lowerBoundIndex(value.first);
+  if (_elements[index].first == value.first) return std::make_pair(_elements.begin() + index, false);
+  return std::make_pair(insertAt(index, std::move(value)), true);
+}
+
+Struct::iterator Struct::insert(const_iterator hint, value_type &&value) {
+  checkWritable();
+  auto index = (size_type)(hint - _elements.cbegin());
+  if ((index == _elements.size() || value.first < _elements[index].first) && (index == 0 || _elements[index - 1].first < value.first)) {
+    return insertAt(index, std::move(value));
+  }
+  return insert(std::move(value)).first;
+}
+
+std::pair<Struct::iterator, bool> Struct::insert_or_assign(const std::string &key, PVariable value) {
+  auto result = try_emplace(key, std::move(value));
+  if (!result.second) result.first->second = std::move(value);
+  return result;
+}
+
+std::pair<Struct::iterator, bool> Struct::insert_or_assign(std::string &&key, PVariable value) {
+  auto result = try_emplace(std::move(key), std::move(value));
+  if (!result.second) result.first->second = std::move(value);
+  return result;
+}
+
+Struct::iterator Struct::erase(const_iterator first, const_iterator last) {
+  checkWritable();
+  auto firstIndex = (uint32_t)(first - _elements.cbegin());
+  auto lastIndex = (uint32_t)(last - _elements.cbegin());
+  auto result = _elements.erase(first, last);
+  if (_elements.size() < _hashThreshold / 2) _indexDisabled = false;
+  if (_slots.empty() || firstIndex == lastIndex) return result;
+
+  if (_elements.size() < _hashThreshold / 2) {
+    _slots.clear();
+    _slots.shrink_to_fit();
+    return result;
+  }
+
+  //Reinsert the remaining slots using the stored hashes, so no key needs to be hashed again.
+  std::vector<Slot> oldSlots(_slots.size(), Slot{0, _emptySlot});
+  oldSlots.swap(_slots);
+  for (auto &slot : oldSlots) {
+    if (slot.index == _emptySlot || (slot.index >= firstIndex && slot.index < lastIndex)) continue;
+    if (!insertSlot(slot.hash, slot.index >= lastIndex ? slot.index - (lastIndex - firstIndex) : slot.index)) {
+      disableIndex();
+      break;
+    }
+  }
+  return result;
+}
+
+Struct::size_type Struct::erase(std::string_view key) {
+  auto index = findIndex(key);
+  if (index == _elements.size()) return 0;
+  erase(_elements.cbegin() + index);
+  return 1;
+}
+
+void Struct::swap(Struct &other) {
+  checkWritable();
+  other.checkWritable();
+  _elements.swap(other._elements);
+  _slots.swap(other._slots);
+  std::swap(_indexDisabled, other._indexDisabled);
+}
+
+size_t Struct::memoryUsage() const {
+  size_t result = _elements.capacity() * sizeof(value_type) + _slots.capacity() * sizeof(Slot);
+  for (auto &element : _elements) {
+    result += HelperFunctions::getHeapSize(element.first);
+  }
+  return result;
+}
+
+Struct::iterator Struct::insertAt(size_type index, value_type &&value) {
+  _elements.emplace(_elements.begin() + index, std::move(value));
+  if (_slots.empty()) {
+    if (_elements.size() >= _hashThreshold) buildIndex();
+  } else if (_elements.size() * 2 > _slots.size()) buildIndex();
+  else {
+    if (index != _elements.size() - 1) {
+      for (auto &slot : _slots) {
+        if (slot.index != _emptySlot && slot.index >= index) slot.index++;
+      }
+    }
+    if (!insertSlot(hashKey(_elements[index].first), (uint32_t)index)) disableIndex();
+  }
+  return _elements.begin() + index;
+}
+
+void Struct::mergeAppended(size_type sortedSize) {
+  if (sortedSize == _elements.size()) return;
+  auto less = [](const value_type &lhs, const value_type &rhs) { return lhs.first < rhs.first; };
+  auto equal = [](const value_type &lhs, const value_type &rhs) { return lhs.first == rhs.first; };
+  auto middle = _elements.begin() + sortedSize;
+  bool appended = (sortedSize == 0 || _elements[sortedSize - 1].first < middle->first) && std::adjacent_find(middle, _elements.end(), [](const value_type &lhs, const value_type &rhs) { return !(lhs.first < rhs.first); }) == _elements.end();
+  if (!appended) {
+    //Both sorts are stable and std::unique() keeps the first of equal elements, so existing elements take precedence
+    //over new ones and of the new ones the first wins.
+    std::stable_sort(middle, _elements.end(), less);
+    _elements.erase(std::unique(middle, _elements.end(), equal), _elements.end());
+    std::inplace_merge(_elements.begin(), _elements.begin() + sortedSize, _elements.end(), less);
+    _elements.erase(std::unique(_elements.begin(), _elements.end(), equal), _elements.end());
+  }
+
+  if (_slots.empty() && _elements.size() < _hashThreshold) return;
+  if (!appended || _slots.empty() || _elements.size() * 2 > _slots.size()) buildIndex();
+  else {
+    for (auto i = (uint32_t)sortedSize; i < (uint32_t)_elements.size(); i++) {
+      if (!insertSlot(hashKey(_elements[i].first), i)) {
+        disableIndex();
+        break;
+      }
+    }
+  }
+}
+
+bool Struct::insertSlot(uint32_t hash, uint32_t index) {
+  auto mask = _slots.size() - 1;
+  auto i = hash & mask;
+  for (uint32_t probe = 0; probe < _maxProbeLength; probe++, i = (i + 1) & mask) {
+    if (_slots[i].index != _emptySlot) continue;
+    _slots[i] = Slot{hash, index};
+    return true;
+  }
+  return false;
+}
+
+void Struct::buildIndex() {
+  if (_indexDisabled) return;
+  size_type slotCount = 64;
+  while (slotCount < _elements.size() * 4) {
+    slotCount *= 2;
+  }
+  _slots.assign(slotCount, Slot{0, _emptySlot});
+  for (uint32_t i = 0; i < (uint32_t)_elements.size(); i++) {
+    if (!insertSlot(hashKey(_elements[i].first), i)) {
+      disableIndex();
+      return;
+    }
+  }
+}
+
+void Struct::disableIndex() {
+  //Many keys share a home slot, most likely crafted to collide. A binary search keeps lookups at O(log n).
+  _slots.clear();
+  _slots.shrink_to_fit();
+  _indexDisabled = true;
+}
+
+void StructBuilder::add(Struct &structValue, size_t mark, std::string &&key, PVariable &&value) {
+  if (_pending.size() == mark && (structValue.empty() || structValue.rbegin()->first < key)) structValue.insert(structValue.end(), Struct::value_type(std::move(key), std::move(value)));
+  else _pending.emplace_back(std::move(key), std::move(value));
+}
+
+void StructBuilder::end(Struct &structValue, size_t mark) {
+  if (_pending.size() == mark) return;
+  structValue.insert(std::make_move_iterator(_pending.begin() + mark), std::make_move_iterator(_pending.end()));
+  discard(mark);
+}
+
+}
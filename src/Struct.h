@@ -0,0 +1,300 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#ifndef LIBHOMEGEAR_NODE_STRUCT_H
+#define LIBHOMEGEAR_NODE_STRUCT_H
+
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace Flows {
+
+class Variable;
+typedef std::shared_ptr<Variable> PVariable;
+
+/**
+ * Associative container mapping strings to Variables with the interface of std::map<std::string, PVariable>. Elements
+ * are stored in one vector sorted by key, so iteration order is the same as with std::map, but there is no allocation
+ * per element and lookups in the typical message with a handful of keys are a short linear scan over one or two
+ * cache lines. Once a Struct holds 16 or more elements, an open addressing hash index over the vector is maintained in
+ * addition, so lookups in large structs stay O(1). Keys come from untrusted input, so the probe length of the index is
+ * capped. When keys collide so much that the cap is exceeded, the index is dropped and lookups fall back to a binary
+ * search.
+ *
+ * Lookups take std::string_view, so no temporary std::string is needed to look up a literal. Keys are plain
+ * std::strings owned by the struct and are not interned: The common message keys ("payload", "topic", "_msgid",
+ * "source") fit into the small string buffer, so they don't cost a heap allocation, and handles instead of strings
+ * would change value_type, which node code relies on.
+ *
+ * Differences to std::map: Inserting or erasing elements invalidates all iterators and references to elements. Keys
+ * must not be modified through iterators. Inserting a single element anywhere but at the end is O(n), so build large
+ * structs from unsorted elements with the range insert() or StructBuilder.
+ *
+ * Structs of frozen Variables (see Variable::freeze()) are frozen as well. Lookups work as usual, but all functions
+ * adding or removing elements, operator[] and assignment throw FrozenVariableException. Copies are not frozen.
+ */
+class Struct {
+ public:
+  typedef std::string key_type;
+  typedef PVariable mapped_type;
+  typedef std::pair<std::string, PVariable> value_type;
+  typedef std::vector<value_type>::size_type size_type;
+  typedef std::vector<value_type>::difference_type difference_type;
+  typedef value_type &reference;
+  typedef const value_type &const_reference;
+  typedef std::vector<value_type>::iterator iterator;
+  typedef std::vector<value_type>::const_iterator const_iterator;
+  typedef std::vector<value_type>::reverse_iterator reverse_iterator;
+  typedef std::vector<value_type>::const_reverse_iterator const_reverse_iterator;
+
+  Struct() = default;
+  Struct(std::initializer_list<value_type> elements);
+  template<typename InputIterator>
+  Struct(InputIterator first, InputIterator last) { insert(first, last); }
+  Struct(const Struct &rhs) : _elements(rhs._elements), _slots(rhs._slots), _indexDisabled(rhs._indexDisabled) {}
+
+  /**
+   * Frozen structs are copied instead.
+   */
+  Struct(Struct &&rhs);
+  ~Struct() = default;
+  Struct &operator=(const Struct &rhs);
+  Struct &operator=(Struct &&rhs);
+
+  iterator begin() noexcept { return _elements.begin(); }
+  const_iterator begin() const noexcept { return _elements.begin(); }
+  const_iterator cbegin() const noexcept { return _elements.cbegin(); }
+  iterator end() noexcept { return _elements.end(); }
+  const_iterator end() const noexcept { return _elements.end(); }
+  const_iterator cend() const noexcept { return _elements.cend(); }
+  reverse_iterator rbegin() noexcept { return _elements.rbegin(); }
+  const_reverse_iterator rbegin() const noexcept { return _elements.rbegin(); }
+  reverse_iterator rend() noexcept { return _elements.rend(); }
+  const_reverse_iterator rend() const noexcept { return _elements.rend(); }
+
+  bool empty() const noexcept { return _elements.empty(); }
+  size_type size() const noexcept { return _elements.size(); }
+  void reserve(size_type size) {
+    checkWritable();
+    _elements.reserve(size);
+  }
+  void clear();
+
+  iterator find(std::string_view key) { return _elements.begin() + findIndex(key); }
+  const_iterator find(std::string_view key) const { return _elements.begin() + findIndex(key); }
+
+  /**
+   * Like find(key), but with the hash of the key precomputed with hashKey(), e.g. for keys looked up in every message.
+   */
+  iterator find(std::string_view key, uint32_t hash) { return _elements.begin() + findIndex(key, hash); }
+  const_iterator find(std::string_view key, uint32_t hash) const { return _elements.begin() + findIndex(key, hash); }
+  size_type count(std::string_view key) const { return findIndex(key) != _elements.size() ? 1 : 0; }
+  bool contains(std::string_view key) const { return findIndex(key) != _elements.size(); }
+  iterator lower_bound(std::string_view key) { return _elements.begin() + lowerBoundIndex(key); }
+  const_iterator lower_bound(std::string_view key) const { return _elements.begin() + lowerBoundIndex(key); }
+  iterator upper_bound(std::string_view key);
+  const_iterator upper_bound(std::string_view key) const;
+
+  /**
+   * @throws std::out_of_range when the key doesn't exist.
+   */
+  PVariable &at(std::string_view key);
+
+  /**
+   * @throws std::out_of_range when the key doesn't exist.
+   */
+  const PVariable &at(std::string_view key) const;
+
+  PVariable &operator[](const std::string &key);
+  PVariable &operator[](std::string &&key);
+
+  std::pair<iterator, bool> insert(const value_type &value) { return insert(value_type(value)); }
+  std::pair<iterator, bool> insert(value_type &&value);
+  iterator insert(const_iterator hint, const value_type &value) { return insert(hint, value_type(value)); }
+  iterator insert(const_iterator hint, value_type &&value);
+  /**
+   * Inserts all elements and sorts them in one go, so inserting n elements in arbitrary key order is O(n log n). Like
+   * with std::map, elements whose key already exists are not inserted and the first of several elements with the same
+   * key wins.
+   */
+  template<typename InputIterator>
+  void insert(InputIterator first, InputIterator last) {
+    checkWritable();
+    auto sortedSize = _elements.size();
+    try {
+      for (; first != last; ++first) {
+        _elements.emplace_back(*first);
+      }
+    } catch (...) {
+      _elements.erase(_elements.begin() + sortedSize, _elements.end());
+      throw;
+    }
+    mergeAppended(sortedSize);
+  }
+  void insert(std::initializer_list<value_type> elements) { insert(elements.begin(), elements.end()); }
+
+  template<typename... Args>
+  std::pair<iterator, bool> emplace(Args &&... args) { return insert(value_type(std::forward<Args>(args)...)); }
+  template<typename... Args>
+  iterator emplace_hint(const_iterator hint, Args &&... args) { return insert(hint, value_type(std::forward<Args>(args)...)); }
+  template<typename... Args>
+  std::pair<iterator, bool> try_emplace(const std::string &key, Args &&... args);
+  template<typename... Args>
+  std::pair<iterator, bool> try_emplace(std::string &&key, Args &&... args);
+  std::pair<iterator, bool> insert_or_assign(const std::string &key, PVariable value);
+  std::pair<iterator, bool> insert_or_assign(std::string &&key, PVariable value);
+
+  iterator erase(const_iterator position) { return erase(position, position + 1); }
+  iterator erase(const_iterator first, const_iterator last);
+  size_type erase(std::string_view key);
+
+  void swap(Struct &other);
+
+  /**
+   * @return Returns the number of heap bytes used by the struct itself and its keys, not counting the Variables of the
+   * elements.
+   */
+  size_t memoryUsage() const;
+
+  bool operator==(const Struct &rhs) const { return _elements == rhs._elements; }
+  bool operator!=(const Struct &rhs) const { return _elements != rhs._elements; }
+
+  /**
+   * The hash function used for keys by the hash index. Also used by Variable::hash().
+   */
+  static uint32_t hashKey(std::string_view key);
+
+  /**
+   * Makes the struct read-only. Call Variable::freeze() instead of calling this directly.
+   */
+  void freeze() { _frozen = true; }
+  bool frozen() const { return _frozen; }
+ private:
+  struct Slot {
+    uint32_t hash;
+    uint32_t index;
+  };
+
+  static constexpr uint32_t _emptySlot = UINT32_MAX;
+  static constexpr size_type _hashThreshold = 16;
+  static constexpr uint32_t _maxProbeLength = 32;
+
+  std::vector<value_type> _elements;
+
+  /**
+   * Hash index into _elements with a power of two number of slots. Empty while the struct is smaller than
+   * _hashThreshold.
+   */
+  std::vector<Slot> _slots;
+
+  /**
+   * Set when colliding keys exceeded _maxProbeLength. The index is not rebuilt until the struct is cleared or shrinks
+   * below _hashThreshold.
+   */
+  bool _indexDisabled = false;
+  bool _frozen = false;
+
+  void checkWritable() const {
+    if (_frozen) throwFrozen();
+  }
+  [[noreturn]] static void throwFrozen();
+
+  size_type lowerBoundIndex(std::string_view key) const;
+
+  /**
+   * @return Returns the index of the element or size() when the key doesn't exist.
+   */
+  size_type findIndex(std::string_view key) const { return _slots.empty() ? scanIndex(key) : findIndex(key, hashKey(key)); }
+  size_type findIndex(std::string_view key, uint32_t hash) const;
+
+  /**
+   * Looks the key up without the hash index.
+   */
+  size_type scanIndex(std::string_view key) const;
+  iterator insertAt(size_type index, value_type &&value);
+
+  /**
+   * Sorts the unsorted elements from "sortedSize" on into the sorted elements before them, removes duplicates and
+   * updates the hash index.
+   */
+  void mergeAppended(size_type sortedSize);
+
+  /**
+   * @return Returns false when no empty slot was found within _maxProbeLength slots.
+   */
+  bool insertSlot(uint32_t hash, uint32_t index);
+  void buildIndex();
+  void disableIndex();
+};
+
+template<typename... Args>
+std::pair<Struct::iterator, bool> Struct::try_emplace(const std::string &key, Args &&... args) {
+  checkWritable();
+  auto index = lowerBoundIndex(key);
+  if (index < _elements.size() && _elements[index].first == key) return std::make_pair(_elements.begin() + index, false);
+  return std::make_pair(insertAt(index, value_type(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...))), true);
+}
+
+template<typename... Args>
+std::pair<Struct::iterator, bool> Struct::try_emplace(std::string &&key, Args &&... args) {
+  checkWritable();
+  auto index = lowerBoundIndex(key);
+  if (index < _elements.size() && _elements[index].first == key) return std::make_pair(_elements.begin() + index, false);
+  return std::make_pair(insertAt(index, value_type(std::piecewise_construct, std::forward_as_tuple(std::move(key)), std::forward_as_tuple(std::forward<Args>(args)...))), true);
+}
+
+/**
+ * Builds structs from elements arriving in arbitrary key order, e.g. from untrusted input, in O(n log n). Elements
+ * arriving in key order are appended to the struct directly. All others are collected and inserted in one go by end().
+ * Builds can be nested: Call begin() when starting a struct and pass the returned mark to add() and end() of that
+ * struct. When building fails, call discard() with the mark of the outermost struct.
+ */
+class StructBuilder {
+ public:
+  size_t begin() const { return _pending.size(); }
+  void add(Struct &structValue, size_t mark, std::string &&key, PVariable &&value);
+  void end(Struct &structValue, size_t mark);
+  void discard(size_t mark) { _pending.erase(_pending.begin() + mark, _pending.end()); }
+ private:
+  std::vector<Struct::value_type> _pending;
+};
+
+inline void swap(Struct &lhs, Struct &rhs) {
+  lhs.swap(rhs);
+}
+
+}
+
+#endif //LIBHOMEGEAR_NODE_STRUCT_H
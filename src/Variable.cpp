@@ -32,38 +32,63 @@
 #include "HelperFunctions.h"
 #include "Math.h"
 #include "JsonDecoder.h"
+#include "VariableIterator.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
 
 namespace Flows {
 
 Variable::Variable() {
   type = VariableType::tVoid;
-  arrayValue = std::make_shared<Array>();
-  structValue = std::make_shared<Struct>();
 }
 
 Variable::Variable(Variable const &rhs) {
-  errorStruct = rhs.errorStruct;
-  type = rhs.type;
-  stringValue = rhs.stringValue;
-  integerValue = rhs.integerValue;
-  integerValue64 = rhs.integerValue64;
-  floatValue = rhs.floatValue;
-  booleanValue = rhs.booleanValue;
-  binaryValue = rhs.binaryValue;
-  arrayValue = std::make_shared<Array>();
-  for (Array::const_iterator i = rhs.arrayValue->begin(); i != rhs.arrayValue->end(); ++i) {
-    PVariable lhs = std::make_shared<Variable>();
-    *lhs = *(*i);
-    arrayValue->push_back(lhs);
-  }
-  structValue = std::make_shared<Struct>();
-  for (Struct::const_iterator i = rhs.structValue->begin(); i != rhs.structValue->end(); ++i) {
-    PVariable lhs = std::make_shared<Variable>();
-    *lhs = *(i->second);
-    structValue->insert(std::pair<std::string, PVariable>(i->first, lhs));
+  //Copy with an explicit stack of (source, destination) pairs, so deep trees can't overflow the call stack.
+  std::vector<std::pair<const Variable *, Variable *>> stack;
+  stack.emplace_back(&rhs, this);
+  while (!stack.empty()) {
+    auto source = stack.back().first;
+    auto destination = stack.back().second;
+    stack.pop_back();
+    destination->errorStruct = source->errorStruct;
+    destination->type = source->type;
+    destination->stringValue = source->stringValue;
+    destination->integerValue = source->integerValue;
+    destination->integerValue64 = source->integerValue64;
+    destination->floatValue = source->floatValue;
+    destination->booleanValue = source->booleanValue;
+    destination->binaryValue = source->binaryValue;
+    if (!source->arrayValue->empty()) {
+      destination->arrayValue->reserve(source->arrayValue->size());
+      for (auto &element : *source->arrayValue) {
+        if (!element) {
+          destination->arrayValue->emplace_back();
+          continue;
+        }
+        auto copy = Pool::create<Variable>();
+        destination->arrayValue->push_back(copy);
+        stack.emplace_back(element.get(), copy.get());
+      }
+    }
+    for (auto &element : *source->structValue) {
+      if (!element.second) {
+        destination->structValue->emplace(element.first, PVariable());
+        continue;
+      }
+      auto copy = Pool::create<Variable>();
+      destination->structValue->emplace(element.first, copy);
+      stack.emplace_back(element.second.get(), copy.get());
+    }
   }
 }
 
+Variable::Variable(Variable &&rhs) : Variable() {
+  *this = std::move(rhs);
+}
+
 Variable::Variable(VariableType variableType) : Variable() {
   type = variableType;
   if (type == VariableType::tVariant) type = VariableType::tVoid;
@@ -112,9 +137,13 @@ Variable::Variable(uint64_t integer) : Variable() {
 Variable::Variable(const std::string &string) : Variable() {
   type = VariableType::tString;
   stringValue = string;
-  integerValue64 = Math::getNumber64(stringValue);
-  integerValue = (int32_t)integerValue64;
-  booleanValue = !stringValue.empty() && stringValue != "0" && stringValue != "false" && stringValue != "f";
+  setValuesFromString();
+}
+
+Variable::Variable(std::string &&string) : Variable() {
+  type = VariableType::tString;
+  stringValue = std::move(string);
+  setValuesFromString();
 }
 
 Variable::Variable(const char *string) : Variable(std::string(string)) {
@@ -140,11 +169,16 @@ Variable::Variable(const PArray &arrayVal) : Variable() {
   arrayValue = arrayVal;
 }
 
+Variable::Variable(PArray &&arrayVal) : Variable() {
+  type = VariableType::tArray;
+  arrayValue = std::move(arrayVal);
+}
+
 Variable::Variable(const std::vector<std::string> &arrayVal) : Variable() {
   type = VariableType::tArray;
   arrayValue->reserve(arrayVal.size());
   for (auto &element : arrayVal) {
-    arrayValue->push_back(std::make_shared<Variable>(element));
+    arrayValue->push_back(Pool::create<Variable>(element));
   }
 }
 
@@ -153,11 +187,21 @@ Variable::Variable(const PStruct &structVal) : Variable() {
   structValue = structVal;
 }
 
+Variable::Variable(PStruct &&structVal) : Variable() {
+  type = VariableType::tStruct;
+  structValue = std::move(structVal);
+}
+
 Variable::Variable(const std::vector<uint8_t> &binaryVal) : Variable() {
   type = VariableType::tBinary;
   binaryValue = binaryVal;
 }
 
+Variable::Variable(std::vector<uint8_t> &&binaryVal) : Variable() {
+  type = VariableType::tBinary;
+  binaryValue = std::move(binaryVal);
+}
+
 Variable::Variable(const uint8_t *binaryVal, size_t binaryValSize) : Variable() {
   type = VariableType::tBinary;
   binaryValue = std::vector<uint8_t>(binaryVal, binaryVal + binaryValSize);
@@ -193,73 +237,597 @@ Variable::Variable(const std::string &typeString, const std::string &jsonValue)
     stringValue = jsonValue;
   } else if (typeString == "array" || typeString == "struct") {
     auto value = JsonDecoder::decode(jsonValue);
-    *this = *value;
+    *this = std::move(*value);
   }
 }
 
+Variable::~Variable() {
+  //Releasing the containers recursively would overflow the stack for deep trees. Up to maxRecursionDepth they are
+  //released recursively. Below that, elements with elements of their own are moved to a list, which the outermost
+  //destructor works through, so every element is released at a depth of at most maxRecursionDepth.
+  thread_local uint32_t depth = 0;
+  thread_local std::vector<PVariable> *deferred = nullptr;
+  if (!arrayValue._container && !structValue._container) return;
+  if (depth == maxRecursionDepth) {
+    deferNestedElements(*deferred);
+    return;
+  }
+  std::vector<PVariable> list;
+  if (depth == 0) deferred = &list;
+  depth++;
+  arrayValue._container.reset();
+  structValue._container.reset();
+  depth--;
+  if (depth != 0) return;
+  while (!list.empty()) {
+    auto element = std::move(list.back());
+    list.pop_back();
+    depth++;
+    element.reset();
+    depth--;
+  }
+  deferred = nullptr;
+}
+
+void Variable::deferNestedElements(std::vector<PVariable> &deferred) {
+  //Shared containers and elements are not released together with this Variable.
+  auto defer = [&](PVariable &element) {
+    if (element && element.use_count() == 1 && (element->arrayValue._container || element->structValue._container)) deferred.push_back(std::move(element));
+  };
+  if (arrayValue._container && arrayValue._container.use_count() == 1) {
+    for (auto &element : *arrayValue._container) {
+      defer(element);
+    }
+  }
+  if (structValue._container && structValue._container.use_count() == 1) {
+    for (auto &element : *structValue._container) {
+      defer(element.second);
+    }
+  }
+}
+
+void Variable::setValuesFromString() {
+  //Most strings are text. Math::getNumber64() returns 0 unless optional whitespace and sign are followed by a digit
+  //(a hex digit when the string contains an "x"), so reject everything else without scanning the string for the "x".
+  size_t pos = 0;
+  while (pos < stringValue.size() && std::isspace((unsigned char)stringValue[pos])) pos++;
+  if (pos < stringValue.size() && (stringValue[pos] == '-' || stringValue[pos] == '+')) pos++;
+  if (pos < stringValue.size() && std::isxdigit((unsigned char)stringValue[pos])) {
+    integerValue64 = Math::getNumber64(stringValue);
+  } else integerValue64 = 0;
+  integerValue = (int32_t)integerValue64;
+  booleanValue = !stringValue.empty() && stringValue != "0" && stringValue != "false" && stringValue != "f";
+}
+
 std::shared_ptr<Variable> Variable::createError(int32_t faultCode, std::string faultString) {
-  std::shared_ptr<Variable> error = std::make_shared<Variable>(VariableType::tStruct);
+  std::shared_ptr<Variable> error = Pool::create<Variable>(VariableType::tStruct);
   error->errorStruct = true;
-  error->structValue->insert(StructElement("faultCode", std::make_shared<Variable>(faultCode)));
-  error->structValue->insert(StructElement("faultString", std::make_shared<Variable>(faultString)));
+  error->structValue->insert(StructElement("faultCode", Pool::create<Variable>(faultCode)));
+  error->structValue->insert(StructElement("faultString", Pool::create<Variable>(faultString)));
   return error;
 }
 
+PVariable Variable::createCopyOnWrite(const Variable &rhs) {
+  auto copy = Pool::create<Variable>();
+  copy->errorStruct = rhs.errorStruct;
+  copy->type = rhs.type;
+  copy->stringValue = rhs.stringValue;
+  copy->integerValue = rhs.integerValue;
+  copy->integerValue64 = rhs.integerValue64;
+  copy->floatValue = rhs.floatValue;
+  copy->booleanValue = rhs.booleanValue;
+  copy->binaryValue = rhs.binaryValue;
+  copy->arrayValue.share(rhs.arrayValue);
+  copy->structValue.share(rhs.structValue);
+  return copy;
+}
+
+Variable::Variable(const std::vector<int64_t> &integers) : Variable() {
+  type = VariableType::tInteger64Array;
+  binaryValue.resize(integers.size() * sizeof(int64_t));
+  if (!integers.empty()) std::memcpy(binaryValue.data(), integers.data(), binaryValue.size());
+}
+
+Variable::Variable(const std::vector<double> &floats) : Variable() {
+  type = VariableType::tFloatArray;
+  binaryValue.resize(floats.size() * sizeof(double));
+  if (!floats.empty()) std::memcpy(binaryValue.data(), floats.data(), binaryValue.size());
+}
+
+bool Variable::pack() {
+  if (type != VariableType::tArray) return false;
+  const Variable &self = *this;
+  bool isFloat = false;
+  for (auto &element : *self.arrayValue) {
+    if (!element) return false;
+    if (element->type == VariableType::tFloat) isFloat = true;
+    else if (element->type != VariableType::tInteger && element->type != VariableType::tInteger64) return false;
+  }
+
+  std::vector<uint8_t> packed(self.arrayValue->size() * 8);
+  auto integers = reinterpret_cast<int64_t *>(packed.data());
+  auto floats = reinterpret_cast<double *>(packed.data());
+  for (size_t i = 0; i < self.arrayValue->size(); i++) {
+    auto &element = *self.arrayValue->at(i);
+    int64_t integer = element.type == VariableType::tInteger ? element.integerValue : element.integerValue64;
+    if (isFloat) floats[i] = element.type == VariableType::tFloat ? element.floatValue : (double)integer;
+    else integers[i] = integer;
+  }
+
+  type = isFloat ? VariableType::tFloatArray : VariableType::tInteger64Array;
+  binaryValue = std::move(packed);
+  arrayValue.reset();
+  return true;
+}
+
+void Variable::unpack() {
+  if (!isPackedArray()) return;
+  arrayValue = toArray();
+  type = VariableType::tArray;
+  binaryValue.clear();
+  binaryValue.shrink_to_fit();
+}
+
+PArray Variable::toArray() const {
+  if (!isPackedArray()) return Pool::create<Array>(*arrayValue);
+  auto array = Pool::create<Array>();
+  auto size = packedArraySize();
+  array->reserve(size);
+  if (type == VariableType::tFloatArray) {
+    auto floats = packedFloats();
+    for (size_t i = 0; i < size; i++) {
+      array->emplace_back(Pool::create<Variable>(floats[i]));
+    }
+  } else {
+    auto integers = packedIntegers();
+    for (size_t i = 0; i < size; i++) {
+      if (integers[i] >= INT32_MIN && integers[i] <= INT32_MAX) array->emplace_back(Pool::create<Variable>((int32_t)integers[i]));
+      else array->emplace_back(Pool::create<Variable>(integers[i]));
+    }
+  }
+  return array;
+}
+
+void Variable::freeze() {
+  //Walk the tree with an explicit stack, so deep trees can't overflow the call stack. VariableIterator only reads, but
+  //elements shared with other trees have to be replaced on the way.
+  std::vector<Variable *> stack;
+  stack.push_back(this);
+  while (!stack.empty()) {
+    auto variable = stack.back();
+    stack.pop_back();
+    if (variable->_frozen) continue;
+    variable->_frozen = true;
+    //Elements shared copy-on-write with other trees are detached before freezing them, so freezing doesn't make the
+    //other trees read-only. Non-const access copies shared containers, unallocated ones are skipped.
+    if (variable->arrayValue.allocated()) {
+      auto &array = *variable->arrayValue;
+      bool shared = variable->arrayValue.sharesElements();
+      for (auto &element : array) {
+        if (!element || element->_frozen) continue;
+        detach(element, shared);
+        stack.push_back(element.get());
+      }
+    }
+    if (variable->structValue.allocated()) {
+      auto &structValue = *variable->structValue;
+      bool shared = variable->structValue.sharesElements();
+      for (auto &element : structValue) {
+        if (!element.second || element.second->_frozen) continue;
+        detach(element.second, shared);
+        stack.push_back(element.second.get());
+      }
+    }
+    variable->arrayValue.freeze();
+    variable->structValue.freeze();
+  }
+}
+
+void Variable::detach(PVariable &variable, bool shared) {
+  if (variable && (variable->_frozen || (shared && variable.use_count() > 1))) variable = createCopyOnWrite(*variable);
+}
+
 Variable &Variable::operator=(const Variable &rhs) {
   if (&rhs == this) return *this;
+  if (_frozen) throw FrozenVariableException("Assignment to a frozen Variable. Use Variable::detach() to get a writable copy.");
+  //Copy into fresh containers. Appending to the existing ones would modify containers that might be shared.
+  *this = Variable(rhs);
+  return *this;
+}
+
+Variable &Variable::operator=(Variable &&rhs) {
+  if (&rhs == this) return *this;
+  if (_frozen) throw FrozenVariableException("Assignment to a frozen Variable. Use Variable::detach() to get a writable copy.");
   errorStruct = rhs.errorStruct;
   type = rhs.type;
-  stringValue = rhs.stringValue;
   integerValue = rhs.integerValue;
   integerValue64 = rhs.integerValue64;
   floatValue = rhs.floatValue;
   booleanValue = rhs.booleanValue;
-  binaryValue = rhs.binaryValue;
-  for (Array::const_iterator i = rhs.arrayValue->begin(); i != rhs.arrayValue->end(); ++i) {
-    PVariable lhs = std::make_shared<Variable>();
-    *lhs = *(*i);
-    arrayValue->push_back(lhs);
-  }
-  for (Struct::const_iterator i = rhs.structValue->begin(); i != rhs.structValue->end(); ++i) {
-    PVariable lhs = std::make_shared<Variable>();
-    *lhs = *(i->second);
-    structValue->insert(std::pair<std::string, PVariable>(i->first, lhs));
+  if (rhs._frozen) {
+    stringValue = rhs.stringValue;
+    binaryValue = rhs.binaryValue;
+    arrayValue.share(rhs.arrayValue);
+    structValue.share(rhs.structValue);
+  } else {
+    stringValue = std::move(rhs.stringValue);
+    binaryValue = std::move(rhs.binaryValue);
+    arrayValue = std::move(rhs.arrayValue);
+    structValue = std::move(rhs.structValue);
   }
   return *this;
 }
 
-bool Variable::operator==(const Variable &rhs) {
+bool Variable::operator==(const Variable &rhs) const {
+  return equals(rhs, false, 0);
+}
+
+bool Variable::equivalent(const Variable &rhs) const {
+  return equals(rhs, true, 0);
+}
+
+bool Variable::equals(const Variable &rhs, bool voidsEqual, uint32_t depth) const {
+  if (type != rhs.type) return false;
+  if (type != VariableType::tArray && type != VariableType::tStruct) return valueEquals(rhs, voidsEqual);
+  if (depth == maxRecursionDepth) return equalsIterative(rhs, voidsEqual);
+
+  if (type == VariableType::tArray) {
+    if (arrayValue->size() != rhs.arrayValue->size()) return false;
+    for (std::pair<Array::const_iterator, Array::const_iterator> i(arrayValue->begin(), rhs.arrayValue->begin()); i.first != arrayValue->end(); ++i.first, ++i.second) {
+      if (!*i.first || !*i.second) {
+        if (*i.first != *i.second) return false;
+      } else if (!(*i.first)->equals(**i.second, voidsEqual, depth + 1)) return false;
+    }
+  } else {
+    if (structValue->size() != rhs.structValue->size()) return false;
+    //Both structs are sorted by key, so equal structs have the same keys at the same positions.
+    for (std::pair<Struct::const_iterator, Struct::const_iterator> i(structValue->begin(), rhs.structValue->begin()); i.first != structValue->end(); ++i.first, ++i.second) {
+      if (i.first->first != i.second->first) return false;
+      if (!i.first->second || !i.second->second) {
+        if (i.first->second != i.second->second) return false;
+      } else if (!i.first->second->equals(*i.second->second, voidsEqual, depth + 1)) return false;
+    }
+  }
+  return true;
+}
+
+bool Variable::equalsIterative(const Variable &rhs, bool voidsEqual) const {
+  //Walk both trees in lockstep. Equal trees produce the same events in the same order.
+  VariableIterator iterator(*this, 0);
+  VariableIterator rhsIterator(rhs, 0);
+  while (iterator.next()) {
+    rhsIterator.next();
+    auto event = iterator.event();
+    if (event != rhsIterator.event()) return false;
+    if (event == VariableIterator::Event::endArray || event == VariableIterator::Event::endStruct) continue;
+    if (iterator.inStruct() && iterator.key() != rhsIterator.key()) return false;
+    auto variable = iterator.variable();
+    auto rhsVariable = rhsIterator.variable();
+    if (event == VariableIterator::Event::beginArray) {
+      if (variable->arrayValue->size() != rhsVariable->arrayValue->size()) return false;
+    } else if (event == VariableIterator::Event::beginStruct) {
+      if (variable->structValue->size() != rhsVariable->structValue->size()) return false;
+    } else if (!variable || !rhsVariable) {
+      if (variable != rhsVariable) return false;
+    } else if (!variable->valueEquals(*rhsVariable, voidsEqual)) return false;
+  }
+  return true;
+}
+bool Variable::valueEquals(const Variable &rhs, bool voidsEqual) const {
   if (type != rhs.type) return false;
   if (type == VariableType::tBoolean) return booleanValue == rhs.booleanValue;
   else if (type == VariableType::tInteger) return integerValue == rhs.integerValue;
   else if (type == VariableType::tInteger64) return integerValue64 == rhs.integerValue64;
   else if (type == VariableType::tString) return stringValue == rhs.stringValue;
   else if (type == VariableType::tFloat) return floatValue == rhs.floatValue;
-  else if (type == VariableType::tArray) {
-    if (arrayValue->size() != rhs.arrayValue->size()) return false;
-    for (std::pair<Array::iterator, Array::iterator> i(arrayValue->begin(), rhs.arrayValue->begin()); i.first != arrayValue->end(); ++i.first, ++i.second) {
-      if (**(i.first) != **(i.second)) return false;
+  else if (type == VariableType::tBase64) return stringValue == rhs.stringValue;
+  else if (type == VariableType::tBinary || type == VariableType::tInteger64Array) return binaryValue == rhs.binaryValue;
+  else if (type == VariableType::tFloatArray) {
+    if (binaryValue.size() != rhs.binaryValue.size()) return false;
+    auto floats = packedFloats();
+    auto rhsFloats = rhs.packedFloats();
+    for (size_t i = 0; i < packedArraySize(); i++) {
+      if (floats[i] != rhsFloats[i]) return false;
     }
     return true;
-  } else if (type == VariableType::tStruct) {
-    if (structValue->size() != rhs.structValue->size()) return false;
-    for (auto &element : *structValue) {
-      auto rhsIterator = rhs.structValue->find(element.first);
-      if (rhsIterator == rhs.structValue->end() || *element.second != *rhsIterator->second) return false;
+  } else if (type == VariableType::tVoid) return voidsEqual;
+  return false;
+}
+
+size_t Variable::hash() const {
+  if (type != VariableType::tArray && type != VariableType::tStruct) return valueHash();
+  size_t result = 0;
+  hash(result, 0);
+  return result;
+}
+
+void Variable::hash(size_t &result, uint32_t depth) const {
+  //Arrays and structs are hashed as the sequence of VariableIterator events, so the recursive and the iterative
+  //variant produce the same result.
+  if (depth == maxRecursionDepth) {
+    hashIterative(result);
+    return;
+  }
+  if (type == VariableType::tArray) {
+    result = hashCombine(result, (size_t)VariableIterator::Event::beginArray + 1);
+    for (auto &element : *arrayValue) {
+      if (!element) result = hashCombine(result, 0);
+      else if (element->type == VariableType::tArray || element->type == VariableType::tStruct) element->hash(result, depth + 1);
+      else result = hashCombine(result, element->valueHash());
     }
-    return true;
-  } else if (type == VariableType::tBase64) return stringValue == rhs.stringValue;
-  else if (type == VariableType::tBinary) {
-    if (binaryValue.size() != rhs.binaryValue.size()) return false;
-    if (binaryValue.empty()) return true;
-    uint8_t *i = &binaryValue[0];
-    uint8_t *j = (uint8_t *)&rhs.binaryValue[0];
-    for (; i < &binaryValue[0] + binaryValue.size(); i++, j++) {
-      if (*i != *j) return false;
+    result = hashCombine(result, (size_t)VariableIterator::Event::endArray + 1);
+  } else {
+    result = hashCombine(result, (size_t)VariableIterator::Event::beginStruct + 1);
+    //Structs are sorted by key, so equal structs are hashed in the same order.
+    for (auto i = structValue->begin(); i != structValue->end(); ++i) {
+      result = hashCombine(result, Struct::hashKey(i->first));
+      if (!i->second) result = hashCombine(result, 0);
+      else if (i->second->type == VariableType::tArray || i->second->type == VariableType::tStruct) i->second->hash(result, depth + 1);
+      else result = hashCombine(result, i->second->valueHash());
     }
-    return true;
+    result = hashCombine(result, (size_t)VariableIterator::Event::endStruct + 1);
   }
-  return false;
+}
+
+void Variable::hashIterative(size_t &result) const {
+  VariableIterator iterator(*this, 0);
+  while (iterator.next()) {
+    auto event = iterator.event();
+    if (iterator.inStruct() && event != VariableIterator::Event::endArray && event != VariableIterator::Event::endStruct) {
+      result = hashCombine(result, Struct::hashKey(iterator.key()));
+    }
+    if (event == VariableIterator::Event::value) result = hashCombine(result, iterator.variable() ? iterator.variable()->valueHash() : 0);
+    else result = hashCombine(result, (size_t)event + 1);
+  }
+}
+size_t Variable::valueHash() const {
+  size_t result = std::hash<int32_t>()((int32_t)type);
+  switch (type) {
+    case VariableType::tBoolean: return hashCombine(result, booleanValue);
+    case VariableType::tInteger: return hashCombine(result, std::hash<int32_t>()(integerValue));
+    case VariableType::tInteger64: return hashCombine(result, std::hash<int64_t>()(integerValue64));
+    case VariableType::tFloat: return hashCombine(result, floatValue == 0 ? 0 : std::hash<double>()(floatValue)); //0.0 == -0.0
+    case VariableType::tString:
+    case VariableType::tBase64: return hashCombine(result, std::hash<std::string>()(stringValue));
+    case VariableType::tFloatArray:
+      for (size_t i = 0; i < packedArraySize(); i++) {
+        auto value = packedFloats()[i];
+        result = hashCombine(result, value == 0 ? 0 : std::hash<double>()(value));
+      }
+      return result;
+    case VariableType::tInteger64Array:
+    case VariableType::tBinary: return hashCombine(result, std::hash<std::string_view>()(std::string_view((const char *)binaryValue.data(), binaryValue.size())));
+    default: return result;
+  }
+}
+
+size_t Variable::memoryUsage() const {
+  size_t result = sizeof(Variable) + ownMemoryUsage();
+  if (type != VariableType::tArray && type != VariableType::tStruct) return result;
+  VariableIterator iterator(*this, 0);
+  iterator.next();
+  while (iterator.next()) {
+    auto event = iterator.event();
+    if (event == VariableIterator::Event::endArray || event == VariableIterator::Event::endStruct || !iterator.variable()) continue;
+    result += Pool::sharedSize<Variable>() + iterator.variable()->ownMemoryUsage();
+  }
+  return result;
+}
+
+size_t Variable::ownMemoryUsage() const {
+  size_t result = HelperFunctions::getHeapSize(stringValue) + binaryValue.capacity();
+  if (arrayValue.allocated()) result += Pool::sharedSize<Array>() + arrayValue->capacity() * sizeof(PVariable);
+  if (structValue.allocated()) result += Pool::sharedSize<Struct>() + structValue->memoryUsage();
+  return result;
+}
+
+size_t Variable::estimateMemoryUsage() const {
+  return sizeof(Variable) + estimateMemoryUsage(0);
+}
+
+size_t Variable::estimateMemoryUsage(uint32_t depth) const {
+  constexpr size_t sampleSize = 8;
+  size_t result = stringValue.size() + binaryValue.size();
+  if (type == VariableType::tArray && arrayValue.allocated()) {
+    auto &array = *arrayValue;
+    result += Pool::sharedSize<Array>() + array.size() * (sizeof(PVariable) + Pool::sharedSize<Variable>());
+    if (array.empty() || depth == maxRecursionDepth) return result;
+    size_t samples = std::min(array.size(), sampleSize);
+    size_t sampled = 0;
+    for (size_t i = 0; i < samples; i++) {
+      auto &element = array[i * array.size() / samples];
+      if (element) sampled += element->estimateMemoryUsage(depth + 1);
+    }
+    result += sampled * array.size() / samples;
+  } else if (type == VariableType::tStruct && structValue.allocated()) {
+    auto &structValue = *this->structValue;
+    result += Pool::sharedSize<Struct>() + structValue.size() * (sizeof(Struct::value_type) + Pool::sharedSize<Variable>());
+    if (structValue.empty() || depth == maxRecursionDepth) return result;
+    size_t samples = std::min(structValue.size(), sampleSize);
+    size_t sampled = 0;
+    for (size_t i = 0; i < samples; i++) {
+      auto &element = *(structValue.begin() + i * structValue.size() / samples);
+      sampled += element.first.size();
+      if (element.second) sampled += element.second->estimateMemoryUsage(depth + 1);
+    }
+    result += sampled * structValue.size() / samples;
+  }
+  return result;
+}
+
+PVariable Variable::diff(const PVariable &from, const PVariable &to) {
+  auto patch = Pool::create<Variable>(VariableType::tArray);
+  std::string path;
+  diff(from ? from : Pool::create<Variable>(), to ? to : Pool::create<Variable>(), path, *patch->arrayValue, 0);
+  return patch;
+}
+
+void Variable::diff(const PVariable &from, const PVariable &to, std::string &path, Array &patch, uint32_t depth) {
+  if (from == to) return;
+  if (from->type != to->type || (from->type != VariableType::tArray && from->type != VariableType::tStruct) || depth == maxRecursionDepth) {
+    if (!from->equivalent(*to)) patch.push_back(createPatchOperation("replace", path, to));
+    return;
+  }
+
+  auto pathSize = path.size();
+  if (from->type == VariableType::tStruct) {
+    //Both structs are sorted by key, so they can be merged in one pass.
+    const Struct &fromStruct = from->structValue.view();
+    const Struct &toStruct = to->structValue.view();
+    auto fromIterator = fromStruct.begin();
+    auto toIterator = toStruct.begin();
+    while (fromIterator != fromStruct.end() || toIterator != toStruct.end()) {
+      int32_t comparison;
+      if (fromIterator == fromStruct.end()) comparison = 1;
+      else if (toIterator == toStruct.end()) comparison = -1;
+      else comparison = fromIterator->first.compare(toIterator->first);
+      path.push_back('/');
+      path.append(escapePathToken(comparison <= 0 ? fromIterator->first : toIterator->first));
+      if (comparison < 0) {
+        patch.push_back(createPatchOperation("remove", path, PVariable()));
+        ++fromIterator;
+      } else if (comparison > 0) {
+        patch.push_back(createPatchOperation("add", path, toIterator->second));
+        ++toIterator;
+      } else {
+        if (!fromIterator->second || !toIterator->second) {
+          if (fromIterator->second != toIterator->second) patch.push_back(createPatchOperation("replace", path, toIterator->second));
+        } else diff(fromIterator->second, toIterator->second, path, patch, depth + 1);
+        ++fromIterator;
+        ++toIterator;
+      }
+      path.resize(pathSize);
+    }
+  } else {
+    const Array &fromArray = from->arrayValue.view();
+    const Array &toArray = to->arrayValue.view();
+    auto commonSize = std::min(fromArray.size(), toArray.size());
+    for (size_t i = 0; i < toArray.size(); i++) {
+      path.push_back('/');
+      path.append(std::to_string(i));
+      if (i >= commonSize) patch.push_back(createPatchOperation("add", path, toArray[i]));
+      else if (!fromArray[i] || !toArray[i]) {
+        if (fromArray[i] != toArray[i]) patch.push_back(createPatchOperation("replace", path, toArray[i]));
+      } else diff(fromArray[i], toArray[i], path, patch, depth + 1);
+      path.resize(pathSize);
+    }
+    //Remove from the back, so the indexes of the remaining elements stay valid.
+    for (size_t i = fromArray.size(); i > commonSize; i--) {
+      path.push_back('/');
+      path.append(std::to_string(i - 1));
+      patch.push_back(createPatchOperation("remove", path, PVariable()));
+      path.resize(pathSize);
+    }
+  }
+}
+
+PVariable Variable::createPatchOperation(const char *operation, const std::string &path, const PVariable &value) {
+  auto patchOperation = Pool::create<Variable>(VariableType::tStruct);
+  patchOperation->structValue->emplace("op", Pool::create<Variable>(std::string(operation)));
+  patchOperation->structValue->emplace("path", Pool::create<Variable>(path));
+  if (std::strcmp(operation, "remove") != 0) patchOperation->structValue->emplace("value", value ? createCopyOnWrite(*value) : Pool::create<Variable>());
+  return patchOperation;
+}
+
+std::string Variable::escapePathToken(const std::string &token) {
+  if (token.find_first_of("~/") == std::string::npos) return token;
+  std::string result;
+  result.reserve(token.size() + 2);
+  for (auto c : token) {
+    if (c == '~') result.append("~0");
+    else if (c == '/') result.append("~1");
+    else result.push_back(c);
+  }
+  return result;
+}
+
+bool Variable::apply(const PVariable &patch) {
+  if (!patch || patch->type != VariableType::tArray || _frozen) return false;
+  for (auto &patchOperation : patch->arrayValue.view()) {
+    if (!patchOperation || patchOperation->type != VariableType::tStruct) return false;
+    const Struct &operationStruct = patchOperation->structValue.view();
+    auto operationIterator = operationStruct.find("op");
+    auto pathIterator = operationStruct.find("path");
+    auto valueIterator = operationStruct.find("value");
+    if (operationIterator == operationStruct.end() || !operationIterator->second || pathIterator == operationStruct.end() || !pathIterator->second) return false;
+    auto &operation = operationIterator->second->stringValue;
+    bool remove = operation == "remove";
+    bool add = operation == "add";
+    if (!remove && !add && operation != "replace") return false;
+    PVariable value;
+    if (!remove) {
+      if (valueIterator == operationStruct.end()) return false;
+      value = valueIterator->second ? createCopyOnWrite(*valueIterator->second) : Pool::create<Variable>();
+    }
+
+    //Split the JSON pointer into its unescaped tokens.
+    auto &path = pathIterator->second->stringValue;
+    if (!path.empty() && path.front() != '/') return false;
+    std::vector<std::string> tokens;
+    for (size_t position = 0; position < path.size();) {
+      auto end = path.find('/', position + 1);
+      if (end == std::string::npos) end = path.size();
+      std::string token = path.substr(position + 1, end - position - 1);
+      for (auto tildePosition = token.find('~'); tildePosition != std::string::npos; tildePosition = token.find('~', tildePosition + 1)) {
+        if (tildePosition + 1 >= token.size() || (token[tildePosition + 1] != '0' && token[tildePosition + 1] != '1')) return false;
+        token.replace(tildePosition, 2, token[tildePosition + 1] == '0' ? "~" : "/");
+      }
+      tokens.emplace_back(std::move(token));
+      position = end;
+    }
+
+    if (tokens.empty()) {
+      if (remove) return false;
+      *this = std::move(*value);
+      continue;
+    }
+
+    //Non-const access on every level, so containers shared copy-on-write are copied along the path.
+    Variable *current = this;
+    for (size_t i = 0; i < tokens.size(); i++) {
+      auto &token = tokens[i];
+      bool last = i == tokens.size() - 1;
+      if (current->type == VariableType::tStruct) {
+        auto elementIterator = current->structValue->find(token);
+        if (last) {
+          if (add) current->structValue->insert_or_assign(token, value);
+          else if (elementIterator == current->structValue->end()) return false;
+          else if (remove) current->structValue->erase(elementIterator);
+          else elementIterator->second = value;
+        } else {
+          if (elementIterator == current->structValue->end() || !elementIterator->second) return false;
+          Variable::detach(elementIterator->second, current->structValue.sharesElements());
+          current = elementIterator->second.get();
+        }
+      } else if (current->type == VariableType::tArray) {
+        auto &array = *current->arrayValue;
+        if (last && add && token == "-") {
+          array.push_back(value);
+          break;
+        }
+        //Digits only without leading zeros (RFC 6901). Indexes that don't fit size_t fail, so they can't wrap or become 0.
+        if (token.size() > 1 && token.front() == '0') return false;
+        size_t index = 0;
+        auto parseResult = std::from_chars(token.data(), token.data() + token.size(), index);
+        if (parseResult.ec != std::errc() || parseResult.ptr != token.data() + token.size()) return false;
+        if (last) {
+          if (add && index <= array.size()) array.insert(array.begin() + index, value);
+          else if (index >= array.size()) return false;
+          else if (remove) array.erase(array.begin() + index);
+          else array[index] = value;
+        } else {
+          if (index >= array.size() || !array[index]) return false;
+          Variable::detach(array[index], current->arrayValue.sharesElements());
+          current = array[index].get();
+        }
+      } else return false;
+    }
+  }
+  return true;
+}
+
+size_t Variable::hashCombine(size_t seed, size_t value) {
+  return seed ^ (value + (size_t)0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
 }
 
 bool Variable::operator<(const Variable &rhs) {
@@ -269,9 +837,9 @@ bool Variable::operator<(const Variable &rhs) {
   else if (type == VariableType::tString) return stringValue < rhs.stringValue;
   else if (type == VariableType::tFloat) return floatValue < rhs.floatValue;
   else if (type == VariableType::tArray) {
-    if (arrayValue->size() < rhs.arrayValue->size()) return true; else return false;
+    if (arrayValue.view().size() < rhs.arrayValue.view().size()) return true; else return false;
   } else if (type == VariableType::tStruct) {
-    if (structValue->size() < rhs.structValue->size()) return true; else return false;
+    if (structValue.view().size() < rhs.structValue.view().size()) return true; else return false;
   } else if (type == VariableType::tBase64) return stringValue < rhs.stringValue;
   return false;
 }
@@ -283,9 +851,9 @@ bool Variable::operator<=(const Variable &rhs) {
   else if (type == VariableType::tString) return stringValue <= rhs.stringValue;
   else if (type == VariableType::tFloat) return floatValue <= rhs.floatValue;
   else if (type == VariableType::tArray) {
-    if (arrayValue->size() <= rhs.arrayValue->size()) return true; else return false;
+    if (arrayValue.view().size() <= rhs.arrayValue.view().size()) return true; else return false;
   } else if (type == VariableType::tStruct) {
-    if (structValue->size() <= rhs.structValue->size()) return true; else return false;
+    if (structValue.view().size() <= rhs.structValue.view().size()) return true; else return false;
   } else if (type == VariableType::tBase64) return stringValue <= rhs.stringValue;
   return false;
 }
@@ -297,9 +865,9 @@ bool Variable::operator>(const Variable &rhs) {
   else if (type == VariableType::tString) return stringValue > rhs.stringValue;
   else if (type == VariableType::tFloat) return floatValue > rhs.floatValue;
   else if (type == VariableType::tArray) {
-    if (arrayValue->size() > rhs.arrayValue->size()) return true; else return false;
+    if (arrayValue.view().size() > rhs.arrayValue.view().size()) return true; else return false;
   } else if (type == VariableType::tStruct) {
-    if (structValue->size() > rhs.structValue->size()) return true; else return false;
+    if (structValue.view().size() > rhs.structValue.view().size()) return true; else return false;
   } else if (type == VariableType::tBase64) return stringValue > rhs.stringValue;
   return false;
 }
@@ -311,14 +879,14 @@ bool Variable::operator>=(const Variable &rhs) {
   else if (type == VariableType::tString) return stringValue >= rhs.stringValue;
   else if (type == VariableType::tFloat) return floatValue >= rhs.floatValue;
   else if (type == VariableType::tArray) {
-    if (arrayValue->size() >= rhs.arrayValue->size()) return true; else return false;
+    if (arrayValue.view().size() >= rhs.arrayValue.view().size()) return true; else return false;
   } else if (type == VariableType::tStruct) {
-    if (structValue->size() >= rhs.structValue->size()) return true; else return false;
+    if (structValue.view().size() >= rhs.structValue.view().size()) return true; else return false;
   } else if (type == VariableType::tBase64) return stringValue >= rhs.stringValue;
   return false;
 }
 
-bool Variable::operator!=(const Variable &rhs) {
+bool Variable::operator!=(const Variable &rhs) const {
   return !(operator==(rhs));
 }
 
@@ -330,7 +898,9 @@ Variable::operator bool_type() const {
         break;
       case VariableType::tBase64: result = !stringValue.empty();
         break;
-      case VariableType::tBinary: result = !binaryValue.empty();
+      case VariableType::tBinary:
+      case VariableType::tInteger64Array:
+      case VariableType::tFloatArray: result = !binaryValue.empty();
         break;
       case VariableType::tBoolean: break;
       case VariableType::tFloat: result = (bool)floatValue;
@@ -367,12 +937,10 @@ std::string Variable::print(bool stdout, bool stderr, bool oneLine) {
     result << "(String) " << stringValue << (oneLine ? " " : "\n");
   } else if (type == VariableType::tBase64) {
     result << "(Base64) " << stringValue << (oneLine ? " " : "\n");
-  } else if (type == VariableType::tArray) {
-    std::string indent("");
-    result << printArray(arrayValue, indent, false, oneLine);
-  } else if (type == VariableType::tStruct) {
-    std::string indent("");
-    result << printStruct(structValue, indent, false, oneLine);
+  } else if (type == VariableType::tArray || type == VariableType::tStruct) {
+    print(*this, "", false, oneLine, result);
+  } else if (isPackedArray()) {
+    print(Variable(toArray()), "", false, oneLine, result);
   } else if (type == VariableType::tBinary) {
     result << "(Binary) " << HelperFunctions::getHexString(binaryValue) << (oneLine ? " " : "\n");
   } else {
@@ -384,69 +952,64 @@ std::string Variable::print(bool stdout, bool stderr, bool oneLine) {
   return resultString;
 }
 
-std::string Variable::print(PVariable variable, std::string indent, bool ignoreIndentOnFirstLine, bool oneLine) {
-  if (!variable) return "";
-  std::ostringstream result;
-  if (variable->type == VariableType::tVoid) {
-    result << (ignoreIndentOnFirstLine ? "" : indent) << "(void)" << (oneLine ? " " : "\n");
-  } else if (variable->type == VariableType::tInteger) {
-    result << (ignoreIndentOnFirstLine ? "" : indent) << "(Integer) " << variable->integerValue << (oneLine ? " " : "\n");
-  } else if (variable->type == VariableType::tInteger64) {
-    result << (ignoreIndentOnFirstLine ? "" : indent) << "(Integer64) " << variable->integerValue64 << (oneLine ? " " : "\n");
-  } else if (variable->type == VariableType::tFloat) {
-    result << (ignoreIndentOnFirstLine ? "" : indent) << "(Float) " << variable->floatValue << (oneLine ? " " : "\n");
-  } else if (variable->type == VariableType::tBoolean) {
-    result << (ignoreIndentOnFirstLine ? "" : indent) << "(Boolean) " << variable->booleanValue << (oneLine ? " " : "\n");
-  } else if (variable->type == VariableType::tString) {
-    result << (ignoreIndentOnFirstLine ? "" : indent) << "(String) " << variable->stringValue << (oneLine ? " " : "\n");
-  } else if (type == VariableType::tBase64) {
-    result << (ignoreIndentOnFirstLine ? "" : indent) << "(Base64) " << variable->stringValue << (oneLine ? " " : "\n");
-  } else if (variable->type == VariableType::tArray) {
-    return printArray(variable->arrayValue, indent, ignoreIndentOnFirstLine, oneLine);
-  } else if (variable->type == VariableType::tStruct) {
-    return printStruct(variable->structValue, indent, ignoreIndentOnFirstLine, oneLine);
-  } else if (variable->type == VariableType::tBinary) {
-    result << (ignoreIndentOnFirstLine ? "" : indent) << "(Binary) " << HelperFunctions::getHexString(variable->binaryValue) << (oneLine ? " " : "\n");
-  } else {
-    result << (ignoreIndentOnFirstLine ? "" : indent) << "(Unknown)" << (oneLine ? " " : "\n");
-  }
-  return result.str();
-}
-
-std::string Variable::printArray(PArray array, std::string indent, bool ignoreIndentOnFirstLine, bool oneLine) {
-  std::ostringstream result;
-  result << (ignoreIndentOnFirstLine ? "" : indent) << "(Array length=" << array->size() << ")" << (oneLine ? " " : "\n" + indent) << "[" << (oneLine ? " " : "\n");
-  std::string currentIndent = indent;
-  if (!oneLine) {
-    currentIndent.push_back(' ');
-    currentIndent.push_back(' ');
-  }
-  for (auto &element : *array) {
-    result << print(element, currentIndent, false, oneLine);
-  }
-  result << (oneLine ? " ] " : indent + "]\n");
-  return result.str();
-}
+void Variable::print(const Variable &root, const std::string &indent, bool ignoreIndentOnFirstLine, bool oneLine, std::ostringstream &result) {
+  const char *lineEnd = oneLine ? " " : "\n";
+  std::string currentIndent;
+  VariableIterator iterator(root, 0);
+  while (iterator.next()) {
+    auto event = iterator.event();
+    auto variable = iterator.variable();
+    currentIndent = indent;
+    if (!oneLine) currentIndent.append(iterator.depth() * 2, ' ');
+    if (event == VariableIterator::Event::endArray) {
+      result << (oneLine ? " ] " : currentIndent + "]\n");
+      continue;
+    } else if (event == VariableIterator::Event::endStruct) {
+      result << (oneLine ? " } " : currentIndent + "}\n");
+      continue;
+    }
 
-std::string Variable::printStruct(PStruct tStruct, std::string indent, bool ignoreIndentOnFirstLine, bool oneLine) {
-  std::ostringstream result;
-  result << (ignoreIndentOnFirstLine ? "" : indent) << "(Struct length=" << tStruct->size() << ")" << (oneLine ? " " : "\n" + indent) << "{" << (oneLine ? " " : "\n");
-  std::string currentIndent = indent;
-  if (!oneLine) {
-    currentIndent.push_back(' ');
-    currentIndent.push_back(' ');
-  }
-  for (auto &element : *tStruct) {
-    result << currentIndent << "[" << element.first << "]" << " ";
-    result << print(element.second, currentIndent, true, oneLine);
+    //Struct elements are prefixed with their key on the same line.
+    bool ignoreIndent = iterator.inStruct() || (ignoreIndentOnFirstLine && iterator.depth() == 0);
+    if (iterator.inStruct()) result << currentIndent << "[" << iterator.key() << "]" << " ";
+    if (!variable) continue;
+    if (!ignoreIndent) result << currentIndent;
+    if (event == VariableIterator::Event::beginArray) {
+      result << "(Array length=" << variable->arrayValue->size() << ")" << (oneLine ? " " : "\n" + currentIndent) << "[" << lineEnd;
+    } else if (event == VariableIterator::Event::beginStruct) {
+      result << "(Struct length=" << variable->structValue->size() << ")" << (oneLine ? " " : "\n" + currentIndent) << "{" << lineEnd;
+    } else if (variable->type == VariableType::tVoid) {
+      result << "(void)" << lineEnd;
+    } else if (variable->type == VariableType::tInteger) {
+      result << "(Integer) " << variable->integerValue << lineEnd;
+    } else if (variable->type == VariableType::tInteger64) {
+      result << "(Integer64) " << variable->integerValue64 << lineEnd;
+    } else if (variable->type == VariableType::tFloat) {
+      result << "(Float) " << variable->floatValue << lineEnd;
+    } else if (variable->type == VariableType::tBoolean) {
+      result << "(Boolean) " << variable->booleanValue << lineEnd;
+    } else if (variable->type == VariableType::tString) {
+      result << "(String) " << variable->stringValue << lineEnd;
+    } else if (variable->type == VariableType::tBase64) {
+      result << "(Base64) " << variable->stringValue << lineEnd;
+    } else if (variable->isPackedArray()) {
+      //Packed arrays only contain numbers, so this doesn't nest any further.
+      std::ostringstream packedArray;
+      print(Variable(variable->toArray()), currentIndent, true, oneLine, packedArray);
+      result << packedArray.str();
+    } else if (variable->type == VariableType::tBinary) {
+      result << "(Binary) " << HelperFunctions::getHexString(variable->binaryValue) << lineEnd;
+    } else {
+      result << "(Unknown)" << lineEnd;
+    }
   }
-  result << (oneLine ? " } " : indent + "}\n");
-  return result.str();
 }
 
 std::string Variable::toString() {
   switch (type) {
     case VariableType::tArray: return "array";
+    case VariableType::tInteger64Array: return "array";
+    case VariableType::tFloatArray: return "array";
     case VariableType::tBase64: return stringValue;
     case VariableType::tBoolean: if (booleanValue) return "true"; else return "false";
     case VariableType::tFloat: return std::to_string(floatValue);
@@ -474,6 +1037,8 @@ std::string Variable::getTypeString(VariableType type) {
     case VariableType::tString: return "string";
     case VariableType::tStruct: return "struct";
     case VariableType::tBinary: return "binary";
+    case VariableType::tInteger64Array: return "i8array";
+    case VariableType::tFloatArray: return "doublearray";
     case VariableType::tVoid: return "void";
     case VariableType::tVariant: return "valuetype";
   }
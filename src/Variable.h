@@ -31,13 +31,20 @@
 #ifndef NODEVARIABLE_H_
 #define NODEVARIABLE_H_
 
+#include "FlowException.h"
+#include "Pool.h"
+#include "Struct.h"
+
+#include <atomic>
 #include <vector>
 #include <string>
 #include <memory>
 #include <iostream>
+#include <sstream>
 #include <map>
 #include <list>
 #include <cmath>
+#include <type_traits>
 
 namespace Flows {
 
@@ -53,43 +60,308 @@ enum class VariableType {
   tBase64 = 0x11,
   tBinary = 0xD0,
   tInteger64 = 0xD1,
+  tInteger64Array = 0xD2,
+  tFloatArray = 0xD3,
   tVariant = 0x1111,
 };
 
 class Variable;
 
+class FrozenVariableException : public FlowException {
+ public:
+  explicit FrozenVariableException(const std::string &message) : FlowException(message) {}
+};
+
 typedef std::shared_ptr<Variable> PVariable;
 typedef std::shared_ptr<PVariable> PPVariable;
 typedef std::pair<std::string, PVariable> StructElement;
-typedef std::map<std::string, PVariable> Struct;
-typedef std::shared_ptr<std::map<std::string, PVariable>> PStruct;
+typedef std::shared_ptr<Struct> PStruct;
 typedef std::vector<PVariable> Array;
 typedef std::shared_ptr<Array> PArray;
 typedef std::list<PVariable> List;
 typedef std::shared_ptr<List> PList;
 
+/**
+ * Holds the array or struct of a Variable and behaves like a std::shared_ptr to it. The container is only allocated on
+ * first non-const access, so Variables of other types don't cost a heap allocation for it. Const access to a container
+ * that has not been allocated yet returns a shared, immutable empty instance.
+ *
+ * Containers can be shared copy-on-write between Variables (see Variable::createCopyOnWrite()). A shared container is
+ * copied on the first non-const access. Only the element pointers are copied, so the elements stay shared by both
+ * containers until they are detached along the path that is modified (see Variable::detach() and sharesElements()).
+ * Use view() to read without copying.
+ *
+ * Non-const access counts as mutation and therefore must not happen concurrently, just like any other write to a
+ * Variable. Frozen containers (see Variable::freeze()) are read-only, but can still be read through non-const access,
+ * so nodes can read frozen messages they receive as PVariable. Non-const access returns the frozen container itself
+ * without allocating or copying. Frozen structs throw FrozenVariableException from all functions adding or removing
+ * elements. Arrays are plain std::vectors and can't detect modifications, so don't modify the array of a frozen
+ * Variable. Assigning to or resetting a frozen container throws. Conversion to std::shared_ptr returns a writable copy
+ * of a frozen container. Copies of a frozen container alias it and are frozen as well.
+ */
+template<typename T>
+class LazyContainer {
+ public:
+  LazyContainer() = default;
+  LazyContainer(std::nullptr_t) {}
+  LazyContainer(const std::shared_ptr<T> &container) : _container(container) {}
+  LazyContainer(std::shared_ptr<T> &&container) : _container(std::move(container)) {}
+  //Copies alias the container, so they keep all flags including the frozen flag.
+  LazyContainer(const LazyContainer &rhs) : _container(rhs._container), _flags(rhs._flags.load(std::memory_order_relaxed)) {}
+  LazyContainer(LazyContainer &&rhs) noexcept : _flags(rhs._flags.load(std::memory_order_relaxed)) { take(rhs); }
+
+  /**
+   * @throws FrozenVariableException when this container is frozen.
+   */
+  LazyContainer &operator=(const LazyContainer &rhs) {
+    if (frozen()) throwFrozen();
+    _container = rhs._container;
+    _flags.store(rhs._flags.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    return *this;
+  }
+
+  /**
+   * @throws FrozenVariableException when this container is frozen.
+   */
+  LazyContainer &operator=(LazyContainer &&rhs) {
+    if (&rhs == this) return *this;
+    if (frozen()) throwFrozen();
+    _flags.store(rhs._flags.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    take(rhs);
+    return *this;
+  }
+
+  /**
+   * Allocates or copies the container if necessary. Frozen containers are returned as they are, see above.
+   */
+  T *get() {
+    if (frozen()) return _container ? _container.get() : &frozenEmpty();
+    prepareWrite();
+    return _container.get();
+  }
+  const T *get() const { return _container ? _container.get() : &empty(); }
+  T *operator->() { return get(); }
+  const T *operator->() const { return get(); }
+  T &operator*() { return *get(); }
+  const T &operator*() const { return *get(); }
+
+  /**
+   * Read-only access that never allocates or copies the container, e.g. message->structValue.view().find("topic").
+   */
+  const T &view() const { return *get(); }
+
+  /**
+   * The returned pointer can be used to modify the container, so this allocates or copies it if necessary. For frozen
+   * containers a copy is returned, the elements are shared with the frozen container.
+   */
+  operator std::shared_ptr<T>() const {
+    if (frozen()) return Pool::create<T>(view());
+    prepareWrite();
+    return _container;
+  }
+
+  /**
+   * Always true, the container is allocated on demand.
+   */
+  explicit operator bool() const { return true; }
+
+  /**
+   * @return Returns true when the container has been allocated.
+   */
+  bool allocated() const { return (bool)_container; }
+
+  /**
+   * Marks the container as read-only. Call Variable::freeze() instead of calling this directly.
+   */
+  void freeze() {
+    if (frozen()) return;
+    //A container shared copy-on-write is copied first, so the other Variables sharing it stay writable.
+    if (_container) {
+      prepareWrite();
+      freezeContainer(*_container);
+    }
+    _flags.fetch_or(frozenFlag, std::memory_order_relaxed);
+  }
+  bool frozen() const { return _flags.load(std::memory_order_relaxed) & frozenFlag; }
+
+  /**
+   * @return Returns true when the container is or was shared copy-on-write, so its elements might also be elements of
+   * another container. Detach elements of such containers before modifying them in place (see Variable::detach()).
+   */
+  bool sharesElements() const { return _flags.load(std::memory_order_relaxed) & (copyOnWriteFlag | sharedElementsFlag); }
+
+  /**
+   * @throws FrozenVariableException when the container is frozen.
+   */
+  void reset() {
+    if (frozen()) throwFrozen();
+    _container.reset();
+    _flags.store(0, std::memory_order_relaxed);
+  }
+
+  /**
+   * Shares the container of "rhs" copy-on-write. "rhs" is only modified to mark its container as shared.
+   */
+  void share(const LazyContainer &rhs) {
+    if (!rhs._container) {
+      reset();
+      return;
+    }
+    rhs._flags.fetch_or(copyOnWriteFlag, std::memory_order_relaxed);
+    _container = rhs._container;
+    _flags.fetch_or(copyOnWriteFlag, std::memory_order_relaxed);
+  }
+
+  /**
+   * @return Returns the immutable empty container used for const access to unallocated containers.
+   */
+  static const T &empty() {
+    static const T emptyContainer;
+    return emptyContainer;
+  }
+ private:
+  //~Variable() releases the containers itself, see there.
+  friend class Variable;
+
+  enum Flags : uint8_t {
+    copyOnWriteFlag = 1,
+    frozenFlag = 2,
+    sharedElementsFlag = 4,
+  };
+
+  mutable std::shared_ptr<T> _container;
+  //All flags share one byte, so the container only adds one byte to the shared_ptr. Variable places small members
+  //in the remaining tail padding. The flags are atomic, because share() marks the container of the source as shared
+  //and the source might be frozen and in use by other threads.
+  mutable std::atomic<uint8_t> _flags{0};
+
+  [[noreturn]] static void throwFrozen() {
+    throw FrozenVariableException("Modification of a frozen container. Use Variable::detach() to get a writable copy.");
+  }
+
+  /**
+   * Moves the container of "rhs" into this one. Frozen containers are read-only, so their container is shared instead.
+   */
+  void take(LazyContainer &rhs) noexcept {
+    if (rhs.frozen()) {
+      _container = rhs._container;
+      return;
+    }
+    _container = std::move(rhs._container);
+    rhs._flags.store(0, std::memory_order_relaxed);
+  }
+
+  static void freezeContainer(Struct &container) { container.freeze(); }
+  static void freezeContainer(Array &) {}
+  static bool containerFrozen(const Struct &container) { return container.frozen(); }
+  static bool containerFrozen(const Array &) { return false; }
+
+  /**
+   * @return Returns the container handed out by non-const access to frozen containers that have not been allocated.
+   * For structs this is a frozen empty struct. Arrays can't be frozen, so every thread gets its own empty array, which
+   * is cleared on every call, so writes to it can't leak into other Variables.
+   */
+  static T &frozenEmpty() {
+    if constexpr (std::is_same<T, Struct>::value) {
+      struct FrozenEmpty {
+        FrozenEmpty() { container.freeze(); }
+        Struct container;
+      };
+      static FrozenEmpty instance;
+      return instance.container;
+    } else {
+      thread_local T emptyContainer;
+      emptyContainer.clear();
+      return emptyContainer;
+    }
+  }
+
+  /**
+   * Must not be called on frozen containers.
+   */
+  void prepareWrite() const {
+    auto flags = _flags.load(std::memory_order_relaxed);
+    if (!_container) _container = Pool::create<T>();
+    else if (flags & copyOnWriteFlag) {
+      //When the other Variables sharing the container are gone already, there is nothing to copy. The elements are
+      //shared with the other container either way. Frozen containers shared by Variable::createCopyOnWrite() are
+      //always copied, as they can't be written to.
+      if (_container.use_count() > 1 || containerFrozen(*_container)) _container = Pool::create<T>(*_container);
+      _flags.fetch_or(sharedElementsFlag, std::memory_order_relaxed);
+      _flags.fetch_and((uint8_t)~copyOnWriteFlag, std::memory_order_relaxed);
+    }
+  }
+};
+
 class Variable {
  private:
   typedef void (Variable::*bool_type)() const;
 
   void this_type_does_not_support_comparisons() const {}
-  std::string print(PVariable variable, std::string indent, bool ignoreIndentOnFirstLine, bool oneLine);
-  std::string printStruct(PStruct rpcStruct, std::string indent, bool ignoreIndentOnFirstLine, bool oneLine);
-  std::string printArray(PArray rpcArray, std::string indent, bool ignoreIndentOnFirstLine, bool oneLine);
+  static void print(const Variable &root, const std::string &indent, bool ignoreIndentOnFirstLine, bool oneLine, std::ostringstream &result);
+  static size_t hashCombine(size_t seed, size_t value);
+
+  /**
+   * Arrays and structs nested deeper than this are compared and hashed with VariableIterator instead of recursively and
+   * released iteratively by the destructor. Recursion is faster, but the explicit stack of the iterator can't overflow.
+   */
+  static constexpr uint32_t maxRecursionDepth = 32;
+
+  /**
+   * Moves the elements of the containers of this Variable that are about to be released together with it and have
+   * elements of their own to "deferred".
+   */
+  void deferNestedElements(std::vector<PVariable> &deferred);
+
+  bool equals(const Variable &rhs, bool voidsEqual, uint32_t depth) const;
+  bool equalsIterative(const Variable &rhs, bool voidsEqual) const;
+  void hash(size_t &result, uint32_t depth) const;
+  void hashIterative(size_t &result) const;
+
+  /**
+   * @return Returns the bytes used by strings, binary value and containers of this Variable, not counting elements.
+   */
+  size_t ownMemoryUsage() const;
+  static void diff(const PVariable &from, const PVariable &to, std::string &path, Array &patch, uint32_t depth);
+  static PVariable createPatchOperation(const char *operation, const std::string &path, const PVariable &value);
+  static std::string escapePathToken(const std::string &token);
+  size_t estimateMemoryUsage(uint32_t depth) const;
+
+  /**
+   * Compares everything but the elements of arrays and structs.
+   */
+  bool valueEquals(const Variable &rhs, bool voidsEqual) const;
+
+  /**
+   * Hashes everything but the elements of arrays and structs.
+   */
+  size_t valueHash() const;
  public:
-  bool errorStruct = false;
-  VariableType type;
+  // Each LazyContainer is a shared_ptr followed by one flag byte. [[no_unique_address]] allows the compiler to place the
+  // members following it in its 7 bytes of tail padding, which is where the small members go. This gives 128 bytes on
+  // 64 bit platforms with GCC and Clang including the vtable pointer. Compilers ignoring the attribute (MSVC) need 16
+  // bytes more, the static_assert below the class holds for both. Keep it that way when adding members, as every value
+  // of every message is a Variable.
   std::string stringValue;
+  std::vector<uint8_t> binaryValue;
+  [[no_unique_address]] LazyContainer<Array> arrayValue;
+  bool booleanValue = false;
+  bool errorStruct = false;
   int32_t integerValue = 0;
+  [[no_unique_address]] LazyContainer<Struct> structValue;
+ private:
+  bool _frozen = false;
+ public:
+  VariableType type;
   int64_t integerValue64 = 0;
   double floatValue = 0;
-  bool booleanValue = false;
-  PArray arrayValue;
-  PStruct structValue;
-  std::vector<uint8_t> binaryValue;
 
   Variable();
   Variable(Variable const &rhs);
+  /**
+   * Like operator=(Variable&&): A frozen "rhs" is copied instead of moved and the new Variable is not frozen.
+   */
+  Variable(Variable &&rhs);
   explicit Variable(VariableType variableType);
   explicit Variable(uint8_t integer);
   explicit Variable(int32_t integer);
@@ -97,39 +369,247 @@ class Variable {
   explicit Variable(int64_t integer);
   explicit Variable(uint64_t integer);
   explicit Variable(const std::string &string);
+  explicit Variable(std::string &&string);
   explicit Variable(const char *string);
   explicit Variable(bool boolean);
   explicit Variable(double floatVal);
   explicit Variable(const PArray &arrayVal);
+  explicit Variable(PArray &&arrayVal);
   explicit Variable(const std::vector<std::string> &arrayVal);
   explicit Variable(const PStruct &structVal);
+  explicit Variable(PStruct &&structVal);
   explicit Variable(const std::vector<uint8_t> &binaryVal);
+  explicit Variable(std::vector<uint8_t> &&binaryVal);
   explicit Variable(const uint8_t *binaryVal, size_t binaryValSize);
   explicit Variable(const std::vector<char> &binaryVal);
   explicit Variable(const char *binaryVal, size_t binaryValSize);
 
+  /**
+   * Creates a packed array of type tInteger64Array.
+   */
+  explicit Variable(const std::vector<int64_t> &integers);
+
+  /**
+   * Creates a packed array of type tFloatArray.
+   */
+  explicit Variable(const std::vector<double> &floats);
+
   /**
    * Create variable from typed JSON string.
    * @param type bool, int, float, string, array or struct.
    * @param value The value in JSON format.
    */
   explicit Variable(const std::string &typeString, const std::string &jsonValue);
-  virtual ~Variable() = default;
+  /**
+   * Doesn't recurse deeper than maxRecursionDepth, so arbitrarily deep trees can be released.
+   */
+  virtual ~Variable();
   static PVariable createError(int32_t faultCode, std::string faultString);
+
+  /**
+   * Creates a copy of "rhs" which shares its arrays and structs with "rhs" instead of copying them. A shared container
+   * is copied on the first non-const access through either Variable, but only the element pointers are copied, so the
+   * elements stay shared by both trees and pointers to them held from before stay valid. MessageProperty,
+   * MessagePropertySet and apply() detach the elements along the path they modify, so modifying one element of a large
+   * tree only copies the Variables and containers along the path to that element.
+   *
+   * Elements modified in place in any other way must be detached first, e.g. with
+   * Variable::detach(element, container.sharesElements()). Otherwise the modification is visible in both trees. Use
+   * LazyContainer::view() or a const reference to read without copying containers.
+   *
+   * @param rhs The Variable to copy.
+   * @return Returns the copy.
+   */
+  static PVariable createCopyOnWrite(const Variable &rhs);
+
+  /**
+   * Makes this Variable and all of its elements read-only, so the tree can be passed to any number of receivers
+   * (e.g. to all wires of an output) without copying it. Frozen trees can be read as usual, but must not be modified:
+   * Assignment and modification of their structs throw FrozenVariableException, modifications of their arrays are not
+   * detected (see LazyContainer). Use detach() to get a writable Variable. Freeze a tree before sharing it with other
+   * threads, not while they use it.
+   *
+   * Elements shared copy-on-write with another tree (see createCopyOnWrite()) are copied before freezing them, so the
+   * other tree stays writable. Freezing a copy-on-write copy therefore copies it, freeze the original instead where
+   * possible.
+   */
+  void freeze();
+
+  /**
+   * @return Returns true when the Variable was frozen with freeze().
+   */
+  bool isFrozen() const { return _frozen; }
+
+  /**
+   * Replaces "variable" by a writable copy-on-write copy (see createCopyOnWrite()) if it is frozen or, with "shared",
+   * might be an element of another tree. Does nothing otherwise. Call this before modifying a Variable that might be
+   * frozen or shared.
+   *
+   * @param variable The Variable to detach.
+   * @param shared Pass LazyContainer::sharesElements() of the array or struct holding "variable". When true, the
+   * Variable is also replaced when it is referenced from anywhere else.
+   */
+  static void detach(PVariable &variable, bool shared = false);
+
+  /**
+   * Creates a patch turning "from" into "to". The patch is an array of operations in the format of JSON Patch (RFC
+   * 6902), e.g. [{"op": "replace", "path": "/state/level", "value": 0.5}], using the operations "add", "remove" and
+   * "replace". Struct elements are compared by key, array elements by index. Values in the patch share their arrays
+   * and structs copy-on-write with "to", so large added or replaced subtrees aren't copied.
+   *
+   * @param from The old state.
+   * @param to The new state.
+   * @return Returns the patch. An empty array when "from" and "to" are equal.
+   */
+  static PVariable diff(const PVariable &from, const PVariable &to);
+
+  /**
+   * Applies a patch created by diff() or any other JSON Patch using the operations "add", "remove" and "replace". Added
+   * values share their arrays and structs copy-on-write with the patch. Frozen elements along the paths are detached,
+   * the Variable itself must not be frozen.
+   *
+   * @param patch The patch to apply.
+   * @return Returns false when an operation is invalid or its path doesn't exist. Operations before it have been
+   * applied then.
+   */
+  bool apply(const PVariable &patch);
   std::string print(bool stdout = false, bool stderr = false, bool oneLine = false);
   static std::string getTypeString(VariableType type);
   void setType(VariableType value) { type = value; };
+
+  /**
+   * Sets integerValue, integerValue64 and booleanValue from stringValue the way the string constructors do. The numbers
+   * are parsed with Math::getNumber64(), which doesn't throw and returns 0 for text. Strings that can't start a number
+   * are rejected before calling it, so decoding text is cheap.
+   */
+  void setValuesFromString();
+
+  /**
+   * Packed arrays (tInteger64Array and tFloatArray) store their elements contiguously in binaryValue (8 bytes per
+   * element) instead of as one Variable per element in arrayValue. They are encoded as ordinary arrays.
+   *
+   * @return Returns true when the Variable is a packed array.
+   */
+  bool isPackedArray() const { return type == VariableType::tInteger64Array || type == VariableType::tFloatArray; }
+
+  /**
+   * @return Returns the number of elements of a packed array.
+   */
+  size_t packedArraySize() const { return binaryValue.size() / 8; }
+
+  /**
+   * @return Returns the elements of a packed array of type tInteger64Array.
+   */
+  int64_t *packedIntegers() { return reinterpret_cast<int64_t *>(binaryValue.data()); }
+  const int64_t *packedIntegers() const { return reinterpret_cast<const int64_t *>(binaryValue.data()); }
+
+  /**
+   * @return Returns the elements of a packed array of type tFloatArray.
+   */
+  double *packedFloats() { return reinterpret_cast<double *>(binaryValue.data()); }
+  const double *packedFloats() const { return reinterpret_cast<const double *>(binaryValue.data()); }
+
+  /**
+   * Converts an array of numbers to a packed array. Arrays containing only integers become tInteger64Array, arrays
+   * containing at least one float become tFloatArray.
+   *
+   * @return Returns false and leaves the Variable unchanged when it is not an array or contains other elements than
+   * numbers.
+   */
+  bool pack();
+
+  /**
+   * Converts a packed array to an ordinary array. Integers fitting 32 bits become tInteger, just like when decoding.
+   * Does nothing when the Variable is not a packed array.
+   */
+  void unpack();
+
+  /**
+   * @return Returns the elements of an array or packed array as Array.
+   */
+  PArray toArray() const;
+
+  /**
+   * Calculates a structural hash of the Variable and all its elements. Variables comparing equal with operator== or
+   * equivalent() have the same hash.
+   */
+  size_t hash() const;
+
+  /**
+   * Compares like operator==, except that void Variables are equal to each other. operator== never considers void
+   * Variables equal, not even to themselves, so trees containing JSON null are never equal to anything. Use this for
+   * change detection and as key comparison together with hash().
+   */
+  bool equivalent(const Variable &rhs) const;
+
+  /**
+   * Walks the tree and counts the bytes it uses: this Variable, the Variables of all elements including their control
+   * blocks, the heap memory of strings and binary values and the arrays and structs themselves. Containers shared
+   * copy-on-write or after freeze() are counted for each Variable referencing them.
+   *
+   * @return Returns the number of bytes.
+   */
+  size_t memoryUsage() const;
+
+  /**
+   * Cheap estimate of memoryUsage(). Uses sizes instead of capacities and only looks at up to 8 evenly spread elements
+   * of each array or struct, extrapolating from them. Good enough for quotas and queue limits, not for finding leaks.
+   *
+   * @return Returns the estimated number of bytes.
+   */
+  size_t estimateMemoryUsage() const;
   std::string toString();
+  /**
+   * @throws FrozenVariableException when this Variable is frozen.
+   */
   Variable &operator=(const Variable &rhs);
-  bool operator==(const Variable &rhs);
+
+  /**
+   * Frozen Variables are not moved out of, their containers are shared copy-on-write instead (see createCopyOnWrite()).
+   *
+   * @throws FrozenVariableException when this Variable is frozen.
+   */
+  Variable &operator=(Variable &&rhs);
+  /**
+   * Compares the type and value of the Variables and of all their elements. Void Variables and Variables of types
+   * without value (e.g. tVariant) are never equal, see equivalent().
+   */
+  bool operator==(const Variable &rhs) const;
   bool operator<(const Variable &rhs);
   bool operator<=(const Variable &rhs);
   bool operator>(const Variable &rhs);
   bool operator>=(const Variable &rhs);
-  bool operator!=(const Variable &rhs);
+  bool operator!=(const Variable &rhs) const;
   operator bool_type() const;
 };
 
+//The small members take at most 16 bytes next to the containers, even when the tail padding of the lazy containers
+//can't be reused.
+static_assert(sizeof(Variable) <= sizeof(void *) + sizeof(std::string) + sizeof(std::vector<uint8_t>) + 2 * sizeof(LazyContainer<Array>) + 16 + sizeof(int64_t) + sizeof(double), "Unexpected padding in Variable. See the comment on its members.");
+
+/**
+ * Hash functor to use PVariable as key of unordered containers by value. Use together with PVariableEqual.
+ */
+struct PVariableHash {
+  size_t operator()(const PVariable &variable) const { return variable ? variable->hash() : 0; }
+};
+
+/**
+ * Compares PVariables by value with Variable::equivalent().
+ */
+struct PVariableEqual {
+  bool operator()(const PVariable &lhs, const PVariable &rhs) const { return lhs == rhs || (lhs && rhs && lhs->equivalent(*rhs)); }
+};
+
+}
+
+namespace std {
+
+template<>
+struct hash<Flows::Variable> {
+  size_t operator()(const Flows::Variable &variable) const { return variable.hash(); }
+};
+
 }
 
 #endif
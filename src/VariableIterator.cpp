@@ -0,0 +1,73 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "VariableIterator.h"
+
+namespace Flows {
+
+VariableIterator::VariableIterator(const Variable &root, uint32_t maxDepth) : _root(root), _maxDepth(maxDepth) {
+}
+
+void VariableIterator::throwMaxDepthExceeded() const {
+  throw VariableIteratorException("Maximum nesting depth of " + std::to_string(_maxDepth) + " exceeded.");
+}
+
+bool VariableIterator::start() {
+  if (_started) return false;
+  _started = true;
+  _key = nullptr;
+  _index = 0;
+  enter(&_root);
+  return true;
+}
+
+bool VariableIterator::leave() {
+  _event = _top.container->type == VariableType::tStruct ? Event::endStruct : Event::endArray;
+  _variable = _top.container;
+  _open--;
+  if (_open == 0) {
+    _key = nullptr;
+    _index = 0;
+  } else {
+    _top = _stack.back();
+    _stack.pop_back();
+    //Restore the position of the container itself within its parent.
+    _index = _top.index - 1;
+    _key = _top.structElement ? &(_top.structElement - 1)->first : nullptr;
+  }
+  return true;
+}
+
+void VariableIterator::skipElements() {
+  if ((_event != Event::beginArray && _event != Event::beginStruct) || _open == 0) return;
+  _top.index = _top.size;
+}
+
+}
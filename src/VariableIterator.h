@@ -0,0 +1,200 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#ifndef LIBHOMEGEAR_NODE_VARIABLEITERATOR_H
+#define LIBHOMEGEAR_NODE_VARIABLEITERATOR_H
+
+#include "FlowException.h"
+#include "Variable.h"
+
+#include <vector>
+
+namespace Flows {
+
+class VariableIteratorException : public FlowException {
+ public:
+  explicit VariableIteratorException(const std::string &message) : FlowException(message) {}
+};
+
+/**
+ * Depth-first iterator over a Variable tree using an explicit stack instead of recursion, so deep trees can't overflow
+ * the call stack. Each call to next() moves to the next event:
+ *
+ * - beginArray/beginStruct when entering an array or struct,
+ * - value for everything else (including packed arrays and nullptr elements),
+ * - endArray/endStruct after the last element of an array or struct.
+ *
+ * For elements of a struct, key() returns the element's key. Containers are only read, so iterating doesn't allocate
+ * containers or trigger copy-on-write copies. The tree must not be modified while iterating.
+ *
+ * Example:
+ *
+ *   VariableIterator iterator(*variable);
+ *   while (iterator.next()) {
+ *     if (iterator.event() == VariableIterator::Event::value) ...
+ *   }
+ */
+class VariableIterator {
+ public:
+  enum class Event {
+    value,
+    beginArray,
+    endArray,
+    beginStruct,
+    endStruct
+  };
+
+  static constexpr uint32_t defaultMaxDepth = 1000;
+
+  /**
+   * @param root The Variable to iterate over.
+   * @param maxDepth The maximum number of nested arrays and structs. When it is exceeded, next() throws a
+   * VariableIteratorException. 0 means no limit.
+   */
+  explicit VariableIterator(const Variable &root, uint32_t maxDepth = defaultMaxDepth);
+
+  /**
+   * Moves to the next event.
+   *
+   * @return Returns false when there are no more events.
+   * @throws VariableIteratorException when the maximum depth is exceeded.
+   */
+  inline bool next();
+
+  /**
+   * Skips the elements of the array or struct just entered. The next event is its endArray or endStruct.
+   */
+  void skipElements();
+
+  Event event() const { return _event; }
+
+  /**
+   * @return Returns the current Variable. This is the array or struct itself for begin and end events. Can be
+   * nullptr for nullptr elements.
+   */
+  const Variable *variable() const { return _variable; }
+
+  /**
+   * @return Returns true when the current Variable is an element of a struct.
+   */
+  bool inStruct() const { return _key != nullptr; }
+
+  /**
+   * Only call when inStruct() returns true.
+   *
+   * @return Returns the key of the current element.
+   */
+  const std::string &key() const { return *_key; }
+
+  /**
+   * @return Returns true for the root and for the first element of each array or struct.
+   */
+  bool firstElement() const { return _index == 0; }
+
+  /**
+   * @return Returns the number of arrays and structs the current Variable is nested in. The root has depth 0.
+   */
+  uint32_t depth() const { return _open - (_event == Event::beginArray || _event == Event::beginStruct ? 1 : 0); }
+ private:
+  struct Frame {
+    const Variable *container;
+    const PVariable *arrayElement;
+    const Struct::value_type *structElement;
+    size_t size;
+    size_t index;
+  };
+
+  const Variable &_root;
+  uint32_t _maxDepth = defaultMaxDepth;
+  bool _started = false;
+  uint32_t _open = 0;
+
+  /**
+   * The innermost open array or struct. It is kept out of "_stack", so the compiler can keep it in registers.
+   */
+  Frame _top{};
+
+  /**
+   * The open arrays and structs "_top" is nested in. Empty as long as only the root is open.
+   */
+  std::vector<Frame> _stack;
+  Event _event = Event::value;
+  const Variable *_variable = nullptr;
+  const std::string *_key = nullptr;
+  size_t _index = 0;
+
+  inline void enter(const Variable *variable);
+  bool start();
+  bool leave();
+  [[noreturn]] void throwMaxDepthExceeded() const;
+};
+
+inline void VariableIterator::enter(const Variable *variable) {
+  _variable = variable;
+  if (!variable || (variable->type != VariableType::tArray && variable->type != VariableType::tStruct)) {
+    _event = Event::value;
+    return;
+  }
+  if (_maxDepth != 0 && _open >= _maxDepth) throwMaxDepthExceeded();
+  if (_open != 0) {
+    //Only reserved when needed, so iterating flat Variables doesn't allocate.
+    if (_stack.capacity() == 0) _stack.reserve(16);
+    _stack.push_back(_top);
+  }
+  _open++;
+  if (variable->type == VariableType::tArray) {
+    _event = Event::beginArray;
+    const Array &array = *variable->arrayValue;
+    _top = Frame{variable, array.data(), nullptr, array.size(), 0};
+  } else {
+    _event = Event::beginStruct;
+    const Struct &structValue = *variable->structValue;
+    _top = Frame{variable, nullptr, structValue.empty() ? nullptr : &*structValue.begin(), structValue.size(), 0};
+  }
+}
+
+inline bool VariableIterator::next() {
+  if (_open == 0) return start();
+  if (_top.index == _top.size) return leave();
+  _index = _top.index++;
+  if (_top.structElement) {
+    auto &element = *_top.structElement++;
+    _key = &element.first;
+    enter(element.second.get());
+  } else {
+    _key = nullptr;
+    enter((_top.arrayElement++)->get());
+  }
+  return true;
+}
+
+}
+
+#endif //LIBHOMEGEAR_NODE_VARIABLEITERATOR_H
@@ -0,0 +1,127 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "Test.h"
+#include "../src/Arena.h"
+#include "../src/JsonDecoder.h"
+#include "../src/JsonEncoder.h"
+#include "../src/RpcDecoder.h"
+#include "../src/RpcEncoder.h"
+
+using namespace Flows;
+
+namespace {
+
+const std::string json = R"({"payload": {"values": [1, 2, 3], "name": "sensor"}, "topic": "test"})";
+
+}
+
+TEST(elementsKeepArena) {
+  auto arena = std::make_shared<Arena>();
+  std::weak_ptr<Arena> weakArena = arena;
+  auto root = JsonDecoder::decode(json, arena);
+  EXPECT(arena->usedBytes() > 0);
+  arena.reset();
+  EXPECT(!weakArena.expired());
+  EXPECT(JsonEncoder::getString(root) == JsonEncoder::getString(JsonDecoder::decode(json)));
+  auto values = root->structValue.view().at("payload")->structValue.view().at("values");
+  auto name = root->structValue.view().at("payload")->structValue.view().at("name");
+  root.reset();
+  EXPECT(!weakArena.expired());
+  EXPECT(values->arrayValue.view().size() == 3);
+  EXPECT(values->arrayValue.view().at(2)->integerValue == 3);
+  values.reset();
+  EXPECT(!weakArena.expired());
+  EXPECT(name->stringValue == "sensor");
+  name.reset();
+  EXPECT(weakArena.expired());
+}
+
+TEST(copyOnWriteCopyKeepsArena) {
+  auto arena = std::make_shared<Arena>();
+  std::weak_ptr<Arena> weakArena = arena;
+  auto root = JsonDecoder::decode(json, arena);
+  arena.reset();
+  auto copy = Variable::createCopyOnWrite(*root);
+  root.reset();
+  EXPECT(!weakArena.expired());
+  EXPECT(copy->structValue.view().at("topic")->stringValue == "test");
+  copy.reset();
+  EXPECT(weakArena.expired());
+}
+
+TEST(elementsCopiedOutDontKeepArena) {
+  auto arena = std::make_shared<Arena>();
+  std::weak_ptr<Arena> weakArena = arena;
+  auto root = JsonDecoder::decode(json, arena);
+  arena.reset();
+  auto payload = std::make_shared<Variable>(*root->structValue.view().at("payload"));
+  root.reset();
+  EXPECT(weakArena.expired());
+  EXPECT(payload->structValue.view().at("name")->stringValue == "sensor");
+  EXPECT(payload->structValue.view().at("values")->arrayValue.view().size() == 3);
+}
+
+TEST(decodedWithArenaEqualsDecodedWithoutArena) {
+  for (auto &document : {json, std::string("[]"), std::string("\"text\""), std::string("{\"a\": [[], {}, null, true, 1.5]}")}) {
+    auto arena = std::make_shared<Arena>();
+    auto root = JsonDecoder::decode(document, arena);
+    EXPECT(root->equivalent(*JsonDecoder::decode(document)));
+  }
+}
+
+TEST(rpcParametersKeepArena) {
+  auto parameters = std::make_shared<Array>();
+  parameters->push_back(JsonDecoder::decode(json));
+  parameters->push_back(std::make_shared<Variable>("second"));
+  std::vector<char> packet;
+  RpcEncoder encoder;
+  encoder.encodeRequest("method", parameters, packet);
+
+  auto arena = std::make_shared<Arena>();
+  std::weak_ptr<Arena> weakArena = arena;
+  RpcDecoder decoder;
+  std::string methodName;
+  auto decoded = decoder.decodeRequest(packet, methodName, arena);
+  arena.reset();
+  EXPECT(methodName == "method");
+  EXPECT(decoded->size() == 2);
+  EXPECT(*decoded->at(0) == *parameters->at(0));
+  auto name = decoded->at(0)->structValue.view().at("payload")->structValue.view().at("name");
+  decoded.reset();
+  EXPECT(!weakArena.expired());
+  EXPECT(name->stringValue == "sensor");
+  name.reset();
+  EXPECT(weakArena.expired());
+}
+
+int main() {
+  return Test::run();
+}
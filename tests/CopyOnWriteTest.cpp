@@ -0,0 +1,231 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "Test.h"
+#include "../src/MessageProperty.h"
+#include "../src/Variable.h"
+
+using namespace Flows;
+
+namespace {
+
+//{"a": {"b": 1, "c": "text"}, "list": [{"value": 2}, "x"], "big": {"d": [1, 2, 3]}}
+PVariable createMessage() {
+  auto message = std::make_shared<Variable>(VariableType::tStruct);
+  auto a = std::make_shared<Variable>(VariableType::tStruct);
+  a->structValue->emplace("b", std::make_shared<Variable>(1));
+  a->structValue->emplace("c", std::make_shared<Variable>("text"));
+  message->structValue->emplace("a", a);
+  auto list = std::make_shared<Variable>(VariableType::tArray);
+  auto element = std::make_shared<Variable>(VariableType::tStruct);
+  element->structValue->emplace("value", std::make_shared<Variable>(2));
+  list->arrayValue->push_back(element);
+  list->arrayValue->push_back(std::make_shared<Variable>("x"));
+  message->structValue->emplace("list", list);
+  auto big = std::make_shared<Variable>(VariableType::tStruct);
+  auto d = std::make_shared<Variable>(VariableType::tArray);
+  for (int32_t i = 1; i <= 3; i++) {
+    d->arrayValue->push_back(std::make_shared<Variable>(i));
+  }
+  big->structValue->emplace("d", d);
+  message->structValue->emplace("big", big);
+  return message;
+}
+
+//MessageProperty::set() takes the value by non-const reference.
+bool set(PVariable &message, const std::string &property, PVariable value) {
+  return MessageProperty(property).set(message, value);
+}
+
+}
+
+TEST(copyEqualsOriginal) {
+  auto original = createMessage();
+  auto copy = Variable::createCopyOnWrite(*original);
+  EXPECT(*copy == *original);
+}
+
+TEST(modifyingNestedStructElementOfCopyLeavesOriginalUnchanged) {
+  auto original = createMessage();
+  auto expected = std::make_shared<Variable>(*original);
+  auto copy = Variable::createCopyOnWrite(*original);
+  EXPECT(set(copy, "a.b", std::make_shared<Variable>(5)));
+  EXPECT(set(copy, "a.c", std::make_shared<Variable>("changed")));
+  EXPECT(*original == *expected);
+  EXPECT(copy->structValue.view().at("a")->structValue.view().at("b")->integerValue == 5);
+  EXPECT(copy->structValue.view().at("a")->structValue.view().at("c")->stringValue == "changed");
+}
+
+TEST(modifyingNestedArrayElementOfCopyLeavesOriginalUnchanged) {
+  auto original = createMessage();
+  auto expected = std::make_shared<Variable>(*original);
+  auto copy = Variable::createCopyOnWrite(*original);
+  EXPECT(set(copy, "list[1]", std::make_shared<Variable>("y")));
+  EXPECT(set(copy, "list[0].value", std::make_shared<Variable>(7)));
+  //Elements modified in place without MessageProperty are detached along the path first.
+  auto &big = copy->structValue->at("big");
+  Variable::detach(big, copy->structValue.sharesElements());
+  auto &d = big->structValue->at("d");
+  Variable::detach(d, big->structValue.sharesElements());
+  d->arrayValue->push_back(std::make_shared<Variable>(4));
+  EXPECT(*original == *expected);
+  EXPECT(copy->structValue.view().at("list")->arrayValue.view().at(1)->stringValue == "y");
+  EXPECT(copy->structValue.view().at("list")->arrayValue.view().at(0)->structValue.view().at("value")->integerValue == 7);
+  EXPECT(copy->structValue.view().at("big")->structValue.view().at("d")->arrayValue.view().size() == 4);
+}
+
+TEST(modifyingOriginalLeavesCopyUnchanged) {
+  auto original = createMessage();
+  auto copy = Variable::createCopyOnWrite(*original);
+  auto expected = std::make_shared<Variable>(*copy);
+  EXPECT(set(original, "a.b", std::make_shared<Variable>(9)));
+  EXPECT(MessageProperty("list[0].value").erase(original));
+  EXPECT(*copy == *expected);
+  EXPECT(!(*original == *expected));
+}
+
+TEST(unmodifiedSubtreesStayShared) {
+  auto original = createMessage();
+  auto copy = Variable::createCopyOnWrite(*original);
+  EXPECT(set(copy, "a.b", std::make_shared<Variable>(5)));
+  //Only the Variables and containers along the modified path are copied.
+  EXPECT(original->structValue.view().at("big") == copy->structValue.view().at("big"));
+  EXPECT(original->structValue.view().at("list") == copy->structValue.view().at("list"));
+  EXPECT(original->structValue.view().at("a") != copy->structValue.view().at("a"));
+  EXPECT(original->structValue.view().at("a")->structValue.view().at("c") == copy->structValue.view().at("a")->structValue.view().at("c"));
+  EXPECT(&original->structValue.view() != &copy->structValue.view());
+}
+
+TEST(lookupInCopyDoesNotCopySiblings) {
+  auto original = createMessage();
+  original->structValue->emplace("binary", std::make_shared<Variable>(std::vector<uint8_t>(1024 * 1024, 0x55)));
+  auto binary = original->structValue.view().at("binary");
+  auto copy = Variable::createCopyOnWrite(*original);
+  EXPECT(copy->structValue->find("topic") == copy->structValue->end());
+  EXPECT(copy->structValue.view().at("binary") == binary);
+  EXPECT(set(copy, "a.b", std::make_shared<Variable>(5)));
+  EXPECT(set(copy, "topic", std::make_shared<Variable>("new")));
+  EXPECT(copy->structValue.view().at("binary") == binary);
+  EXPECT(original->structValue.view().at("binary") == binary);
+  EXPECT(binary->binaryValue.size() == 1024 * 1024);
+}
+
+TEST(pointersIntoOriginalStayInOriginal) {
+  auto original = createMessage();
+  auto a = original->structValue.view().at("a");
+  auto list = original->structValue.view().at("list");
+  auto copy = Variable::createCopyOnWrite(*original);
+  EXPECT(copy->structValue->find("a") != copy->structValue->end());
+  EXPECT(original->structValue->find("a") != original->structValue->end());
+  EXPECT(original->structValue.view().at("a") == a);
+  EXPECT(original->structValue.view().at("list") == list);
+}
+
+TEST(viewDoesNotCopy) {
+  auto original = createMessage();
+  auto copy = Variable::createCopyOnWrite(*original);
+  EXPECT(&copy->structValue.view() == &original->structValue.view());
+  EXPECT(copy->structValue.view().find("a") != copy->structValue.view().end());
+  EXPECT(&copy->structValue.view() == &original->structValue.view());
+}
+
+TEST(copyOfCopyIsIsolated) {
+  auto original = createMessage();
+  auto copy = Variable::createCopyOnWrite(*original);
+  auto copy2 = Variable::createCopyOnWrite(*copy);
+  auto expected = std::make_shared<Variable>(*original);
+  MessageProperty property("a.b");
+  EXPECT(set(copy2, "a.b", std::make_shared<Variable>(3)));
+  EXPECT(set(copy, "a.b", std::make_shared<Variable>(4)));
+  EXPECT(*original == *expected);
+  EXPECT(property.match(copy)->integerValue == 4);
+  EXPECT(property.match(copy2)->integerValue == 3);
+}
+
+TEST(messagePropertySetOnCopyLeavesOriginalUnchanged) {
+  auto original = createMessage();
+  auto expected = std::make_shared<Variable>(*original);
+  auto copy = Variable::createCopyOnWrite(*original);
+  MessageProperty property("list[0].value");
+  auto value = std::make_shared<Variable>(42);
+  EXPECT(property.set(copy, value));
+  EXPECT(*original == *expected);
+  EXPECT(property.match(copy)->integerValue == 42);
+}
+
+TEST(setCowResultIsIsolated) {
+  auto original = createMessage();
+  auto expected = std::make_shared<Variable>(*original);
+  MessageProperty property("a.e");
+  auto result = property.setCow(original, std::make_shared<Variable>(true));
+  EXPECT(*original == *expected);
+  EXPECT(result->structValue.view().at("a")->structValue.view().at("e")->booleanValue);
+  //Elements next to the path stay shared, set() detaches them.
+  EXPECT(result->structValue.view().at("big") == original->structValue.view().at("big"));
+  EXPECT(set(result, "a.b", std::make_shared<Variable>(8)));
+  EXPECT(set(result, "list[1]", std::make_shared<Variable>("z")));
+  EXPECT(*original == *expected);
+}
+
+TEST(movedCopyStaysCopyOnWrite) {
+  auto original = createMessage();
+  auto expected = std::make_shared<Variable>(*original);
+  auto copy = Variable::createCopyOnWrite(*original);
+  Variable moved(std::move(*copy));
+  moved.structValue->erase("a");
+  EXPECT(moved.structValue.sharesElements());
+  Variable assigned;
+  assigned = std::move(moved);
+  assigned.structValue->erase("list");
+  EXPECT(*original == *expected);
+  EXPECT(assigned.structValue.view().size() == 1);
+}
+
+TEST(frozenFlagSurvivesMove) {
+  auto original = createMessage();
+  original->freeze();
+  Variable moved(std::move(*Variable::createCopyOnWrite(*original)));
+  EXPECT(!moved.structValue.frozen());
+  LazyContainer<Struct> container(std::move(original->structValue));
+  EXPECT(container.frozen());
+  EXPECT(original->structValue.frozen());
+}
+
+TEST(variableFitsIn128Bytes) {
+  //The flags of the lazy containers share their tail padding with the small members of Variable. Only compilers
+  //implementing [[no_unique_address]] can do that.
+#if defined(__GNUC__) && !defined(_MSC_VER)
+  if (sizeof(void *) == 8) EXPECT(sizeof(Variable) <= 128);
+#endif
+}
+
+int main() {
+  return Test::run();
+}
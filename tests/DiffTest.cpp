@@ -0,0 +1,175 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "Test.h"
+#include "../src/JsonDecoder.h"
+#include "../src/JsonEncoder.h"
+#include "../src/Variable.h"
+
+using namespace Flows;
+
+namespace {
+
+PVariable json(const std::string &text) {
+  return JsonDecoder::decode(text);
+}
+
+//Checks that applying diff(from, to) to a copy of "from" gives "to".
+bool roundTrips(const std::string &from, const std::string &to) {
+  auto fromVariable = json(from);
+  auto toVariable = json(to);
+  auto patch = Variable::diff(fromVariable, toVariable);
+  auto result = std::make_shared<Variable>(*fromVariable);
+  return result->apply(patch) && result->equivalent(*toVariable);
+}
+
+}
+
+TEST(equalValuesGiveEmptyPatch) {
+  auto value = json(R"({"a": [1, 2, {"b": "c"}], "d": null})");
+  auto patch = Variable::diff(value, std::make_shared<Variable>(*value));
+  EXPECT(patch->type == VariableType::tArray && patch->arrayValue->empty());
+  EXPECT(Variable::diff(value, value)->arrayValue->empty());
+}
+
+TEST(structChangesGiveAddRemoveAndReplace) {
+  auto patch = Variable::diff(json(R"({"a": 1, "b": 2, "c": {"d": 3}})"), json(R"({"b": 2, "c": {"d": 4}, "e": 5})"));
+  EXPECT(*patch == *json(R"([{"op": "remove", "path": "/a"}, {"op": "replace", "path": "/c/d", "value": 4}, {"op": "add", "path": "/e", "value": 5}])"));
+}
+
+TEST(arraysAreComparedByIndex) {
+  auto patch = Variable::diff(json("[1, 2, 3, 4]"), json("[1, 5]"));
+  //Removed from the back, so the indexes stay valid while applying.
+  EXPECT(*patch == *json(R"([{"op": "replace", "path": "/1", "value": 5}, {"op": "remove", "path": "/3"}, {"op": "remove", "path": "/2"}])"));
+  patch = Variable::diff(json("[1]"), json("[1, [2]]"));
+  EXPECT(*patch == *json(R"([{"op": "add", "path": "/1", "value": [2]}])"));
+}
+
+TEST(typeChangesReplaceTheValue) {
+  auto patch = Variable::diff(json(R"({"a": [1]})"), json(R"({"a": {"b": 1}})"));
+  EXPECT(*patch == *json(R"([{"op": "replace", "path": "/a", "value": {"b": 1}}])"));
+  patch = Variable::diff(json("[1]"), json("2"));
+  EXPECT(*patch == *json(R"([{"op": "replace", "path": "", "value": 2}])"));
+}
+
+TEST(keysAreEscaped) {
+  auto patch = Variable::diff(json(R"({"a/b": 1, "c~d": 2})"), json(R"({"a/b": 3, "c~d": 4})"));
+  EXPECT(patch->arrayValue->at(0)->structValue->at("path")->stringValue == "/a~1b");
+  EXPECT(patch->arrayValue->at(1)->structValue->at("path")->stringValue == "/c~0d");
+  EXPECT(roundTrips(R"({"a/b": 1, "c~d": 2})", R"({"a/b": 3, "c~d": 4, "~/": 5})"));
+}
+
+TEST(applyingDiffGivesTarget) {
+  EXPECT(roundTrips(R"({"a": 1, "b": [1, 2, {"c": 3}]})", R"({"a": 2, "b": [1, {"c": 3}], "d": "e"})"));
+  EXPECT(roundTrips("[[1, 2], [3]]", "[[1], [3, 4], 5]"));
+  EXPECT(roundTrips(R"({"a": {"b": {"c": {"d": 1}}}})", R"({"a": {"b": {"c": {"d": 2, "e": null}}}})"));
+  EXPECT(roundTrips("{}", R"({"a": [true, false]})"));
+  EXPECT(roundTrips(R"({"a": 1})", "null"));
+  EXPECT(roundTrips("[]", "[]"));
+}
+
+TEST(applySupportsJsonPatchOperations) {
+  auto value = json(R"({"a": [1, 3], "b": {"c": 1}})");
+  EXPECT(value->apply(json(R"([{"op": "add", "path": "/a/1", "value": 2}, {"op": "add", "path": "/a/-", "value": 4}, {"op": "add", "path": "/b/c", "value": 2}, {"op": "remove", "path": "/b"}])")));
+  EXPECT(*value == *json(R"({"a": [1, 2, 3, 4]})"));
+  EXPECT(value->apply(json(R"([{"op": "replace", "path": "", "value": "x"}])")));
+  EXPECT(value->type == VariableType::tString && value->stringValue == "x");
+}
+
+TEST(applyRejectsInvalidOperations) {
+  auto original = json(R"({"a": [1, 2], "b": {"c": 1}})");
+  for (auto &patch : {R"({"op": "add", "path": "/a"})",
+                      R"([{"op": "move", "path": "/a", "value": 1}])",
+                      R"([{"path": "/a", "value": 1}])",
+                      R"([{"op": "add", "value": 1}])",
+                      R"([{"op": "add", "path": "a", "value": 1}])",
+                      R"([{"op": "add", "path": "/a"}])",
+                      R"([{"op": "remove", "path": ""}])",
+                      R"([{"op": "remove", "path": "/x"}])",
+                      R"([{"op": "replace", "path": "/x/y", "value": 1}])",
+                      R"([{"op": "replace", "path": "/a/2", "value": 1}])",
+                      R"([{"op": "replace", "path": "/a/01", "value": 1}])",
+                      R"([{"op": "replace", "path": "/a/-1", "value": 1}])",
+                      R"([{"op": "replace", "path": "/a/+1", "value": 1}])",
+                      R"([{"op": "replace", "path": "/a/1a", "value": 1}])",
+                      R"([{"op": "replace", "path": "/a/", "value": 1}])",
+                      R"([{"op": "replace", "path": "/a/18446744073709551616", "value": 1}])",
+                      R"([{"op": "replace", "path": "/a/99999999999999999999999", "value": 1}])",
+                      R"([{"op": "remove", "path": "/a/99999999999999999999999"}])",
+                      R"([{"op": "add", "path": "/a/99999999999999999999999", "value": 1}])",
+                      R"([{"op": "add", "path": "/a/99999999999999999999999/b", "value": 1}])",
+                      R"([{"op": "add", "path": "/a/3", "value": 1}])",
+                      R"([{"op": "add", "path": "/b/c/d", "value": 1}])",
+                      R"([{"op": "add", "path": "/b~2", "value": 1}])"}) {
+    auto value = std::make_shared<Variable>(*original);
+    EXPECT(!value->apply(json(patch)));
+    EXPECT(*value == *original);
+  }
+  EXPECT(!original->apply(PVariable()));
+}
+
+TEST(applyRejectsIndexOverflow) {
+  //Used to wrap to 0 and replace the first element.
+  auto value = json("[1, 2, 3]");
+  EXPECT(!value->apply(json(R"([{"op": "replace", "path": "/99999999999999999999999", "value": 7}])")));
+  EXPECT(*value == *json("[1, 2, 3]"));
+  EXPECT(value->apply(json(R"([{"op": "replace", "path": "/2", "value": 7}])")));
+  EXPECT(*value == *json("[1, 2, 7]"));
+}
+
+TEST(applyLeavesSharedOriginalUnchanged) {
+  auto original = json(R"({"a": {"b": [1, 2]}, "c": {"d": 1}})");
+  auto expected = std::make_shared<Variable>(*original);
+  auto copy = Variable::createCopyOnWrite(*original);
+  EXPECT(copy->apply(json(R"([{"op": "replace", "path": "/a/b/0", "value": 5}, {"op": "remove", "path": "/c/d"}])")));
+  EXPECT(*original == *expected);
+  EXPECT(*copy == *json(R"({"a": {"b": [5, 2]}, "c": {}})"));
+}
+
+TEST(applyToFrozenVariableFails) {
+  auto value = json(R"({"a": 1})");
+  value->freeze();
+  EXPECT(!value->apply(json(R"([{"op": "replace", "path": "/a", "value": 2}])")));
+  EXPECT(value->structValue.view().at("a")->integerValue == 1);
+}
+
+TEST(applyDetachesFrozenElements) {
+  auto element = json(R"({"b": 1})");
+  element->freeze();
+  auto value = std::make_shared<Variable>(VariableType::tStruct);
+  value->structValue->emplace("a", element);
+  EXPECT(value->apply(json(R"([{"op": "replace", "path": "/a/b", "value": 2}])")));
+  EXPECT(element->structValue.view().at("b")->integerValue == 1);
+  EXPECT(value->structValue.view().at("a")->structValue.view().at("b")->integerValue == 2);
+}
+
+int main() {
+  return Test::run();
+}
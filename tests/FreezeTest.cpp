@@ -0,0 +1,311 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "Test.h"
+#include "../src/JsonEncoder.h"
+#include "../src/MessageProperty.h"
+#include "../src/MessageQuery.h"
+#include "../src/RpcEncoder.h"
+#include "../src/Statistics.h"
+#include "../src/Variable.h"
+
+using namespace Flows;
+
+namespace {
+
+//{"payload": {"values": [1, 2.5, 3], "name": "sensor"}, "empty": [], "unallocated": {}}
+PVariable createMessage() {
+  auto message = std::make_shared<Variable>(VariableType::tStruct);
+  auto payload = std::make_shared<Variable>(VariableType::tStruct);
+  auto values = std::make_shared<Variable>(VariableType::tArray);
+  values->arrayValue->push_back(std::make_shared<Variable>(1));
+  values->arrayValue->push_back(std::make_shared<Variable>(2.5));
+  values->arrayValue->push_back(std::make_shared<Variable>(3));
+  payload->structValue->emplace("values", values);
+  payload->structValue->emplace("name", std::make_shared<Variable>("sensor"));
+  message->structValue->emplace("payload", payload);
+  message->structValue->emplace("empty", std::make_shared<Variable>(VariableType::tArray));
+  message->structValue->emplace("unallocated", std::make_shared<Variable>(VariableType::tStruct));
+  return message;
+}
+
+//MessageProperty::set() takes the value by non-const reference.
+bool set(PVariable &message, const std::string &property, PVariable value) {
+  return MessageProperty(property).set(message, value);
+}
+
+}
+
+TEST(freezeMarksWholeTree) {
+  auto message = createMessage();
+  message->freeze();
+  EXPECT(message->isFrozen());
+  EXPECT(message->structValue.view().at("payload")->isFrozen());
+  EXPECT(message->structValue.view().at("payload")->structValue.view().at("values")->arrayValue.view().at(0)->isFrozen());
+}
+
+TEST(modifyingFrozenStructThrows) {
+  auto message = createMessage();
+  auto expected = std::make_shared<Variable>(*message);
+  message->freeze();
+  EXPECT_THROW(message->structValue->clear(), FrozenVariableException);
+  EXPECT_THROW((*message->structValue)["new"], FrozenVariableException);
+  EXPECT_THROW((*message->structValue)["payload"], FrozenVariableException);
+  EXPECT_THROW(message->structValue->emplace("new", std::make_shared<Variable>(1)), FrozenVariableException);
+  EXPECT_THROW(message->structValue->insert_or_assign("payload", std::make_shared<Variable>(1)), FrozenVariableException);
+  EXPECT_THROW(message->structValue->erase("payload"), FrozenVariableException);
+  EXPECT_THROW(message->structValue->erase(message->structValue->begin()), FrozenVariableException);
+  EXPECT_THROW(*message->structValue = Struct(), FrozenVariableException);
+  Struct other;
+  EXPECT_THROW(message->structValue->swap(other), FrozenVariableException);
+  //Containers that were never allocated throw as well instead of handing out a container that drops writes.
+  auto &unallocated = message->structValue.view().at("unallocated");
+  EXPECT_THROW(unallocated->structValue->emplace("a", std::make_shared<Variable>(1)), FrozenVariableException);
+  EXPECT(!unallocated->structValue.allocated());
+  EXPECT(unallocated->structValue->empty());
+  EXPECT(*message == *expected);
+}
+
+TEST(nonConstReadsOfFrozenMessageWork) {
+  auto message = createMessage();
+  message->freeze();
+  //Nodes get messages as const PVariable&, which allows non-const access to the Variable.
+  const PVariable &received = message;
+  auto payloadIterator = received->structValue->find("payload");
+  EXPECT(payloadIterator != received->structValue->end());
+  auto &payload = payloadIterator->second;
+  EXPECT(payload->structValue->at("name")->stringValue == "sensor");
+  EXPECT(payload->structValue->count("values") == 1);
+  auto &values = payload->structValue->at("values");
+  EXPECT(values->arrayValue->size() == 3);
+  EXPECT(values->arrayValue->at(1)->floatValue == 2.5);
+  size_t count = 0;
+  for (auto &element : *received->structValue) {
+    if (element.second) count++;
+  }
+  EXPECT(count == 3);
+  EXPECT(received->structValue.get() == &received->structValue.view());
+
+  //Unallocated containers read as empty and stay unallocated.
+  auto &unallocated = received->structValue->at("unallocated");
+  EXPECT(unallocated->structValue->empty());
+  EXPECT(unallocated->arrayValue->empty());
+  EXPECT(!unallocated->structValue.allocated());
+  EXPECT(!unallocated->arrayValue.allocated());
+
+  //Converting to PStruct or PArray hands out a writable copy.
+  PStruct structValue = received->structValue;
+  EXPECT(structValue.get() != &received->structValue.view());
+  EXPECT(structValue->find("payload")->second == payload);
+  structValue->emplace("new", std::make_shared<Variable>(1));
+  structValue->erase("payload");
+  PArray array = values->arrayValue;
+  array->push_back(std::make_shared<Variable>(4));
+  EXPECT(received->structValue.view().size() == 3);
+  EXPECT(received->structValue.view().count("payload") == 1);
+  EXPECT(values->arrayValue.view().size() == 3);
+}
+
+TEST(constAccessToFrozenContainerWorks) {
+  auto message = createMessage();
+  message->freeze();
+  const Variable &constMessage = *message;
+  EXPECT(constMessage.structValue->size() == 3);
+  EXPECT(message->structValue.view().size() == 3);
+  EXPECT(message->structValue.view().at("unallocated")->arrayValue.view().empty());
+}
+
+TEST(readingFrozenTreeWithLibraryFunctionsWorks) {
+  auto message = createMessage();
+  auto expected = std::make_shared<Variable>(*message);
+  message->freeze();
+  EXPECT(*message == *expected);
+  EXPECT(message->hash() == expected->hash());
+  EXPECT(message->memoryUsage() > 0);
+  EXPECT(message->estimateMemoryUsage() > 0);
+  EXPECT(!message->print(false, false, true).empty());
+  EXPECT(JsonEncoder::getString(message) == JsonEncoder::getString(expected));
+  std::vector<char> encoded;
+  RpcEncoder rpcEncoder;
+  rpcEncoder.encodeResponse(message, encoded);
+  EXPECT(!encoded.empty());
+  Variable copy(*message);
+  EXPECT(copy == *expected);
+  EXPECT(!copy.isFrozen());
+  EXPECT(!(*message < *expected));
+  EXPECT(*message <= *expected);
+  EXPECT(Variable::diff(message, expected)->arrayValue.view().empty());
+  EXPECT(Variable::diff(expected, message)->arrayValue.view().empty());
+
+  auto values = message->structValue.view().at("payload")->structValue.view().at("values");
+  EXPECT(Statistics::calculate(values).count == 3);
+  EXPECT(values->toArray()->size() == 3);
+
+  MessageProperty property("payload.values[1]");
+  EXPECT(property.match(message)->floatValue == 2.5);
+  MessagePropertySet propertySet;
+  propertySet.add("payload.name");
+  propertySet.add("payload.values[0]");
+  std::vector<PVariable> results;
+  propertySet.match(message, results);
+  EXPECT(results.size() == 2 && results.at(0)->stringValue == "sensor" && results.at(1)->integerValue == 1);
+  MessageQuery query("..values[*]");
+  query.match(message, results);
+  EXPECT(results.size() == 3);
+}
+
+TEST(applyingFrozenPatchWorks) {
+  auto from = createMessage();
+  auto to = createMessage();
+  to->structValue->at("payload")->structValue->at("name")->stringValue = "changed";
+  auto patch = Variable::diff(from, to);
+  patch->freeze();
+  EXPECT(from->apply(patch));
+  EXPECT(*from == *to);
+}
+
+TEST(writingThroughDetachedCopyLeavesFrozenTreeUnchanged) {
+  auto message = createMessage();
+  auto expected = std::make_shared<Variable>(*message);
+  message->freeze();
+  auto copy = message;
+  Variable::detach(copy);
+  EXPECT(copy != message);
+  EXPECT(!copy->isFrozen());
+  EXPECT(set(copy, "payload.values[0]", std::make_shared<Variable>(10)));
+  copy->structValue->emplace("new", std::make_shared<Variable>(true));
+  EXPECT(*message == *expected);
+  EXPECT(copy->structValue.view().size() == 4);
+}
+
+TEST(messagePropertySetOnFrozenMessageDetaches) {
+  auto message = createMessage();
+  auto expected = std::make_shared<Variable>(*message);
+  message->freeze();
+  auto frozen = message;
+  MessageProperty property("payload.values[2]");
+  auto value = std::make_shared<Variable>(7);
+  EXPECT(property.set(message, value));
+  EXPECT(message != frozen);
+  EXPECT(*frozen == *expected);
+  EXPECT(property.match(message)->integerValue == 7);
+  auto result = property.setCow(frozen, value);
+  EXPECT(*frozen == *expected);
+  EXPECT(property.match(result)->integerValue == 7);
+}
+
+TEST(applyToFrozenVariableFails) {
+  auto message = createMessage();
+  auto patch = Variable::diff(message, std::make_shared<Variable>(VariableType::tStruct));
+  message->freeze();
+  EXPECT(!message->apply(patch));
+}
+
+TEST(copiesOfFrozenContainerStayFrozen) {
+  auto message = createMessage();
+  message->freeze();
+  auto &payload = message->structValue.view().at("payload");
+  auto structValue = payload->structValue;
+  EXPECT(structValue.frozen());
+  EXPECT_THROW(structValue->clear(), FrozenVariableException);
+  LazyContainer<Struct> assigned;
+  assigned = payload->structValue;
+  EXPECT(assigned.frozen());
+  EXPECT_THROW(assigned->clear(), FrozenVariableException);
+  LazyContainer<Struct> moved(std::move(payload->structValue));
+  EXPECT(moved.frozen());
+  EXPECT_THROW(moved->clear(), FrozenVariableException);
+  EXPECT(payload->structValue.view().size() == 2);
+  auto &values = payload->structValue.view().at("values");
+  LazyContainer<Array> movedArray(std::move(values->arrayValue));
+  EXPECT(movedArray.frozen());
+  EXPECT(values->arrayValue.view().size() == 3);
+}
+
+TEST(copyOnWriteCopiesOfFrozenStructsAreWritable) {
+  auto message = createMessage();
+  message->freeze();
+  auto copy = Variable::createCopyOnWrite(*message);
+  message.reset();
+  //The frozen struct is copied even though the copy is its only owner now.
+  copy->structValue->emplace("new", std::make_shared<Variable>(1));
+  EXPECT(copy->structValue.view().size() == 4);
+}
+
+TEST(assignmentToFrozenVariableThrows) {
+  auto message = createMessage();
+  auto expected = std::make_shared<Variable>(*message);
+  message->freeze();
+  Variable replacement(std::string("replacement"));
+  EXPECT_THROW(*message = replacement, FrozenVariableException);
+  EXPECT_THROW(*message = Variable(1), FrozenVariableException);
+  EXPECT_THROW(message->structValue = std::make_shared<Struct>(), FrozenVariableException);
+  EXPECT_THROW(message->structValue.reset(), FrozenVariableException);
+  auto &name = message->structValue.view().at("payload")->structValue.view().at("name");
+  EXPECT_THROW(*name = replacement, FrozenVariableException);
+  EXPECT(message->isFrozen());
+  EXPECT(*message == *expected);
+}
+
+TEST(movingFromFrozenVariableLeavesItUnchanged) {
+  auto message = createMessage();
+  auto expected = std::make_shared<Variable>(*message);
+  message->freeze();
+  Variable assigned;
+  assigned = std::move(*message);
+  EXPECT(!assigned.isFrozen());
+  EXPECT(assigned == *expected);
+  EXPECT(*message == *expected);
+  assigned.structValue->erase("empty");
+  EXPECT(*message == *expected);
+  EXPECT(assigned.structValue.view().size() == 2);
+}
+
+TEST(moveConstructingFromFrozenVariableLeavesItUnchanged) {
+  auto message = createMessage();
+  auto expected = std::make_shared<Variable>(*message);
+  message->freeze();
+  auto &name = message->structValue.view().at("payload")->structValue.view().at("name");
+  Variable movedName(std::move(*name));
+  EXPECT(!movedName.isFrozen());
+  EXPECT(movedName.stringValue == "sensor");
+  EXPECT(name->stringValue == "sensor");
+  Variable moved(std::move(*message));
+  EXPECT(!moved.isFrozen());
+  EXPECT(moved == *expected);
+  EXPECT(*message == *expected);
+  moved.structValue->erase("empty");
+  EXPECT(*message == *expected);
+  EXPECT(moved.structValue.view().size() == 2);
+}
+
+int main() {
+  return Test::run();
+}
@@ -0,0 +1,97 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "Test.h"
+#include "../src/JsonDecoder.h"
+#include "../src/Variable.h"
+
+#include <unordered_set>
+
+using namespace Flows;
+
+namespace {
+
+PVariable json(const std::string &text) {
+  return JsonDecoder::decode(text);
+}
+
+}
+
+TEST(voidVariablesAreNeverEqual) {
+  Variable a;
+  Variable b;
+  EXPECT(!(a == b));
+  EXPECT(a != b);
+  EXPECT(!(a == a));
+  EXPECT(*json(R"({"a": null})") != *json(R"({"a": null})"));
+  EXPECT(*json("[1, null]") != *json("[1, null]"));
+  EXPECT(Variable(VariableType::tVariant) != Variable(VariableType::tVariant));
+}
+
+TEST(equivalentTreatsVoidsAsEqual) {
+  EXPECT(Variable().equivalent(Variable()));
+  EXPECT(json(R"({"a": null, "b": [1, null]})")->equivalent(*json(R"({"b": [1, null], "a": null})")));
+  EXPECT(!json(R"({"a": null})")->equivalent(*json(R"({"a": 0})")));
+  EXPECT(!json("[null]")->equivalent(*json("[]")));
+  //Otherwise like operator==.
+  EXPECT(json(R"({"a": [1, 2.5, "x", true]})")->equivalent(*json(R"({"a": [1, 2.5, "x", true]})")));
+  EXPECT(!json("[1]")->equivalent(*json("[1.0]")));
+}
+
+TEST(equalVariablesHaveEqualHashes) {
+  for (auto &text : {"1", "2.5", "\"x\"", "true", "null", "[]", "{}", R"({"a": [1, {"b": null}], "c": "d"})"}) {
+    EXPECT(json(text)->hash() == json(text)->hash());
+  }
+  EXPECT(Variable(0.0).hash() == Variable(-0.0).hash());
+  EXPECT(json(R"({"a": 1, "b": 2})")->hash() == json(R"({"b": 2, "a": 1})")->hash());
+  EXPECT(json("[1, 2]")->hash() != json("[2, 1]")->hash());
+  EXPECT(json(R"({"a": 1})")->hash() != json(R"({"a": 2})")->hash());
+}
+
+TEST(unorderedSetFindsTreesWithVoids) {
+  std::unordered_set<PVariable, PVariableHash, PVariableEqual> set;
+  set.insert(json(R"({"a": null})"));
+  set.insert(json("[1, 2]"));
+  EXPECT(set.count(json(R"({"a": null})")) == 1);
+  EXPECT(set.count(json("[1, 2]")) == 1);
+  EXPECT(set.count(json("[1, 3]")) == 0);
+  set.insert(json(R"({"a": null})"));
+  EXPECT(set.size() == 2);
+}
+
+TEST(diffTreatsVoidsAsUnchanged) {
+  EXPECT(Variable::diff(json(R"({"a": null, "b": [null]})"), json(R"({"a": null, "b": [null]})"))->arrayValue->empty());
+  EXPECT(Variable::diff(json("null"), json("null"))->arrayValue->empty());
+  EXPECT(Variable::diff(json(R"({"a": null})"), json(R"({"a": 1})"))->arrayValue->size() == 1);
+}
+
+int main() {
+  return Test::run();
+}
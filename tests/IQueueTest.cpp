@@ -0,0 +1,207 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "Test.h"
+#include "../src/IQueue.h"
+
+#include <chrono>
+#include <future>
+
+using namespace Flows;
+
+namespace {
+
+class Entry : public IQueueEntry {
+ public:
+  explicit Entry(size_t bytes) : _bytes(bytes) {}
+  size_t memoryUsage() const override { return _bytes; }
+ private:
+  size_t _bytes;
+};
+
+//Blocks in processQueueEntry() until release() is called, so tests control what stays in the queue.
+class Queue : public IQueue {
+ public:
+  Queue(std::shared_ptr<Output> &output, uint32_t bufferSize) : IQueue(output, 1, bufferSize) {}
+  ~Queue() override {
+    release();
+    stopQueue(0);
+  }
+
+  bool enqueue(size_t bytes, bool waitWhenFull = false) {
+    std::shared_ptr<IQueueEntry> entry = std::make_shared<Entry>(bytes);
+    return IQueue::enqueue(0, entry, waitWhenFull);
+  }
+
+  void processQueueEntry(int32_t, std::shared_ptr<IQueueEntry> &) override {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _started++;
+    _conditionVariable.notify_all();
+    _conditionVariable.wait(lock, [&] { return _released; });
+    _processed++;
+    _conditionVariable.notify_all();
+  }
+
+  void release() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _released = true;
+    _conditionVariable.notify_all();
+  }
+
+  void waitForStarted(uint32_t count) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _conditionVariable.wait(lock, [&] { return _started >= count; });
+  }
+
+  void waitForProcessed(uint32_t count) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _conditionVariable.wait(lock, [&] { return _processed >= count; });
+  }
+ private:
+  std::mutex _mutex;
+  std::condition_variable _conditionVariable;
+  bool _released = false;
+  uint32_t _started = 0;
+  uint32_t _processed = 0;
+};
+
+std::shared_ptr<Output> createOutput() {
+  std::string nodeId = "test";
+  return std::make_shared<Output>(nodeId, nullptr);
+}
+
+}
+
+TEST(noByteLimitByDefault) {
+  auto output = createOutput();
+  Queue queue(output, 3);
+  queue.startQueue(0, false, 0);
+  EXPECT(queue.enqueue(1000000));
+  EXPECT(queue.enqueue(1000000));
+  EXPECT(queue.enqueue(1000000));
+  EXPECT(!queue.enqueue(1));
+  EXPECT(queue.queueBytes(0) == 0);
+}
+
+TEST(rejectsEntriesOverTheByteLimit) {
+  auto output = createOutput();
+  Queue queue(output, 100);
+  queue.setMaxBytes(0, 100);
+  queue.startQueue(0, false, 0);
+  EXPECT(queue.enqueue(60));
+  EXPECT(!queue.enqueue(60));
+  EXPECT(queue.queueBytes(0) == 60);
+  EXPECT(queue.enqueue(40));
+  EXPECT(queue.queueBytes(0) == 100);
+  EXPECT(!queue.enqueue(1));
+  EXPECT(queue.enqueue(0));
+}
+
+TEST(emptyQueueAcceptsLargeEntry) {
+  auto output = createOutput();
+  Queue queue(output, 100);
+  queue.setMaxBytes(0, 100);
+  queue.startQueue(0, false, 0);
+  EXPECT(queue.enqueue(500));
+  EXPECT(queue.queueBytes(0) == 500);
+  EXPECT(!queue.enqueue(1));
+}
+
+TEST(entryLimitStillApplies) {
+  auto output = createOutput();
+  Queue queue(output, 2);
+  queue.setMaxBytes(0, 100);
+  queue.startQueue(0, false, 0);
+  EXPECT(queue.enqueue(1));
+  EXPECT(queue.enqueue(1));
+  EXPECT(!queue.enqueue(1));
+  EXPECT(queue.queueBytes(0) == 2);
+}
+
+TEST(invalidIndexes) {
+  auto output = createOutput();
+  Queue queue(output, 10);
+  queue.setMaxBytes(-1, 100);
+  queue.setMaxBytes(1, 100);
+  EXPECT(queue.queueBytes(-1) == 0);
+  EXPECT(queue.queueBytes(1) == 0);
+}
+
+TEST(processingFreesBytes) {
+  auto output = createOutput();
+  Queue queue(output, 100);
+  queue.setMaxBytes(0, 100);
+  queue.startQueue(0, false, 1);
+  EXPECT(queue.enqueue(60));
+  //The first entry is removed from the queue before it is processed.
+  queue.waitForStarted(1);
+  EXPECT(queue.queueBytes(0) == 0);
+  EXPECT(queue.enqueue(60));
+  EXPECT(!queue.enqueue(60));
+  EXPECT(queue.queueBytes(0) == 60);
+  queue.release();
+  queue.waitForProcessed(2);
+  EXPECT(queue.queueBytes(0) == 0);
+  EXPECT(queue.enqueue(60));
+  EXPECT(queue.enqueue(40));
+}
+
+TEST(waitsForBytesWhenFull) {
+  auto output = createOutput();
+  Queue queue(output, 100);
+  queue.setMaxBytes(0, 100);
+  queue.startQueue(0, false, 1);
+  EXPECT(queue.enqueue(60));
+  queue.waitForStarted(1);
+  EXPECT(queue.enqueue(60));
+  auto waiting = std::async(std::launch::async, [&] { return queue.enqueue(60, true); });
+  EXPECT(waiting.wait_for(std::chrono::milliseconds(50)) == std::future_status::timeout);
+  queue.release();
+  EXPECT(waiting.get());
+  queue.waitForProcessed(3);
+  EXPECT(queue.queueBytes(0) == 0);
+}
+
+TEST(restartResetsBytes) {
+  auto output = createOutput();
+  Queue queue(output, 100);
+  queue.setMaxBytes(0, 100);
+  queue.startQueue(0, false, 0);
+  EXPECT(queue.enqueue(80));
+  queue.stopQueue(0);
+  EXPECT(queue.queueBytes(0) == 0);
+  queue.startQueue(0, false, 0);
+  EXPECT(queue.enqueue(80));
+  EXPECT(queue.queueBytes(0) == 80);
+}
+
+int main() {
+  return Test::run();
+}
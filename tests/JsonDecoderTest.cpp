@@ -0,0 +1,160 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "Test.h"
+#include "../src/Arena.h"
+#include "../src/JsonDecoder.h"
+#include "../src/JsonEncoder.h"
+
+#include <random>
+
+using namespace Flows;
+
+namespace {
+
+//decode(json, bytesRead) always uses the character by character decoder.
+PVariable decodeWithFallback(const std::string &json) {
+  uint32_t bytesRead = 0;
+  return JsonDecoder::decode(json, bytesRead);
+}
+
+//Both stages of the indexed decoder and the fallback give the same result.
+bool decodersAgree(const std::string &json) {
+  auto indexed = JsonDecoder::decode(json);
+  auto fallback = decodeWithFallback(json);
+  auto arena = JsonDecoder::decode(json, std::make_shared<Arena>());
+  return indexed->equivalent(*fallback) && indexed->equivalent(*arena);
+}
+
+//The root is always an array or a struct, because JsonEncoder::getString() wraps other values in an array.
+PVariable createRandomVariable(std::mt19937 &random, uint32_t depth) {
+  auto type = depth == 0 ? 5 + random() % 2 : random() % (depth < 4 ? 7 : 5);
+  if (type == 0) return std::make_shared<Variable>();
+  if (type == 1) return std::make_shared<Variable>((bool)(random() % 2));
+  if (type == 2) return std::make_shared<Variable>((int32_t)random());
+  if (type == 3) return std::make_shared<Variable>((int64_t)random() << 20);
+  if (type == 4) {
+    const std::string alphabet = "ab \"\\/\n\t{}[],:";
+    std::string s;
+    for (auto i = random() % 20; i > 0; i--) {
+      s.push_back(alphabet[random() % alphabet.size()]);
+    }
+    return std::make_shared<Variable>(s);
+  }
+  auto container = std::make_shared<Variable>(type == 5 ? VariableType::tArray : VariableType::tStruct);
+  for (auto i = random() % 10; i > 0; i--) {
+    auto element = createRandomVariable(random, depth + 1);
+    if (type == 5) container->arrayValue->push_back(element);
+    else container->structValue->insert_or_assign("key" + std::to_string(random() % 40), element);
+  }
+  return container;
+}
+
+}
+
+TEST(decodesAllTypes) {
+  auto value = JsonDecoder::decode(R"({"a": null, "b": true, "c": false, "d": -12, "e": 12345678901, "f": 1.5e3, "g": "x\"\\\/\n\tä", "h": [], "i": {}})");
+  auto &s = value->structValue.view();
+  EXPECT(value->type == VariableType::tStruct && s.size() == 9);
+  EXPECT(s.at("a")->type == VariableType::tVoid);
+  EXPECT(s.at("b")->type == VariableType::tBoolean && s.at("b")->booleanValue);
+  EXPECT(s.at("c")->type == VariableType::tBoolean && !s.at("c")->booleanValue);
+  EXPECT(s.at("d")->type == VariableType::tInteger && s.at("d")->integerValue == -12);
+  EXPECT(s.at("e")->type == VariableType::tInteger64 && s.at("e")->integerValue64 == 12345678901);
+  EXPECT(s.at("f")->type == VariableType::tFloat && s.at("f")->floatValue == 1500);
+  EXPECT(s.at("g")->type == VariableType::tString && s.at("g")->stringValue == "x\"\\/\n\t\xC3\xA4");
+  EXPECT(s.at("h")->type == VariableType::tArray && s.at("h")->arrayValue.view().empty());
+  EXPECT(s.at("i")->type == VariableType::tStruct && s.at("i")->structValue.view().empty());
+}
+
+TEST(decodersAgreeOnValidJson) {
+  for (auto &json : {"null", "true", "-0", "1.25", "\"\"", "[]", "{}", " [ 1 , [ [ ] ] , { \"a\" : { } } ] ", "\n{\"a\":\t[true,false,null]}\r\n",
+                     R"(["Aä€", "\\\"", "a\/b"])", R"({"z": 1, "a": 2, "m": [3, {"b": 4}]})"}) {
+    EXPECT(decodersAgree(json));
+  }
+}
+
+TEST(decodersAgreeOnRandomJson) {
+  std::mt19937 random(7);
+  for (uint32_t i = 0; i < 300; i++) {
+    auto variable = createRandomVariable(random, 0);
+    auto json = JsonEncoder::getString(variable);
+    EXPECT(decodersAgree(json));
+    EXPECT(JsonDecoder::decode(json)->equivalent(*variable));
+  }
+}
+
+TEST(largeStructsAreDecoded) {
+  std::string json = "{";
+  for (uint32_t i = 0; i < 1000; i++) {
+    json += (i == 0 ? "\"" : ", \"") + std::to_string(999 - i) + "\": " + std::to_string(i);
+  }
+  json += "}";
+  auto value = JsonDecoder::decode(json);
+  EXPECT(value->structValue.view().size() == 1000);
+  EXPECT(value->structValue.view().at("0")->integerValue == 999);
+  EXPECT(value->structValue.view().at("999")->integerValue == 0);
+  EXPECT(decodersAgree(json));
+}
+
+TEST(fallbackHandlesTrailingData) {
+  EXPECT(*JsonDecoder::decode("[1, 2] x") == *JsonDecoder::decode("[1, 2]"));
+  uint32_t bytesRead = 0;
+  EXPECT(*JsonDecoder::decode(std::string("{\"a\": 1} {\"b\": 2}"), bytesRead) == *JsonDecoder::decode("{\"a\": 1}"));
+  EXPECT(bytesRead == 8);
+}
+
+TEST(fallbackHandlesToleratedDeviations) {
+  //Object names without value.
+  EXPECT(JsonDecoder::decode(R"({"a", "b": 1})")->equivalent(*JsonDecoder::decode(R"({"a": null, "b": 1})")));
+  //Everything that is no JSON value at all is returned as string.
+  auto value = JsonDecoder::decode("abc");
+  EXPECT(value->type == VariableType::tString && value->stringValue == "abc");
+  EXPECT(JsonDecoder::decode("")->type == VariableType::tVoid);
+  EXPECT(JsonDecoder::decode("  ")->type == VariableType::tVoid);
+}
+
+TEST(invalidJsonThrows) {
+  for (auto &json : {"[1, 2", "[1,]", "{\"a\": 1,}", "\"abc", "{\"a\" 1}", "[true false]", "{1: 2}"}) {
+    EXPECT_THROW(JsonDecoder::decode(json), JsonDecoderException);
+    EXPECT_THROW(decodeWithFallback(json), JsonDecoderException);
+  }
+}
+
+TEST(decodesFromAnyBuffer) {
+  std::vector<char> buffer{'[', '1', ',', '2', ']', 'x', 'x'};
+  auto value = JsonDecoder::decode(buffer.data(), 5);
+  EXPECT(*value == *JsonDecoder::decode("[1,2]"));
+  EXPECT(*JsonDecoder::decode(std::vector<char>(buffer.begin(), buffer.begin() + 5)) == *value);
+}
+
+int main() {
+  return Test::run();
+}
@@ -0,0 +1,113 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "Test.h"
+#include "../src/JsonDocument.h"
+
+using namespace Flows;
+
+namespace {
+
+const std::string json = R"({"payload": {"sensors": [{"name": "a", "temp": 18}, {"name": "b", "temp": -2.5e1, "tags": ["x", [], {}]}], "state": true, "empty": [], "none": null},
+  "topic": "t\"1", "a\"b": {"c": 1}})";
+
+//Compares get() with JsonDecoder for "property" and all properties below it.
+bool matchesDecoder(const JsonDocument &document, const std::string &property, const PVariable &expected) {
+  auto value = document.get(property);
+  if (!value || !value->equivalent(*expected) || !document.contains(MessageProperty(property))) return false;
+  if (expected->type == VariableType::tArray) {
+    auto &array = expected->arrayValue.view();
+    for (size_t i = 0; i < array.size(); i++) {
+      if (!matchesDecoder(document, property + "[" + std::to_string(i) + "]", array[i])) return false;
+    }
+  } else if (expected->type == VariableType::tStruct) {
+    for (auto &element : expected->structValue.view()) {
+      if (!matchesDecoder(document, property.empty() ? element.first : property + "." + element.first, element.second)) return false;
+    }
+  }
+  return true;
+}
+
+}
+
+TEST(getMatchesDecoderForEveryPath) {
+  JsonDocument document(json);
+  auto decoded = JsonDecoder::decode(json);
+  EXPECT(matchesDecoder(document, "", decoded));
+  EXPECT(document.decode()->equivalent(*decoded));
+  EXPECT(document.json() == json);
+}
+
+TEST(getDecodesOnlyTheValue) {
+  JsonDocument document(json);
+  EXPECT(document.get("payload.sensors[1].name")->stringValue == "b");
+  EXPECT(document.get("payload.sensors[1].temp")->floatValue == -25);
+  EXPECT(document.get("payload.state")->booleanValue);
+  EXPECT(document.get("payload.none")->type == VariableType::tVoid);
+  EXPECT(document.get("topic")->stringValue == "t\"1");
+  EXPECT(document.get("a\"b.c")->integerValue == 1);
+}
+
+TEST(missingPathsReturnNull) {
+  JsonDocument document(json);
+  for (auto &property : {"missing", "payload.sensors[2]", "payload.empty[0]", "payload.sensors.name", "payload[0]", "topic.a", "payload.sensors[0].name.x", "payload.sensors[-1]", "payload.sensors[a]"}) {
+    EXPECT(!document.get(property));
+    EXPECT(!document.contains(MessageProperty(property)));
+  }
+}
+
+TEST(duplicateKeysResolveLikeDecoder) {
+  const std::string duplicates = R"({"a": 1, "b": 2, "a": 3})";
+  JsonDocument document(duplicates);
+  EXPECT(*document.get("a") == *JsonDecoder::decode(duplicates)->structValue->at("a"));
+}
+
+TEST(invalidValuesThrowWhenAccessed) {
+  JsonDocument document(R"({"a": 1, "b": tru, "c": [1,], "d": 1x})");
+  EXPECT(document.get("a")->integerValue == 1);
+  EXPECT(document.contains(MessageProperty("b")));
+  EXPECT_THROW(document.get("b"), JsonDecoderException);
+  EXPECT_THROW(document.get("c"), JsonDecoderException);
+  EXPECT_THROW(document.get("d"), JsonDecoderException);
+}
+
+TEST(constructorChecksBrackets) {
+  for (auto &invalid : {"{\"a\": [1}", "[1, 2", "{\"a\": \"b}", "]", "[{]}"}) {
+    EXPECT_THROW(JsonDocument{invalid}, JsonDecoderException);
+  }
+  JsonDocument empty("");
+  EXPECT(!empty.get("a"));
+  JsonDocument scalar("42");
+  EXPECT(scalar.get("")->integerValue == 42);
+}
+
+int main() {
+  return Test::run();
+}
@@ -0,0 +1,159 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "Test.h"
+#include "../src/JsonDecoder.h"
+#include "../src/JsonStreamDecoder.h"
+
+using namespace Flows;
+
+namespace {
+
+//Values directly following each other, separated by whitespace, with brackets and escaped quotes in strings and
+//scalars that only end with the next character.
+const std::string stream = "{\"a\": [1, \"x\\\"]}\", {}], \"b\": -2.5e3}\n[true,null]\"s\\\\\"12 -3\r\n\tnull{\"c\":{\"d\":[[]]}}false\"\" 7";
+
+std::vector<PVariable> expectedValues() {
+  std::vector<PVariable> values;
+  for (auto &json : {"{\"a\": [1, \"x\\\"]}\", {}], \"b\": -2.5e3}", "[true,null]", "\"s\\\\\"", "12", "-3", "null", "{\"c\":{\"d\":[[]]}}", "false", "\"\"", "7"}) {
+    values.push_back(JsonDecoder::decode(std::string(json)));
+  }
+  return values;
+}
+
+bool equal(const std::vector<PVariable> &values, const std::vector<PVariable> &expected) {
+  if (values.size() != expected.size()) return false;
+  for (size_t i = 0; i < values.size(); i++) {
+    if (!values[i] || !values[i]->equivalent(*expected[i])) return false;
+  }
+  return true;
+}
+
+//Pushes "stream" split at the given positions.
+std::vector<PVariable> decode(const std::vector<size_t> &splits) {
+  JsonStreamDecoder decoder;
+  std::vector<PVariable> values;
+  size_t start = 0;
+  for (auto split : splits) {
+    decoder.push(stream.data() + start, split - start, values);
+    start = split;
+  }
+  decoder.push(stream.data() + start, stream.size() - start, values);
+  decoder.finish(values);
+  return values;
+}
+
+}
+
+TEST(decodesWholeStream) {
+  EXPECT(equal(decode({}), expectedValues()));
+}
+
+TEST(decodesStreamSplitAtEveryByte) {
+  auto expected = expectedValues();
+  for (size_t i = 0; i <= stream.size(); i++) {
+    EXPECT(equal(decode({i}), expected));
+  }
+}
+
+TEST(decodesStreamSplitAtEveryPairOfBytes) {
+  auto expected = expectedValues();
+  for (size_t i = 0; i <= stream.size(); i++) {
+    for (size_t j = i; j <= stream.size(); j++) {
+      EXPECT(equal(decode({i, j}), expected));
+    }
+  }
+}
+
+TEST(decodesStreamPushedBytewise) {
+  std::vector<size_t> splits;
+  for (size_t i = 1; i < stream.size(); i++) {
+    splits.push_back(i);
+  }
+  EXPECT(equal(decode(splits), expectedValues()));
+}
+
+TEST(valuesAreCompletedAsSoonAsPossible) {
+  JsonStreamDecoder decoder;
+  std::vector<PVariable> values;
+  decoder.push("[1, 2", values);
+  EXPECT(values.empty() && decoder.bufferedBytes() == 5);
+  decoder.push("] 42", values);
+  EXPECT(values.size() == 1 && decoder.bufferedBytes() == 2);
+  //Scalars are only complete with the next character or at the end of the stream.
+  decoder.push(" ", values);
+  EXPECT(values.size() == 2 && values[1]->integerValue == 42 && decoder.bufferedBytes() == 0);
+  decoder.push("true", values);
+  EXPECT(values.size() == 2);
+  decoder.finish(values);
+  EXPECT(values.size() == 3 && values[2]->booleanValue);
+}
+
+TEST(invalidValuesThrowAndResetDecoder) {
+  JsonStreamDecoder decoder;
+  std::vector<PVariable> values;
+  EXPECT_THROW(decoder.push("[1] x [2]", values), JsonDecoderException);
+  EXPECT(values.size() == 1);
+  decoder.push("[3]", values);
+  EXPECT(values.size() == 2 && values[1]->arrayValue->at(0)->integerValue == 3);
+  EXPECT_THROW(decoder.push("tru ", values), JsonDecoderException);
+  EXPECT_THROW(decoder.push("nul", values); decoder.finish(values), JsonDecoderException);
+  EXPECT_THROW(decoder.push("[1,]", values), JsonDecoderException);
+  EXPECT(decoder.bufferedBytes() == 0);
+  decoder.push("{\"a\": ", values);
+  EXPECT_THROW(decoder.finish(values), JsonDecoderException);
+  EXPECT(values.size() == 2);
+}
+
+TEST(maxValueSizeIsEnforced) {
+  JsonStreamDecoder limited(8);
+  std::vector<PVariable> values;
+  limited.push("[1, 2]", values);
+  EXPECT(values.size() == 1);
+  EXPECT_THROW(limited.push("[1, 2, 3, 4]", values), JsonDecoderException);
+  limited.push("[1, ", values);
+  EXPECT_THROW(limited.push("2, 3, 4]", values), JsonDecoderException);
+  limited.push("\"abcdef\"", values);
+  EXPECT(values.size() == 2 && values[1]->stringValue == "abcdef");
+}
+
+TEST(resetDiscardsCurrentValue) {
+  JsonStreamDecoder decoder;
+  std::vector<PVariable> values;
+  decoder.push("{\"a\": [1, ", values);
+  decoder.reset();
+  EXPECT(decoder.bufferedBytes() == 0);
+  decoder.push("[2]", values);
+  EXPECT(values.size() == 1 && values[0]->arrayValue->at(0)->integerValue == 2);
+}
+
+int main() {
+  return Test::run();
+}
@@ -0,0 +1,166 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "Test.h"
+#include "../src/JsonStructuralIndex.h"
+
+#include <random>
+
+using namespace Flows;
+
+namespace {
+
+/**
+ * Character by character reference of the index. Returns false for unterminated strings like build(). Like the index,
+ * it applies backslashes outside of strings as well, which is invalid JSON anyway.
+ */
+bool buildReference(const std::string &json, std::vector<uint32_t> &positions) {
+  positions.clear();
+  bool inString = false;
+  bool escaped = false;
+  bool inScalar = false;
+  for (uint32_t i = 0; i < json.size(); i++) {
+    char c = json[i];
+    bool quote = c == '"' && !escaped;
+    escaped = c == '\\' && !escaped;
+    if (inString) {
+      if (quote) inString = false;
+      inScalar = false;
+      continue;
+    }
+    bool structural = c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ',';
+    bool whitespace = c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    if (quote) {
+      inString = true;
+      positions.push_back(i);
+    } else if (structural) positions.push_back(i);
+    else if (!whitespace && !inScalar) positions.push_back(i);
+    inScalar = !structural && !whitespace && !quote;
+  }
+  return !inString;
+}
+
+std::vector<uint32_t> build(JsonStructuralIndex &index, const std::string &json, bool &result) {
+  result = index.build(json.data(), json.size());
+  return std::vector<uint32_t>(index.positions(), index.positions() + index.size());
+}
+
+//Checks all kernels against the reference.
+bool matchesReference(const std::string &json) {
+  std::vector<uint32_t> expected;
+  bool expectedResult = buildReference(json, expected);
+  for (auto &kernel : JsonStructuralIndex::kernels()) {
+    JsonStructuralIndex index;
+    if (!index.setKernel(kernel)) return false;
+    bool result = false;
+    auto positions = build(index, json, result);
+    if (result != expectedResult || (result && positions != expected)) {
+      printf("Kernel %s differs for: %s\n", kernel.c_str(), json.c_str());
+      return false;
+    }
+  }
+  return true;
+}
+
+}
+
+TEST(kernelsAreSupported) {
+  auto kernels = JsonStructuralIndex::kernels();
+  EXPECT(!kernels.empty());
+  EXPECT(kernels.front() == JsonStructuralIndex::kernel());
+  EXPECT(kernels.back() == "scalar");
+  JsonStructuralIndex index;
+  EXPECT(!index.setKernel("unknown"));
+}
+
+TEST(findsStructuralCharactersAndValues) {
+  JsonStructuralIndex index;
+  bool result = false;
+  auto positions = build(index, R"({"a": [1, true, null], "b" : -2.5e3})", result);
+  EXPECT(result);
+  EXPECT((positions == std::vector<uint32_t>{0, 1, 4, 6, 7, 8, 10, 14, 16, 20, 21, 23, 27, 29, 35}));
+}
+
+TEST(ignoresCharactersInStrings) {
+  JsonStructuralIndex index;
+  bool result = false;
+  auto positions = build(index, R"(["{[:,]}", "a\"]", "\\", "\\\"", 1])", result);
+  EXPECT(result);
+  EXPECT((positions == std::vector<uint32_t>{0, 1, 9, 11, 17, 19, 23, 25, 31, 33, 34}));
+}
+
+TEST(detectsUnterminatedStrings) {
+  JsonStructuralIndex index;
+  EXPECT(!index.build(R"(["abc)", 5));
+  EXPECT(!index.build(R"(["a\"])", 6));
+  EXPECT(index.build(R"(["a\\"])", 7));
+  EXPECT(index.build("", 0));
+  EXPECT(index.size() == 0);
+}
+
+TEST(handlesBlockBoundaries) {
+  //Strings, escape sequences and values crossing the 64 byte blocks at every offset.
+  for (size_t offset = 0; offset < 130; offset++) {
+    std::string padding(offset, ' ');
+    EXPECT(matchesReference(padding + R"(["abc\"def", 12345, "\\\\", {"x": true}])"));
+    EXPECT(matchesReference(padding + "\"" + std::string(70, '\\') + "\", 1]"));
+    EXPECT(matchesReference(padding + "\"" + std::string(71, '\\') + "\", 1]"));
+  }
+}
+
+TEST(kernelsMatchReferenceOnRandomInput) {
+  //Mostly JSON characters, so strings, escapes and values are frequent.
+  const std::string alphabet = "{}[]:,\"\"\"\\\\ \t\n\ra1-tn";
+  std::mt19937 random(42);
+  for (uint32_t i = 0; i < 2000; i++) {
+    std::string json(random() % 300, ' ');
+    for (auto &c : json) {
+      c = alphabet[random() % alphabet.size()];
+    }
+    EXPECT(matchesReference(json));
+  }
+}
+
+TEST(reusesIndex) {
+  JsonStructuralIndex index;
+  std::string large = "[" + std::string(100000, ' ') + "1]";
+  EXPECT(index.build(large.data(), large.size()));
+  EXPECT(index.size() == 3);
+  EXPECT(index.build("[]", 2));
+  EXPECT(index.size() == 2 && index.positions()[1] == 1);
+  index.clear();
+  EXPECT(index.size() == 0);
+  EXPECT(index.build("{}", 2));
+  EXPECT(index.size() == 2);
+}
+
+int main() {
+  return Test::run();
+}
@@ -0,0 +1,156 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "Test.h"
+#include "../src/Math.h"
+#include "../src/MessageProperty.h"
+#include "../src/Variable.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using namespace Flows;
+
+namespace {
+
+//Parses all of "s" with Math::parseDouble().
+bool parseWhole(const char *s, double &value) {
+  auto end = s + std::strlen(s);
+  return Math::parseDouble(s, end, value) == end;
+}
+
+}
+
+TEST(parsesIntegers) {
+  EXPECT(Math::getNumber64("123") == 123);
+  EXPECT(Math::getNumber64("  -42") == -42);
+  EXPECT(Math::getNumber64("+7") == 7);
+  EXPECT(Math::getNumber64("12abc") == 12);
+  EXPECT(Math::getNumber64("0x1F") == 31);
+  EXPECT(Math::getNumber64("1f", true) == 31);
+  EXPECT(Math::getNumber64("-0x10") == -16);
+  EXPECT(Math::getNumber("0xFFFFFFFF") == -1);
+  EXPECT(Math::getNumber("4294967295") == -1);
+  std::string octal = "17";
+  EXPECT(Math::getOctalNumber(octal) == 15);
+}
+
+TEST(invalidIntegersGiveZero) {
+  for (auto &s : {"", " ", "abc", "-", "+", "--1", "x", "0x", "0xg"}) {
+    EXPECT(Math::getNumber64(s) == 0);
+    EXPECT(Math::getUnsignedNumber64(s) == 0);
+  }
+  EXPECT(!Math::isNumber("abc"));
+  EXPECT(!Math::isNumber(""));
+  EXPECT(Math::isNumber("-12"));
+  EXPECT(Math::isNumber("0x1A"));
+}
+
+TEST(stringVariablesMatchGetNumber64) {
+  //Variable skips the parser for strings that can't start a number, the results have to be the same.
+  for (auto &s : {"", "text", "devices/livingroom", " -42", "+7", "12abc", "0x1F", "-0x10", "abcx", "fx", " ffx", "-", "x", "1e5"}) {
+    Variable variable(s);
+    EXPECT(variable.integerValue64 == Math::getNumber64(s));
+    EXPECT(variable.integerValue == (int32_t)Math::getNumber64(s));
+  }
+}
+
+TEST(integerOverflowGivesZero) {
+  EXPECT(Math::getNumber64("9223372036854775807") == std::numeric_limits<int64_t>::max());
+  EXPECT(Math::getNumber64("-9223372036854775808") == std::numeric_limits<int64_t>::min());
+  EXPECT(Math::getNumber64("9223372036854775808") == 0);
+  EXPECT(Math::getNumber64("-9223372036854775809") == 0);
+  EXPECT(Math::getNumber64("99999999999999999999999") == 0);
+  EXPECT(Math::getNumber64("0x8000000000000000") == 0);
+  EXPECT(!Math::isNumber("9223372036854775808"));
+  EXPECT(Math::getUnsignedNumber64("18446744073709551615") == std::numeric_limits<uint64_t>::max());
+  EXPECT(Math::getUnsignedNumber64("18446744073709551616") == 0);
+  EXPECT(Math::getUnsignedNumber64("0xFFFFFFFFFFFFFFFF") == std::numeric_limits<uint64_t>::max());
+}
+
+TEST(negativeUnsignedNumbersWrapAround) {
+  //Like std::stoull(). Use MessageProperty for array indexes, it rejects negative ones.
+  EXPECT(Math::getUnsignedNumber64("-1") == std::numeric_limits<uint64_t>::max());
+  EXPECT(Math::getUnsignedNumber("-1") == std::numeric_limits<uint32_t>::max());
+  EXPECT(!MessageProperty("payload[-1]").valid());
+  EXPECT(MessageProperty("payload[1]").valid());
+}
+
+TEST(parsesDoubles) {
+  EXPECT(Math::getDouble("1.5") == 1.5);
+  EXPECT(Math::getDouble("  -2.5e3") == -2500);
+  EXPECT(Math::getDouble("+3") == 3);
+  EXPECT(Math::getDouble("1.5abc") == 1.5);
+  EXPECT(Math::getDouble("0x1p3") == 8);
+  EXPECT(Math::getDouble("0.1") == 0.1);
+  EXPECT(Math::getDouble("1.7976931348623157e308") == std::numeric_limits<double>::max());
+  for (auto &s : {"", "abc", "-", "+-3", ".", "e5", "in"}) {
+    EXPECT(Math::getDouble(s) == 0);
+  }
+}
+
+TEST(doubleOverflowGivesZero) {
+  //std::stod() threw for these, so getDouble() keeps returning 0.
+  EXPECT(Math::getDouble("1e400") == 0);
+  EXPECT(Math::getDouble("-1e400") == 0);
+  EXPECT(Math::getDouble("1e-400") == 0);
+  //parseDouble() returns infinity or 0 instead.
+  double value = 0;
+  EXPECT(parseWhole("1e400", value) && std::isinf(value) && value > 0);
+  EXPECT(parseWhole("-1e400", value) && std::isinf(value) && value < 0);
+  EXPECT(parseWhole("1e-400", value) && value == 0);
+}
+
+TEST(parsesInfinityAndNan) {
+  EXPECT(std::isinf(Math::getDouble("inf")) && Math::getDouble("inf") > 0);
+  EXPECT(std::isinf(Math::getDouble("-Infinity")) && Math::getDouble("-Infinity") < 0);
+  EXPECT(std::isnan(Math::getDouble("nan")));
+  double value = 0;
+  EXPECT(parseWhole("inf", value) && std::isinf(value));
+  EXPECT(parseWhole("NaN", value) && std::isnan(value));
+}
+
+TEST(parseDoubleStopsAtInvalidCharacters) {
+  const char *s = "-12.5e2,";
+  double value = 0;
+  EXPECT(Math::parseDouble(s, s + std::strlen(s), value) == s + 7);
+  EXPECT(value == -1250);
+  //Only the given range is parsed.
+  EXPECT(Math::parseDouble(s, s + 3, value) == s + 3);
+  EXPECT(value == -12);
+  for (auto &invalid : {"", "-", "+1", " 1", "x"}) {
+    EXPECT(Math::parseDouble(invalid, invalid + std::strlen(invalid), value) == invalid);
+  }
+}
+
+int main() {
+  return Test::run();
+}
@@ -0,0 +1,180 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "Test.h"
+#include "../src/MessageProperty.h"
+#include "../src/Variable.h"
+
+using namespace Flows;
+
+namespace {
+
+//{"payload": {"a": 1, "b": "text", "list": [10, {"c": true}]}}
+PVariable createMessage() {
+  auto message = std::make_shared<Variable>(VariableType::tStruct);
+  auto payload = std::make_shared<Variable>(VariableType::tStruct);
+  payload->structValue->emplace("a", std::make_shared<Variable>(1));
+  payload->structValue->emplace("b", std::make_shared<Variable>("text"));
+  auto list = std::make_shared<Variable>(VariableType::tArray);
+  list->arrayValue->push_back(std::make_shared<Variable>(10));
+  auto element = std::make_shared<Variable>(VariableType::tStruct);
+  element->structValue->emplace("c", std::make_shared<Variable>(true));
+  list->arrayValue->push_back(element);
+  payload->structValue->emplace("list", list);
+  message->structValue->emplace("payload", payload);
+  return message;
+}
+
+//MessageProperty::set() takes the value by non-const reference.
+bool set(PVariable &message, const std::string &property, PVariable value) {
+  return MessageProperty(property).set(message, value);
+}
+
+}
+
+TEST(parsesKeysAndIndexes) {
+  MessageProperty property("payload.list[1].c");
+  auto &segments = property.segments();
+  EXPECT(property.valid());
+  EXPECT(segments.size() == 4);
+  EXPECT(!segments[0].isIndex && segments[0].key == "payload");
+  EXPECT(!segments[1].isIndex && segments[1].key == "list");
+  EXPECT(segments[2].isIndex && segments[2].index == 1);
+  EXPECT(!segments[3].isIndex && segments[3].key == "c");
+  EXPECT(segments[3].keyHash == Struct::hashKey("c"));
+  EXPECT(MessageProperty("").empty());
+}
+
+TEST(matchFindsNestedElements) {
+  auto message = createMessage();
+  EXPECT(MessageProperty("payload.a").match(message)->integerValue == 1);
+  EXPECT(MessageProperty("payload.list[0]").match(message)->integerValue == 10);
+  EXPECT(MessageProperty("payload.list[1].c").match(message)->booleanValue);
+  EXPECT(!MessageProperty("payload.list[2]").match(message));
+  EXPECT(!MessageProperty("payload.missing.c").match(message));
+}
+
+TEST(invalidIndexesAreRejected) {
+  auto message = createMessage();
+  auto expected = std::make_shared<Variable>(*message);
+  for (auto &text : {"payload.list[-1]", "payload.list[a]", "payload.list[]", "payload.list[1a]", "payload.list[ 1]", "payload.list[+1]", "payload.list[18446744073709551616]"}) {
+    MessageProperty property(text);
+    EXPECT(!property.valid());
+    EXPECT(!property.match(message));
+    EXPECT(!property.erase(message));
+    auto value = std::make_shared<Variable>(5);
+    EXPECT(!property.set(message, value));
+    EXPECT(property.setCow(message, value) == message);
+  }
+  EXPECT(*message == *expected);
+  EXPECT(MessageProperty("payload.list[18446744073709551615]").valid());
+}
+
+TEST(setCreatesMissingElements) {
+  auto message = createMessage();
+  EXPECT(set(message, "payload.new.list[2]", std::make_shared<Variable>("x")));
+  auto list = MessageProperty("payload.new.list").match(message);
+  EXPECT(list && list->type == VariableType::tArray && list->arrayValue->size() == 3);
+  EXPECT(list->arrayValue->at(2)->stringValue == "x");
+  EXPECT(set(message, "payload.a", std::make_shared<Variable>(2)));
+  EXPECT(MessageProperty("payload.a").match(message)->integerValue == 2);
+}
+
+TEST(eraseRemovesElements) {
+  auto message = createMessage();
+  EXPECT(MessageProperty("payload.list[0]").erase(message));
+  EXPECT(MessageProperty("payload.list[0].c").match(message) != nullptr);
+  EXPECT(MessageProperty("payload.b").erase(message));
+  EXPECT(!MessageProperty("payload.b").match(message));
+  EXPECT(!MessageProperty("payload.b").erase(message));
+}
+
+TEST(setCowLeavesMessageUnchanged) {
+  auto message = createMessage();
+  auto expected = std::make_shared<Variable>(*message);
+  auto copy = MessageProperty("payload.list[1].d").setCow(message, std::make_shared<Variable>(3));
+  EXPECT(*message == *expected);
+  EXPECT(MessageProperty("payload.list[1].d").match(copy)->integerValue == 3);
+  EXPECT(MessageProperty("payload.list[1].c").match(copy)->booleanValue);
+  EXPECT(!MessageProperty("payload.list[1].d").match(message));
+}
+
+TEST(propertySetMatchesAllProperties) {
+  auto message = createMessage();
+  MessagePropertySet properties;
+  EXPECT(properties.add("payload.a") == 0);
+  EXPECT(properties.add("payload.list[1].c") == 1);
+  EXPECT(properties.add("payload.missing") == 2);
+  EXPECT(properties.add("payload.list[-1]") == 3);
+  EXPECT(properties.add("payload") == 4);
+  EXPECT(properties.add("payload.a") == 5);
+  EXPECT(properties.size() == 6);
+  std::vector<PVariable> results;
+  properties.match(message, results);
+  EXPECT(results.size() == 6);
+  EXPECT(results[0] && results[0]->integerValue == 1);
+  EXPECT(results[1] && results[1]->booleanValue);
+  EXPECT(!results[2]);
+  EXPECT(!results[3]);
+  EXPECT(results[4] == message->structValue->at("payload"));
+  EXPECT(results[5] == results[0]);
+  properties.match(PVariable(), results);
+  EXPECT(results.size() == 6 && !results[0]);
+}
+
+TEST(propertySetSetsAllProperties) {
+  auto message = createMessage();
+  MessagePropertySet properties;
+  properties.add("payload.a");
+  properties.add("payload.new[1].x");
+  properties.add("payload.list[-1]");
+  std::vector<PVariable> values{std::make_shared<Variable>(7), std::make_shared<Variable>("y"), std::make_shared<Variable>(8)};
+  EXPECT(!properties.set(message, std::vector<PVariable>(2)));
+  EXPECT(properties.set(message, values));
+  EXPECT(MessageProperty("payload.a").match(message)->integerValue == 7);
+  EXPECT(MessageProperty("payload.new[1].x").match(message)->stringValue == "y");
+  EXPECT(MessageProperty("payload.list").match(message)->arrayValue->size() == 2);
+}
+
+TEST(propertySetDoesNotModifySharedElements) {
+  auto original = createMessage();
+  auto expected = std::make_shared<Variable>(*original);
+  auto copy = Variable::createCopyOnWrite(*original);
+  MessagePropertySet properties;
+  properties.add("payload.a");
+  properties.add("payload.list[1].c");
+  EXPECT(properties.set(copy, {std::make_shared<Variable>(2), std::make_shared<Variable>(false)}));
+  EXPECT(*original == *expected);
+  EXPECT(MessageProperty("payload.list[1].c").match(copy)->booleanValue == false);
+}
+
+int main() {
+  return Test::run();
+}
@@ -0,0 +1,144 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "Test.h"
+#include "../src/JsonDecoder.h"
+#include "../src/JsonEncoder.h"
+#include "../src/MessageQuery.h"
+
+using namespace Flows;
+
+namespace {
+
+PVariable createMessage() {
+  return JsonDecoder::decode(R"({"payload": {"sensors": [{"name": "a", "temp": 18, "on": true}, {"name": "b", "temp": 21, "on": false}, {"name": "c", "on": null}, {"name": "d", "temp": 25, "tags": ["x", "y"]}], "a key": 1, "temp": 30}})");
+}
+
+//The matches of "query" encoded as one JSON array.
+std::string query(const std::string &query, const PVariable &message = createMessage()) {
+  std::vector<PVariable> results;
+  MessageQuery(query).match(message, results);
+  auto array = std::make_shared<Variable>(VariableType::tArray);
+  for (auto &result : results) {
+    array->arrayValue->push_back(result);
+  }
+  return JsonEncoder::getString(array);
+}
+
+}
+
+TEST(keysAndIndexes) {
+  EXPECT(query("payload.sensors[1].name") == R"(["b"])");
+  EXPECT(query("$.payload.sensors[0].temp") == "[18]");
+  EXPECT(query("$payload['a key']") == "[1]");
+  EXPECT(query(R"(payload["a key"])") == "[1]");
+  EXPECT(query("payload.sensors[3].tags[1]") == R"(["y"])");
+  EXPECT(query("payload.sensors[4]") == "[]");
+  EXPECT(query("payload.missing.temp") == "[]");
+  EXPECT(query("payload[0]") == "[]");
+  EXPECT(query("payload.sensors.name") == "[]");
+}
+
+TEST(emptyQueryMatchesMessage) {
+  auto message = createMessage();
+  EXPECT(MessageQuery("").matchFirst(message) == message);
+  EXPECT(MessageQuery("$").matchFirst(message) == message);
+  EXPECT(!MessageQuery("$").matchFirst(PVariable()));
+}
+
+TEST(wildcards) {
+  EXPECT(query("payload.sensors[*].name") == R"(["a","b","c","d"])");
+  EXPECT(query("payload.sensors[*].temp") == "[18,21,25]");
+  EXPECT(query("payload.sensors[3].tags.*") == R"(["x","y"])");
+  //Structs are iterated in key order.
+  EXPECT(query("payload.sensors[0].*") == R"(["a",true,18])");
+}
+
+TEST(recursiveDescent) {
+  EXPECT(query("payload..temp") == "[30,18,21,25]");
+  EXPECT(query("..tags[0]") == R"(["x"])");
+  EXPECT(query("payload.sensors..[1]") == R"([{"name":"b","on":false,"temp":21},"y"])");
+  EXPECT(query("..missing") == "[]");
+}
+
+TEST(filters) {
+  EXPECT(query("payload.sensors[?(@.temp > 20)].name") == R"(["b","d"])");
+  EXPECT(query("payload.sensors[?(@.temp >= 21)].name") == R"(["b","d"])");
+  EXPECT(query("payload.sensors[?(@.temp < 21)].name") == R"(["a"])");
+  EXPECT(query("payload.sensors[?(@.temp <= 21.0)].name") == R"(["a","b"])");
+  EXPECT(query("payload.sensors[?(@.temp == 25)].name") == R"(["d"])");
+  EXPECT(query("payload.sensors[?(@.name == 'c')].on") == "[null]");
+  EXPECT(query(R"(payload.sensors[?(@.name != "c")].name)") == R"(["a","b","d"])");
+  EXPECT(query("payload.sensors[?(@.on == true)].name") == R"(["a"])");
+  EXPECT(query("payload.sensors[?(@.on == null)].name") == R"(["c"])");
+  EXPECT(query("payload.sensors[?(@.temp)].name") == R"(["a","b","d"])");
+  EXPECT(query("payload.sensors[?(@.tags[1] == 'y')].name") == R"(["d"])");
+  EXPECT(query("payload.sensors[?( @['name'] == 'a' )].temp") == "[18]");
+  EXPECT(query("payload..[?(@.temp > 20)].name") == R"(["b","d"])");
+}
+
+TEST(filtersDontCompareDifferentTypes) {
+  //Values of other types never compare equal, so "!=" matches them.
+  EXPECT(query("payload.sensors[?(@.temp == '21')].name") == "[]");
+  EXPECT(query("payload.sensors[?(@.on > 0)].name") == "[]");
+  EXPECT(query("payload.sensors[?(@.on != 1)].name") == R"(["a","b","c"])");
+}
+
+TEST(matchReturnsElementsOfTheMessage) {
+  auto message = createMessage();
+  auto sensors = message->structValue->at("payload")->structValue->at("sensors");
+  EXPECT(MessageQuery("payload.sensors").matchFirst(message) == sensors);
+  EXPECT(MessageQuery("payload.sensors[*]").matchFirst(message) == sensors->arrayValue->at(0));
+  std::vector<PVariable> results{message};
+  MessageQuery("payload.missing").match(message, results);
+  EXPECT(results.empty());
+}
+
+TEST(invalidQueriesThrow) {
+  for (auto &text : {"payload.", "payload..", "payload[", "payload[0", "payload[-1]", "payload[a]", "payload['a]", "payload[?(@.a >)]",
+                     "payload[?(@.a ~ 1)]", "payload[?(.a)]", "payload[?(@.a == 1]", "payload[?(@[*])]", "payload]"}) {
+    EXPECT_THROW(MessageQuery{text}, MessageQueryException);
+  }
+}
+
+TEST(invalidNumbersThrow) {
+  //Used to wrap to 0 and match the first element.
+  for (auto &text : {"payload[18446744073709551616]", "payload[99999999999999999999999]", "payload[1a]", "payload[1 2]",
+                     "payload[?(@.a == 9223372036854775808)]", "payload[?(@.a == 1-2)]", "payload[?(@.a == 1.5.5)]", "payload[?(@.a == -)]"}) {
+    EXPECT_THROW(MessageQuery{text}, MessageQueryException);
+  }
+  EXPECT(query("payload.sensors[18446744073709551615].name") == "[]");
+  EXPECT(query("payload.sensors[?(@.temp == +25)].name") == R"(["d"])");
+  EXPECT(query("payload.sensors[?(@.temp > -1e3)].name") == R"(["a","b","d"])");
+}
+
+int main() {
+  return Test::run();
+}
@@ -0,0 +1,168 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "Test.h"
+#include "../src/Arena.h"
+#include "../src/JsonDecoder.h"
+#include "../src/JsonEncoder.h"
+#include "../src/RpcDecoder.h"
+#include "../src/RpcEncoder.h"
+#include "../src/Variable.h"
+#include "../src/VariableIterator.h"
+
+using namespace Flows;
+
+namespace {
+
+//Nests "depth" arrays or structs, the innermost one contains the integer 1.
+PVariable createDeepTree(uint32_t depth, bool structs) {
+  auto root = std::make_shared<Variable>(structs ? VariableType::tStruct : VariableType::tArray);
+  auto current = root;
+  for (uint32_t i = 1; i < depth; i++) {
+    auto element = std::make_shared<Variable>(structs ? VariableType::tStruct : VariableType::tArray);
+    if (structs) current->structValue->emplace("a", element);
+    else current->arrayValue->push_back(element);
+    current = element;
+  }
+  if (structs) current->structValue->emplace("a", std::make_shared<Variable>(1));
+  else current->arrayValue->push_back(std::make_shared<Variable>(1));
+  return root;
+}
+
+std::string createDeepJson(uint32_t depth) {
+  return std::string(depth, '[') + "1" + std::string(depth, ']');
+}
+
+//A binary RPC response nesting "depth" arrays.
+std::vector<char> createDeepRpcResponse(uint32_t depth) {
+  std::vector<char> packet{'B', 'i', 'n', 1, 0, 0, 0, 0};
+  for (uint32_t i = 0; i < depth; i++) {
+    packet.insert(packet.end(), {0, 0, 1, 0, 0, 0, 0, (char)(i == depth - 1 ? 0 : 1)});
+  }
+  return packet;
+}
+
+uint32_t countArrays(const Variable &variable) {
+  uint32_t count = 0;
+  VariableIterator iterator(variable, 0);
+  while (iterator.next()) {
+    if (iterator.event() == VariableIterator::Event::beginArray) count++;
+  }
+  return count;
+}
+
+}
+
+TEST(deepArraysAreReleasedIteratively) {
+  auto root = createDeepTree(100000, false);
+  root.reset();
+  EXPECT(!root);
+}
+
+TEST(deepStructsAreReleasedIteratively) {
+  auto root = createDeepTree(100000, true);
+  root.reset();
+  EXPECT(!root);
+}
+
+TEST(sharedSubtreesSurviveRelease) {
+  auto root = createDeepTree(1000, false);
+  auto copy = Variable::createCopyOnWrite(*root);
+  PVariable inner = root;
+  for (uint32_t i = 0; i < 500; i++) {
+    inner = inner->arrayValue.view().at(0);
+  }
+  root.reset();
+  EXPECT(countArrays(*copy) == 1000);
+  copy.reset();
+  EXPECT(countArrays(*inner) == 500);
+}
+
+TEST(deepTreesCanBeCopiedAndCompared) {
+  auto root = createDeepTree(100000, false);
+  auto copy = std::make_shared<Variable>(*root);
+  EXPECT(*copy == *root);
+  EXPECT(copy->hash() == root->hash());
+}
+
+TEST(jsonDecoderAcceptsMaxDepth) {
+  auto json = createDeepJson(JsonDecoder::maxDepth);
+  EXPECT(countArrays(*JsonDecoder::decode(json)) == JsonDecoder::maxDepth);
+  uint32_t bytesRead = 0;
+  EXPECT(countArrays(*JsonDecoder::decode(json, bytesRead)) == JsonDecoder::maxDepth);
+  EXPECT(bytesRead == json.size());
+  auto arena = std::make_shared<Arena>();
+  EXPECT(countArrays(*JsonDecoder::decode(json, arena)) == JsonDecoder::maxDepth);
+}
+
+TEST(jsonDecoderRejectsDeeperDocuments) {
+  EXPECT_THROW(JsonDecoder::decode(createDeepJson(JsonDecoder::maxDepth + 1)), JsonDecoderException);
+  EXPECT_THROW(JsonDecoder::decode(createDeepJson(100000)), JsonDecoderException);
+  //Only the character by character decoder handles trailing data.
+  EXPECT_THROW(JsonDecoder::decode(createDeepJson(100000) + " x"), JsonDecoderException);
+  EXPECT_THROW(JsonDecoder::decode(std::string(100000, '{')), JsonDecoderException);
+  uint32_t bytesRead = 0;
+  EXPECT_THROW(JsonDecoder::decode(createDeepJson(100000), bytesRead), JsonDecoderException);
+}
+
+TEST(rpcDecoderAcceptsMaxDepth) {
+  RpcDecoder decoder;
+  auto packet = createDeepRpcResponse(RpcDecoder::maxDepth);
+  auto response = decoder.decodeResponse(packet);
+  EXPECT(countArrays(*response) == RpcDecoder::maxDepth);
+
+  std::vector<char> encoded;
+  RpcEncoder().encodeResponse(response, encoded);
+  EXPECT(*decoder.decodeResponse(encoded) == *response);
+}
+
+TEST(rpcDecoderRejectsDeeperPackets) {
+  RpcDecoder decoder;
+  auto packet = createDeepRpcResponse(RpcDecoder::maxDepth + 1);
+  EXPECT_THROW(decoder.decodeResponse(packet), RpcDecoderException);
+  packet = createDeepRpcResponse(100000);
+  EXPECT_THROW(decoder.decodeResponse(packet, std::make_shared<Arena>()), RpcDecoderException);
+}
+
+TEST(iteratorLimitsDepth) {
+  auto root = createDeepTree(VariableIterator::defaultMaxDepth + 1, false);
+  VariableIterator iterator(*root);
+  EXPECT_THROW(while (iterator.next()) {}, VariableIteratorException);
+  EXPECT(countArrays(*root) == VariableIterator::defaultMaxDepth + 1);
+}
+
+TEST(deepTreesCanBeEncoded) {
+  auto root = createDeepTree(100000, false);
+  EXPECT(JsonEncoder::getString(root) == createDeepJson(100000));
+}
+
+int main() {
+  return Test::run();
+}
@@ -0,0 +1,188 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "Test.h"
+#include "../src/JsonEncoder.h"
+#include "../src/RpcDecoder.h"
+#include "../src/RpcEncoder.h"
+#include "../src/Variable.h"
+
+#include <limits>
+
+using namespace Flows;
+
+namespace {
+
+PVariable createArray(std::initializer_list<PVariable> elements) {
+  auto array = std::make_shared<Variable>(VariableType::tArray);
+  for (auto &element : elements) {
+    array->arrayValue->push_back(element);
+  }
+  return array;
+}
+
+}
+
+TEST(createsPackedArrays) {
+  Variable integers(std::vector<int64_t>{1, -2, std::numeric_limits<int64_t>::max()});
+  EXPECT(integers.type == VariableType::tInteger64Array);
+  EXPECT(integers.isPackedArray());
+  EXPECT(integers.packedArraySize() == 3);
+  EXPECT(integers.packedIntegers()[1] == -2);
+  EXPECT(integers.packedIntegers()[2] == std::numeric_limits<int64_t>::max());
+  EXPECT(!integers.arrayValue.allocated());
+
+  Variable floats(std::vector<double>{0.5, -1.25});
+  EXPECT(floats.type == VariableType::tFloatArray);
+  EXPECT(floats.packedArraySize() == 2);
+  EXPECT(floats.packedFloats()[1] == -1.25);
+  floats.packedFloats()[0] = 3;
+  EXPECT(floats.packedFloats()[0] == 3);
+
+  EXPECT(!Variable(VariableType::tArray).isPackedArray());
+  EXPECT(!(bool)Variable(std::vector<int64_t>()));
+  EXPECT((bool)integers);
+}
+
+TEST(packsIntegerArrays) {
+  auto array = createArray({std::make_shared<Variable>(1), std::make_shared<Variable>((int64_t)5000000000)});
+  EXPECT(array->pack());
+  EXPECT(array->type == VariableType::tInteger64Array);
+  EXPECT(array->packedArraySize() == 2);
+  EXPECT(array->packedIntegers()[0] == 1);
+  EXPECT(array->packedIntegers()[1] == 5000000000);
+}
+
+TEST(packsMixedArraysAsFloats) {
+  auto array = createArray({std::make_shared<Variable>(1), std::make_shared<Variable>(2.5)});
+  EXPECT(array->pack());
+  EXPECT(array->type == VariableType::tFloatArray);
+  EXPECT(array->packedFloats()[0] == 1);
+  EXPECT(array->packedFloats()[1] == 2.5);
+}
+
+TEST(packRejectsOtherElements) {
+  auto array = createArray({std::make_shared<Variable>(1), std::make_shared<Variable>("2")});
+  EXPECT(!array->pack());
+  EXPECT(array->type == VariableType::tArray);
+  EXPECT(array->arrayValue->size() == 2);
+
+  auto nested = createArray({createArray({})});
+  EXPECT(!nested->pack());
+  EXPECT(!createArray({nullptr})->pack());
+  EXPECT(!Variable(1).pack());
+  EXPECT(!Variable(VariableType::tStruct).pack());
+
+  auto empty = createArray({});
+  EXPECT(empty->pack());
+  EXPECT(empty->type == VariableType::tInteger64Array);
+  EXPECT(empty->packedArraySize() == 0);
+}
+
+TEST(unpackRestoresElementTypes) {
+  auto array = createArray({std::make_shared<Variable>(-7), std::make_shared<Variable>((int64_t)5000000000)});
+  auto original = std::make_shared<Variable>(*array);
+  EXPECT(array->pack());
+  array->unpack();
+  EXPECT(array->type == VariableType::tArray);
+  EXPECT(array->binaryValue.empty());
+  EXPECT(array->arrayValue->at(0)->type == VariableType::tInteger);
+  EXPECT(array->arrayValue->at(1)->type == VariableType::tInteger64);
+  EXPECT(*array == *original);
+
+  Variable floats(std::vector<double>{1.5});
+  floats.unpack();
+  EXPECT(floats.type == VariableType::tArray);
+  EXPECT(floats.arrayValue->at(0)->type == VariableType::tFloat);
+
+  Variable integer(3);
+  integer.unpack();
+  EXPECT(integer.type == VariableType::tInteger);
+}
+
+TEST(toArray) {
+  Variable integers(std::vector<int64_t>{1, 2});
+  auto array = integers.toArray();
+  EXPECT(array->size() == 2);
+  EXPECT(array->at(1)->integerValue == 2);
+  EXPECT(integers.isPackedArray());
+
+  auto ordinary = createArray({std::make_shared<Variable>("a")});
+  auto copy = ordinary->toArray();
+  EXPECT(copy->size() == 1);
+  EXPECT(copy->at(0)->stringValue == "a");
+}
+
+TEST(equalityAndHash) {
+  Variable a(std::vector<int64_t>{1, 2, 3});
+  Variable b(std::vector<int64_t>{1, 2, 3});
+  Variable c(std::vector<int64_t>{1, 2, 4});
+  EXPECT(a == b);
+  EXPECT(a.hash() == b.hash());
+  EXPECT(a != c);
+
+  Variable zero(std::vector<double>{0.0});
+  Variable negativeZero(std::vector<double>{-0.0});
+  EXPECT(zero == negativeZero);
+  EXPECT(zero.hash() == negativeZero.hash());
+  EXPECT(Variable(std::vector<double>{1.0}) != Variable(std::vector<int64_t>{1}));
+}
+
+TEST(encodesLikeOrdinaryArrays) {
+  auto packed = std::make_shared<Variable>(std::vector<int64_t>{1, -2, 5000000000});
+  auto unpacked = std::make_shared<Variable>(*packed);
+  unpacked->unpack();
+  EXPECT(JsonEncoder::getString(packed) == JsonEncoder::getString(unpacked));
+  EXPECT(JsonEncoder::getString(packed) == "[1,-2,5000000000]");
+
+  auto floats = std::make_shared<Variable>(std::vector<double>{0.5, -1});
+  auto unpackedFloats = std::make_shared<Variable>(*floats);
+  unpackedFloats->unpack();
+  EXPECT(JsonEncoder::getString(floats) == JsonEncoder::getString(unpackedFloats));
+}
+
+TEST(rpcRoundTrip) {
+  RpcEncoder encoder;
+  RpcDecoder decoder;
+  for (auto &packed : {std::make_shared<Variable>(std::vector<int64_t>{1, -2, 5000000000}), std::make_shared<Variable>(std::vector<double>{0.5, -1})}) {
+    auto unpacked = std::make_shared<Variable>(*packed);
+    unpacked->unpack();
+    std::vector<char> packedData;
+    std::vector<char> unpackedData;
+    encoder.encodeResponse(packed, packedData);
+    encoder.encodeResponse(unpacked, unpackedData);
+    EXPECT(packedData == unpackedData);
+    EXPECT(*decoder.decodeResponse(packedData) == *unpacked);
+  }
+}
+
+int main() {
+  return Test::run();
+}
@@ -0,0 +1,202 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "Test.h"
+#include "../src/Statistics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+using namespace Flows;
+
+namespace {
+
+//Straightforward implementation to compare the kernels against.
+Statistics::Result reference(const double *values, size_t count) {
+  Statistics::Result result;
+  if (count == 0) return result;
+  result.count = count;
+  result.min = values[0];
+  result.max = values[0];
+  for (size_t i = 0; i < count; i++) {
+    result.min = std::min(result.min, values[i]);
+    result.max = std::max(result.max, values[i]);
+    result.sum += values[i];
+  }
+  result.mean = result.sum / (double)count;
+  double squaredDeviation = 0;
+  for (size_t i = 0; i < count; i++) {
+    squaredDeviation += (values[i] - result.mean) * (values[i] - result.mean);
+  }
+  result.stddev = std::sqrt(squaredDeviation / (double)count);
+  return result;
+}
+
+//The kernels sum in a different order, so only the last digits may differ.
+bool near(double a, double b) {
+  return std::fabs(a - b) <= 1e-9 * std::max(1.0, std::max(std::fabs(a), std::fabs(b)));
+}
+
+bool equals(const Statistics::Result &a, const Statistics::Result &b) {
+  return a.count == b.count && a.min == b.min && a.max == b.max && near(a.sum, b.sum) && near(a.mean, b.mean) && near(a.stddev, b.stddev);
+}
+
+//Runs the check once with every kernel supported by the CPU and selects the default kernel again afterwards.
+template<typename Function>
+void forEachKernel(Function function) {
+  for (auto &kernel : Statistics::kernels()) {
+    EXPECT(Statistics::setKernel(kernel));
+    EXPECT(Statistics::kernel() == kernel);
+    function();
+  }
+  Statistics::setKernel(Statistics::kernels().front());
+}
+
+}
+
+TEST(kernelName) {
+  auto kernel = Statistics::kernel();
+  EXPECT(kernel == "avx2" || kernel == "sse2" || kernel == "scalar");
+  auto kernels = Statistics::kernels();
+  EXPECT(kernels.front() == kernel);
+  EXPECT(kernels.back() == "scalar");
+  EXPECT(!Statistics::setKernel("unknown"));
+  EXPECT(Statistics::kernel() == kernel);
+}
+
+TEST(emptyInput) {
+  auto result = Statistics::calculate((const double *)nullptr, 0);
+  EXPECT(result.count == 0 && result.min == 0 && result.max == 0 && result.sum == 0 && result.mean == 0 && result.stddev == 0);
+  EXPECT(Statistics::calculate((const int64_t *)nullptr, 0).count == 0);
+  EXPECT(Statistics::calculate(PVariable()).count == 0);
+  EXPECT(Statistics::calculate(std::make_shared<Variable>(VariableType::tArray)).count == 0);
+  EXPECT(Statistics::calculate(std::make_shared<Variable>(5)).count == 0);
+}
+
+TEST(knownValues) {
+  double values[] = {2, 4, 4, 4, 5, 5, 7, 9};
+  auto result = Statistics::calculate(values, 8);
+  EXPECT(result.count == 8);
+  EXPECT(result.min == 2);
+  EXPECT(result.max == 9);
+  EXPECT(result.sum == 40);
+  EXPECT(result.mean == 5);
+  EXPECT(result.stddev == 2);
+
+  auto single = Statistics::calculate(values + 7, 1);
+  EXPECT(single.min == 9 && single.max == 9 && single.mean == 9 && single.stddev == 0);
+}
+
+TEST(matchesReferenceForAllSizesAndAlignments) {
+  //Covers the vector loops, all remainders that are not a multiple of the vector width and unaligned loads.
+  std::mt19937_64 random(42);
+  std::uniform_real_distribution<double> distribution(-1000, 1000);
+  std::vector<double> values(80);
+  for (auto &value : values) value = distribution(random);
+  forEachKernel([&]() {
+    for (size_t offset = 0; offset < 4; offset++) {
+      for (size_t count = 1; offset + count <= values.size(); count++) {
+        EXPECT(equals(Statistics::calculate(values.data() + offset, count), reference(values.data() + offset, count)));
+      }
+    }
+  });
+}
+
+TEST(extremesInEveryPosition) {
+  //The minimum and maximum have to be found in every vector lane and in the remainder.
+  forEachKernel([]() {
+    for (size_t count = 1; count <= 19; count++) {
+      for (size_t position = 0; position < count; position++) {
+        std::vector<double> values(count, 1);
+        values[position] = -5;
+        EXPECT(Statistics::calculate(values.data(), count).min == -5);
+        values[position] = 5;
+        EXPECT(Statistics::calculate(values.data(), count).max == 5);
+      }
+    }
+  });
+}
+
+TEST(infinity) {
+  double values[] = {1, 2, std::numeric_limits<double>::infinity(), 3, 4, 5, 6, 7, 8};
+  forEachKernel([&]() {
+    auto result = Statistics::calculate(values, 9);
+    EXPECT(std::isinf(result.max) && std::isinf(result.sum));
+    EXPECT(result.min == 1);
+  });
+}
+
+TEST(largeOffsetKeepsPrecision) {
+  //Values far away from 0 with a small spread, summing up squares in one pass would give garbage.
+  std::vector<double> values;
+  for (int32_t i = 0; i < 100; i++) values.push_back(1e9 + (i % 2 == 0 ? 1 : -1));
+  forEachKernel([&]() {
+    auto result = Statistics::calculate(values.data(), values.size());
+    EXPECT(near(result.mean, 1e9));
+    EXPECT(near(result.stddev, 1));
+  });
+}
+
+TEST(integers) {
+  std::vector<int64_t> values{std::numeric_limits<int64_t>::max(), -3, 0, std::numeric_limits<int64_t>::min()};
+  auto result = Statistics::calculate(values.data(), values.size());
+  EXPECT(result.count == 4);
+  EXPECT(result.min == (double)std::numeric_limits<int64_t>::min());
+  EXPECT(result.max == (double)std::numeric_limits<int64_t>::max());
+
+  std::vector<int64_t> small{2, 4, 4, 4, 5, 5, 7, 9};
+  auto smallResult = Statistics::calculate(small.data(), small.size());
+  EXPECT(smallResult.sum == 40 && smallResult.mean == 5 && smallResult.stddev == 2);
+}
+
+TEST(variables) {
+  auto floats = std::make_shared<Variable>(std::vector<double>{2, 4, 4, 4, 5, 5, 7, 9});
+  auto integers = std::make_shared<Variable>(std::vector<int64_t>{2, 4, 4, 4, 5, 5, 7, 9});
+  auto array = std::make_shared<Variable>(VariableType::tArray);
+  for (auto value : {2, 4, 4, 4}) array->arrayValue->push_back(std::make_shared<Variable>(value));
+  array->arrayValue->push_back(std::make_shared<Variable>((int64_t)5));
+  array->arrayValue->push_back(std::make_shared<Variable>(5.0));
+  array->arrayValue->push_back(std::make_shared<Variable>("ignored"));
+  array->arrayValue->push_back(nullptr);
+  array->arrayValue->push_back(std::make_shared<Variable>(7.0));
+  array->arrayValue->push_back(std::make_shared<Variable>(9));
+
+  for (auto &variable : {floats, integers, array}) {
+    auto result = Statistics::calculate(variable);
+    EXPECT(result.count == 8);
+    EXPECT(result.min == 2 && result.max == 9 && result.sum == 40 && result.mean == 5 && result.stddev == 2);
+  }
+}
+
+int main() {
+  return Test::run();
+}
@@ -0,0 +1,148 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "Test.h"
+#include "../src/MessageProperty.h"
+#include "../src/MessageQuery.h"
+#include "../src/Variable.h"
+
+using namespace Flows;
+
+namespace {
+
+PVariable createStruct(size_t size) {
+  auto variable = std::make_shared<Variable>(VariableType::tStruct);
+  for (size_t i = 0; i < size; i++) {
+    variable->structValue->emplace("key" + std::to_string(i), std::make_shared<Variable>((int32_t)i));
+  }
+  return variable;
+}
+
+}
+
+TEST(findInSmallAndIndexedStructs) {
+  //Below 16 elements lookups scan the elements, from 16 elements on they use the hash index.
+  for (size_t size : {1, 5, 15, 16, 17, 100, 1000}) {
+    auto variable = createStruct(size);
+    const Struct &structValue = variable->structValue.view();
+    EXPECT(structValue.size() == size);
+    for (size_t i = 0; i < size; i++) {
+      auto key = "key" + std::to_string(i);
+      auto iterator = structValue.find(key);
+      EXPECT(iterator != structValue.end() && iterator->second->integerValue == (int32_t)i);
+      EXPECT(structValue.find(key, Struct::hashKey(key)) == iterator);
+    }
+    EXPECT(structValue.find("key") == structValue.end());
+    EXPECT(structValue.find("key" + std::to_string(size)) == structValue.end());
+    EXPECT(!structValue.contains(""));
+  }
+}
+
+TEST(findAfterEraseAndInsert) {
+  auto variable = createStruct(40);
+  auto &structValue = *variable->structValue;
+  for (size_t i = 0; i < 40; i += 2) {
+    EXPECT(structValue.erase("key" + std::to_string(i)) == 1);
+  }
+  structValue.emplace("new", std::make_shared<Variable>(true));
+  EXPECT(structValue.size() == 21);
+  for (size_t i = 0; i < 40; i++) {
+    EXPECT(structValue.contains("key" + std::to_string(i)) == (i % 2 == 1));
+  }
+  EXPECT(structValue.at("new")->booleanValue);
+}
+
+TEST(findWithCollidingKeys) {
+  //Keys sharing the home slot of the index, as crafted by hostile input. The index gives up on them and lookups fall
+  //back to a binary search.
+  std::vector<std::string> keys;
+  for (size_t i = 0; keys.size() < 200; i++) {
+    auto key = "key" + std::to_string(i);
+    if ((Struct::hashKey(key) & 1023) == 0) keys.push_back(key);
+  }
+  Struct structValue;
+  for (auto &key : keys) {
+    structValue.emplace(key, std::make_shared<Variable>(key));
+  }
+  EXPECT(structValue.size() == keys.size());
+  for (auto &key : keys) {
+    EXPECT(structValue.contains(key) && structValue.at(key)->stringValue == key);
+    EXPECT(structValue.find(key, Struct::hashKey(key)) == structValue.find(key));
+  }
+  EXPECT(!structValue.contains("key"));
+  for (size_t i = 0; i < keys.size(); i += 2) {
+    EXPECT(structValue.erase(keys[i]) == 1);
+  }
+  for (size_t i = 0; i < keys.size(); i++) {
+    EXPECT(structValue.contains(keys[i]) == (i % 2 == 1));
+  }
+}
+
+TEST(elementsAreSortedByKey) {
+  Struct structValue;
+  for (auto &key : {"c", "a", "b", "a"}) {
+    structValue.emplace(key, std::make_shared<Variable>(key));
+  }
+  std::string keys;
+  for (auto &element : structValue) {
+    keys += element.first;
+  }
+  EXPECT(keys == "abc");
+}
+
+TEST(equalStructsWithDifferentInsertionOrderAreEqual) {
+  auto a = createStruct(20);
+  auto b = std::make_shared<Variable>(VariableType::tStruct);
+  for (size_t i = 20; i > 0; i--) {
+    b->structValue->emplace("key" + std::to_string(i - 1), std::make_shared<Variable>((int32_t)(i - 1)));
+  }
+  EXPECT(*a == *b);
+  EXPECT(a->hash() == b->hash());
+  b->structValue->at("key7")->integerValue = 8;
+  EXPECT(!(*a == *b));
+}
+
+TEST(messagePropertyFindsKeysInLargeStructs) {
+  auto message = std::make_shared<Variable>(VariableType::tStruct);
+  message->structValue->emplace("payload", createStruct(100));
+  MessageProperty property("payload.key42");
+  EXPECT(property.match(message)->integerValue == 42);
+  MessageProperty missing("payload.key100");
+  EXPECT(!missing.match(message));
+  auto value = std::make_shared<Variable>(1);
+  EXPECT(missing.set(message, value));
+  EXPECT(missing.match(message) == value);
+  MessageQuery query("payload['key99']");
+  EXPECT(query.matchFirst(message)->integerValue == 99);
+}
+
+int main() {
+  return Test::run();
+}
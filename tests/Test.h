@@ -0,0 +1,92 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * libhomegear-base is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * libhomegear-base is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libhomegear-base.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#ifndef LIBHOMEGEAR_NODE_TEST_H
+#define LIBHOMEGEAR_NODE_TEST_H
+
+#include <cstdio>
+#include <exception>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Flows {
+
+/**
+ * Minimal test runner. Each test program defines its tests with TEST(), checks conditions with EXPECT() and
+ * EXPECT_THROW() and returns Test::run() from main(). A test program fails when any check fails or a test throws.
+ */
+class Test {
+ public:
+  Test(const char *name, void (*function)()) { tests().push_back({name, function}); }
+
+  static void expect(bool condition, const char *expression, const char *file, int line) {
+    if (condition) return;
+    failures()++;
+    printf("%s:%d: Failed: %s\n", file, line, expression);
+  }
+
+  static int run() {
+    for (auto &test : tests()) {
+      auto failuresBefore = failures();
+      try {
+        test.second();
+      } catch (const std::exception &ex) {
+        failures()++;
+        printf("%s: Unexpected exception: %s\n", test.first, ex.what());
+      }
+      printf("%s %s\n", failures() == failuresBefore ? "Passed:" : "FAILED:", test.first);
+    }
+    return failures() == 0 ? 0 : 1;
+  }
+ private:
+  static std::vector<std::pair<const char *, void (*)()>> &tests() {
+    static std::vector<std::pair<const char *, void (*)()>> instance;
+    return instance;
+  }
+
+  static int &failures() {
+    static int instance = 0;
+    return instance;
+  }
+};
+
+}
+
+#define TEST(name) static void name(); static Flows::Test name##Test(#name, name); static void name()
+#define EXPECT(condition) Flows::Test::expect((condition), #condition, __FILE__, __LINE__)
+#define EXPECT_THROW(statement, exception) \
+  do { \
+    bool thrown = false; \
+    try { statement; } catch (const exception &) { thrown = true; } \
+    Flows::Test::expect(thrown, #statement " throws " #exception, __FILE__, __LINE__); \
+  } while (false)
+
+#endif //LIBHOMEGEAR_NODE_TEST_H